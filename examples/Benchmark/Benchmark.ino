@@ -0,0 +1,141 @@
+/**
+ * @file      Benchmark.ino
+ * 
+ * @author    Remal <info@remal.io>
+ * 
+ * @date      October 14, 2026
+ * 
+ * @brief     Measures the formatter, the converters and the logger on the target itself, in CPU cycles per call.
+ *            The logger cases write into a null sink while the built-in transport is muted, so the UART/USB
+ *            speed isn't part of the numbers. The results are printed once the transport is back on.
+ * 
+ *            Run extras/benchmark/rml_bench.c on a PC for the same cases with a correctness check against snprintf().
+*/
+#include "Remal_CommonUtils.h"
+
+
+#define BENCH_ITERATIONS    1000            // Calls per case, the result is the average
+
+#if defined(ESP32)
+	#define BENCH_CYCLES()  ESP.getCycleCount()
+#elif defined(STM32H725xx) || defined(STM32H735xx)
+	#define BENCH_CYCLES()  DWT->CYCCNT     // Started by RML_COMM_LoggerInit()
+#endif
+
+
+/* Null sink, drops everything but counts the bytes */
+uint32_t NullSink_Bytes = 0;
+
+void NullSink_Write(const char *Buff, uint32_t Len, void *Ctx)
+{
+	(void)Buff;
+	(void)Ctx;
+	NullSink_Bytes += Len;
+}
+
+
+/* One result per case, printed at the end */
+struct BenchResult_Struct
+{
+	const char *Name;
+	uint32_t Cycles;
+};
+
+BenchResult_Struct Results[8];
+uint8_t ResultCount = 0;
+
+void Bench_Save(const char *Name, uint32_t Start)
+{
+	Results[ResultCount].Name = Name;
+	Results[ResultCount].Cycles = (BENCH_CYCLES() - Start) / BENCH_ITERATIONS;
+	ResultCount++;
+}
+
+
+void setup() 
+{
+	LogSink_Struct NullSink = { NullSink_Write, NULL, NULL, e_DEBUG };
+	char Buff[64];
+	uint32_t Start;
+
+	/* Create a logger object */
+	GenericUART_Struct USBLogger =
+	{
+		.RX_Pin = 0,            // On Shabakah, we use the native USB port for logging
+		.TX_Pin = 0,            // Which means pins 18 and 19 are automatically used
+		.BaudRate = 115200
+	};
+
+	/* Initialize the logger, pass the logger object */
+	if( RML_COMM_LoggerInit(&USBLogger) != 0 || RML_COMM_LogSinkAdd(&NullSink) < 0 )
+	{
+		// If the logger fails to initialize, then we will be stuck in this loop
+		while(1);
+	}
+
+	/* Mute the transport, above e_FATAL nothing gets through */
+	RML_COMM_LogSinkLevelSet(RML_LOG_SINK_TRANSPORT, e_FATAL + 1);
+
+	Start = BENCH_CYCLES();
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		RML_COMM_utoa(i * 2654435761u, Buff, sizeof(Buff), 10);
+	}
+	Bench_Save("RML_COMM_utoa(base 10)", Start);
+
+	Start = BENCH_CYCLES();
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		RML_COMM_itoa((int32_t)(i * 2654435761u), Buff, sizeof(Buff), 10);
+	}
+	Bench_Save("RML_COMM_itoa(base 10)", Start);
+
+	Start = BENCH_CYCLES();
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		RML_COMM_ftoa((float)i * 0.731f - 100.0f, Buff, sizeof(Buff), 3);
+	}
+	Bench_Save("RML_COMM_ftoa(3 decimals)", Start);
+
+	Start = BENCH_CYCLES();
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		RML_COMM_snprintf(Buff, sizeof(Buff), "rpm %u temp %.1f state %s", i, 21.5f, "RUN");
+	}
+	Bench_Save("RML_COMM_snprintf()", Start);
+
+	Start = BENCH_CYCLES();
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		snprintf(Buff, sizeof(Buff), "rpm %u temp %.1f state %s", (unsigned)i, 21.5f, "RUN");
+	}
+	Bench_Save("snprintf() (C library)", Start);
+
+	Start = BENCH_CYCLES();
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		RML_COMM_LogMsg("Bench", e_INFO, "rpm %u temp %.1f state %s", i, 21.5f, "RUN");
+	}
+	Bench_Save("RML_COMM_LogMsg() -> null sink", Start);
+
+	Start = BENCH_CYCLES();
+	for( uint32_t i = 0; i < BENCH_ITERATIONS; i++ )
+	{
+		RML_LOG_FAST("Bench", e_INFO, "rpm %u temp %.1f state %s", i, 21.5f, "RUN");
+	}
+	Bench_Save("RML_LOG_FAST() -> null sink", Start);
+
+	/* Transport back on, print the results */
+	RML_COMM_LogSinkLevelSet(RML_LOG_SINK_TRANSPORT, e_DEBUG);
+	for( uint8_t i = 0; i < ResultCount; i++ )
+	{
+		RML_COMM_LogMsg("Bench", e_INFO, "%-32s %6u cycles/call", Results[i].Name, Results[i].Cycles);
+	}
+	RML_COMM_LogMsg("Bench", e_INFO, "%u bytes went to the null sink", NullSink_Bytes);
+}
+
+
+void loop() 
+{
+	delay(1000);
+}
@@ -0,0 +1,489 @@
+/**
+ * @file 		rml_bench.c
+ * @author 		Remal <info@remal.io>
+ *
+ * @brief   	Native (PC) benchmark and regression check for the formatter, the converters, the parsers and the logger. Each
+ * 				case is timed against the C library doing the same job and its output is compared with snprintf(),
+ * 				so a release can be checked for both speed and correctness in one run.
+ *
+ * 				Build and run from the repo root:
+ * 					gcc -O2 -std=gnu11 -Isrc -x c src/Remal_CommonUtils.cpp -x none extras/benchmark/rml_bench.c -o rml_bench -lpthread
+ * 					./rml_bench				(add a number to change the iterations per case, ex: ./rml_bench 200000)
+ *
+ * 				The logger cases log into a null sink (the stdout transport is removed), so only the logger itself is
+ * 				measured. Returns 1 if any output didn't match snprintf().
+ *
+ * @note		Use examples/Benchmark on the target itself for cycle counts.
+**/
+#include "Remal_CommonUtils.h"
+#include <time.h>
+
+
+/*********************************************
+ * Private Variables
+ *********************************************/
+static uint32_t Bench_Iterations = 1000000;
+static uint32_t Bench_Mismatches = 0;
+static volatile uint32_t Bench_Sink = 0;			//Keeps the compiler from dropping the work being measured
+static uint64_t NullSink_Bytes = 0;
+
+
+
+/*********************************************
+ * Helpers
+ *********************************************/
+//Monotonic time in ns
+static uint64_t Bench_Now_ns(void)
+{
+	struct timespec Now;
+	clock_gettime(CLOCK_MONOTONIC, &Now);
+	return (uint64_t)Now.tv_sec * 1000000000u + (uint64_t)Now.tv_nsec;
+}
+
+//Prints one result line: ns per call and output throughput
+static void Bench_Report(const char *Name, uint64_t Elapsed_ns, uint64_t Bytes)
+{
+	double Ns = (double)Elapsed_ns / Bench_Iterations;
+	double MBps = (Elapsed_ns > 0) ? (double)Bytes * 1000.0 / (double)Elapsed_ns : 0.0;
+
+	printf("  %-36s %9.1f ns/call %9.1f MB/s\n", Name, Ns, MBps);
+}
+
+//Compares one output against the reference, counts and prints mismatches
+static void Bench_Check(const char *Name, const char *Got, const char *Expected)
+{
+	if( strcmp(Got, Expected) != 0 )
+	{
+		printf("  MISMATCH %s: got \"%s\", expected \"%s\"\n", Name, Got, Expected);
+		Bench_Mismatches++;
+	}
+}
+
+//Sink that drops everything, only counts the bytes
+static void NullSink_Write(const char *Buff, uint32_t Len, void *Ctx)
+{
+	(void)Buff;
+	(void)Ctx;
+	NullSink_Bytes += Len;
+}
+
+
+
+/*********************************************
+ * Benchmarks
+ *********************************************/
+static void Bench_Utoa(void)
+{
+	char Buff[24], Ref[24];
+	uint64_t Start, Bytes = 0;
+	uint32_t Value;
+
+	printf("utoa / itoa:\n");
+
+	/* Regression: powers of 2 and 10 around the digit boundaries, all bases */
+	for( uint32_t i = 0; i < 32; i++ )
+	{
+		Value = (uint32_t)1 << i;
+		RML_COMM_utoa(Value - 1, Buff, sizeof(Buff), 10);
+		snprintf(Ref, sizeof(Ref), "%u", Value - 1);
+		Bench_Check("utoa base 10", Buff, Ref);
+		RML_COMM_utoa(Value, Buff, sizeof(Buff), 16);
+		snprintf(Ref, sizeof(Ref), "%X", Value);
+		Bench_Check("utoa base 16", Buff, Ref);
+		RML_COMM_itoa(-(int32_t)(Value >> 1), Buff, sizeof(Buff), 10);
+		snprintf(Ref, sizeof(Ref), "%d", -(int32_t)(Value >> 1));
+		Bench_Check("itoa base 10", Buff, Ref);
+	}
+
+	/* Regression: 64-bit extremes and the digit boundaries past 32 bits */
+	for( uint32_t i = 0; i < 20; i++ )
+	{
+		static const uint64_t Extremes[] = { 0, 1, 4294967295u, 4294967296u, 9999999999999999999u, 10000000000000000000u, UINT64_MAX };
+		uint64_t Value64 = (i < 7) ? Extremes[i] : 1000000000000u * (i - 6) - 1;
+
+		RML_COMM_utoa64(Value64, Buff, sizeof(Buff), 10);
+		snprintf(Ref, sizeof(Ref), "%llu", (unsigned long long)Value64);
+		Bench_Check("utoa64 base 10", Buff, Ref);
+		RML_COMM_utoa64(Value64, Buff, sizeof(Buff), 16);
+		snprintf(Ref, sizeof(Ref), "%llX", (unsigned long long)Value64);
+		Bench_Check("utoa64 base 16", Buff, Ref);
+		RML_COMM_itoa64(-(int64_t)(Value64 >> 1), Buff, sizeof(Buff), 10);
+		snprintf(Ref, sizeof(Ref), "%lld", -(long long)(Value64 >> 1));
+		Bench_Check("itoa64 base 10", Buff, Ref);
+	}
+	RML_COMM_itoa64(INT64_MIN, Buff, sizeof(Buff), 10);
+	Bench_Check("itoa64 INT64_MIN", Buff, "-9223372036854775808");
+	RML_COMM_itoa64(INT64_MAX, Buff, sizeof(Buff), 10);
+	Bench_Check("itoa64 INT64_MAX", Buff, "9223372036854775807");
+
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)RML_COMM_utoa(i * 2654435761u, Buff, sizeof(Buff), 10);
+	}
+	Bench_Report("RML_COMM_utoa(base 10)", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)snprintf(Buff, sizeof(Buff), "%u", i * 2654435761u);
+	}
+	Bench_Report("snprintf(\"%u\")", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)RML_COMM_itoa((int32_t)(i * 2654435761u), Buff, sizeof(Buff), 10);
+	}
+	Bench_Report("RML_COMM_itoa(base 10)", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)snprintf(Buff, sizeof(Buff), "%d", (int32_t)(i * 2654435761u));
+	}
+	Bench_Report("snprintf(\"%d\")", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)RML_COMM_utoa(i * 2654435761u, Buff, sizeof(Buff), 16);
+	}
+	Bench_Report("RML_COMM_utoa(base 16)", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)snprintf(Buff, sizeof(Buff), "%X", i * 2654435761u);
+	}
+	Bench_Report("snprintf(\"%X\")", Bench_Now_ns() - Start, Bytes);
+}
+
+
+
+static void Bench_Ftoa(void)
+{
+	static const double Values[] = { 0.0, 0.5, 1.005, 2.675, -3.14159265, 123456.789, 1e-5, 9.9999, 4294967296.5 };
+	char Buff[48], Ref[48];
+	uint64_t Start, Bytes = 0;
+	double Value;
+
+	printf("ftoa:\n");
+
+	/* Regression: tricky roundings at each precision */
+	for( uint32_t i = 0; i < sizeof(Values) / sizeof(Values[0]); i++ )
+	{
+		for( uint8_t Afterpoint = 0; Afterpoint <= 6; Afterpoint++ )
+		{
+			RML_COMM_ftoa(Values[i], Buff, sizeof(Buff), Afterpoint);
+			snprintf(Ref, sizeof(Ref), "%.*f", Afterpoint, Values[i]);
+			Bench_Check("ftoa", Buff, Ref);
+		}
+	}
+
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Value = (double)i * 0.731 - 1000.0;
+		Bytes += (uint32_t)RML_COMM_ftoa(Value, Buff, sizeof(Buff), 3);
+	}
+	Bench_Report("RML_COMM_ftoa(3 decimals)", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Value = (double)i * 0.731 - 1000.0;
+		Bytes += (uint32_t)snprintf(Buff, sizeof(Buff), "%.3f", Value);
+	}
+	Bench_Report("snprintf(\"%.3f\")", Bench_Now_ns() - Start, Bytes);
+}
+
+
+
+static void Bench_Atou(void)
+{
+	static const char *Values[] = { "0", "7", "42", "65535", "12345678", "123456789", "4294967295", "-2147483648", "0.5", "-3.25", "123456.789", "1e-5", "2.675e3" };
+	static const char *Limits[] = { "2147483647", "2147483648", "-2147483649", "4294967296", "+5", "-", "", "12ab" };
+	char Buff[48], Ref[48];
+	uint64_t Start, Bytes = 0;
+	uint32_t Value;
+	int32_t Signed;
+	double Float;
+
+	printf("atou / atoi / atof:\n");
+
+	/* Regression: same chars used and value as the C library (the first 7 are unsigned integers, the rest are for atof),
+	   or -1 where the value doesn't fit the type. Printed as "<chars used> <value>" so both are compared */
+	for( uint32_t i = 0; i < sizeof(Values) / sizeof(Values[0]) + sizeof(Limits) / sizeof(Limits[0]); i++ )
+	{
+		const char *Str = (i < sizeof(Values) / sizeof(Values[0])) ? Values[i] : Limits[i - sizeof(Values) / sizeof(Values[0])];
+		uint32_t Len = (uint32_t)strlen(Str);
+		int32_t Used;
+		char *End;
+		long long Ll;
+
+		Signed = 0;
+		Used = RML_COMM_atoi(Str, Len, 10, &Signed);
+		snprintf(Buff, sizeof(Buff), "%d %d", (int)Used, (Used > 0) ? (int)Signed : 0);
+		Ll = strtoll(Str, &End, 10);
+		Used = (End == Str || Ll < INT32_MIN || Ll > INT32_MAX) ? -1 : (int32_t)(End - Str);
+		snprintf(Ref, sizeof(Ref), "%d %d", (int)Used, (Used > 0) ? (int)Ll : 0);
+		Bench_Check("atoi", Buff, Ref);
+
+		Value = 0;
+		Used = RML_COMM_atou(Str, Len, 10, &Value);
+		snprintf(Buff, sizeof(Buff), "%d %u", (int)Used, (Used > 0) ? (unsigned)Value : 0u);
+		Ll = strtoll(Str, &End, 10);
+		Used = (End == Str || Ll < 0 || Ll > (long long)UINT32_MAX) ? -1 : (int32_t)(End - Str);
+		snprintf(Ref, sizeof(Ref), "%d %u", (int)Used, (Used > 0) ? (unsigned)Ll : 0u);
+		Bench_Check("atou", Buff, Ref);
+
+		Float = 0.0;
+		Used = RML_COMM_atof(Str, Len, &Float);
+		snprintf(Buff, sizeof(Buff), "%d %.17g", (int)Used, (Used > 0) ? Float : 0.0);
+		Float = strtod(Str, &End);
+		Used = (End == Str) ? -1 : (int32_t)(End - Str);
+		snprintf(Ref, sizeof(Ref), "%d %.17g", (int)Used, (Used > 0) ? Float : 0.0);
+		Bench_Check("atof", Buff, Ref);
+	}
+
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		const char *Str = Values[i % 7];
+		Bytes += (uint32_t)RML_COMM_atou(Str, (uint32_t)strlen(Str), 10, &Value);
+		Bench_Sink += Value;
+	}
+	Bench_Report("RML_COMM_atou(base 10)", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		const char *Str = Values[i % 7];
+		char *End;
+		Bench_Sink += (uint32_t)strtoul(Str, &End, 10);
+		Bytes += (uint32_t)(End - Str);
+	}
+	Bench_Report("strtoul()", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		const char *Str = Values[7 + i % 6];
+		Bytes += (uint32_t)RML_COMM_atof(Str, (uint32_t)strlen(Str), &Float);
+		Bench_Sink += (uint32_t)Float;
+	}
+	Bench_Report("RML_COMM_atof()", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		const char *Str = Values[7 + i % 6];
+		char *End;
+		Bench_Sink += (uint32_t)strtod(Str, &End);
+		Bytes += (uint32_t)(End - Str);
+	}
+	Bench_Report("strtod()", Bench_Now_ns() - Start, Bytes);
+}
+
+
+
+static void Bench_Printf(void)
+{
+	char Buff[128], Ref[128];
+	uint64_t Start, Bytes = 0;
+
+	printf("printf:\n");
+
+	/* Regression: the specifiers a typical log line uses */
+	RML_COMM_snprintf(Buff, sizeof(Buff), "[%5d|%-6s|%08X|%c|%.2f|%+d|%lu|%%]", -42, "ab", 0xBEEFu, 'Z', 21.456, 7, 123456789ul);
+	snprintf(Ref, sizeof(Ref), "[%5d|%-6s|%08X|%c|%.2f|%+d|%lu|%%]", -42, "ab", 0xBEEFu, 'Z', 21.456, 7, 123456789ul);
+	Bench_Check("snprintf mixed", Buff, Ref);
+	RML_COMM_snprintf(Buff, sizeof(Buff), "[%llu|%lld|%lld|%llX|%zu|%5zu]", (unsigned long long)UINT64_MAX, (long long)INT64_MIN, 
+		-1234567890123ll, 0xFEDCBA9876543210ull, (size_t)SIZE_MAX, sizeof(Buff));
+	snprintf(Ref, sizeof(Ref), "[%llu|%lld|%lld|%llX|%zu|%5zu]", (unsigned long long)UINT64_MAX, (long long)INT64_MIN, 
+		-1234567890123ll, 0xFEDCBA9876543210ull, (size_t)SIZE_MAX, sizeof(Buff));
+	Bench_Check("snprintf ll/z", Buff, Ref);
+	RML_COMM_snprintf(Buff, 8, "%s", "truncated string");
+	Bench_Check("snprintf truncation", Buff, "truncat");
+
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)RML_COMM_snprintf(Buff, sizeof(Buff), "rpm %u temp %.1f state %s", i, 21.5, "RUN");
+	}
+	Bench_Report("RML_COMM_snprintf()", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)snprintf(Buff, sizeof(Buff), "rpm %u temp %.1f state %s", i, 21.5, "RUN");
+	}
+	Bench_Report("snprintf()", Bench_Now_ns() - Start, Bytes);
+
+	NullSink_Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		RML_COMM_printf("rpm %u temp %.1f state %s\r\n", i, 21.5, "RUN");
+	}
+	Bench_Report("RML_COMM_printf() -> null sink", Bench_Now_ns() - Start, NullSink_Bytes);
+}
+
+
+
+static void Bench_Strings(void)
+{
+	static const uint8_t Data[] = { 0x00, 0x01, 0x7F, 0x80, 0xA5, 0xDE, 0xAD, 0xBE, 0xEF, 0xFF, 0x10 };
+	char Buff[64], Ref[64];
+	uint64_t Start, Bytes = 0;
+	StrBuilder_Struct Sb;
+	uint32_t Pos;
+
+	printf("hexdump / strings:\n");
+
+	/* Regression: every length up to the data size, so the 4-bytes-per-step path and its tail are both covered */
+	for( uint32_t Len = 0; Len <= sizeof(Data); Len++ )
+	{
+		Pos = 0;
+		Ref[0] = '\0';
+		for( uint32_t i = 0; i < Len; i++ )
+		{
+			Pos += (uint32_t)snprintf(Ref + Pos, sizeof(Ref) - Pos, "%02X", Data[i]);
+		}
+		RML_COMM_HexDump(Data, Len, Buff, sizeof(Buff), '\0');
+		Bench_Check("HexDump", Buff, Ref);
+
+		Pos = 0;
+		Ref[0] = '\0';
+		for( uint32_t i = 0; i < Len; i++ )
+		{
+			Pos += (uint32_t)snprintf(Ref + Pos, sizeof(Ref) - Pos, (i == 0) ? "%02X" : ":%02X", Data[i]);
+		}
+		RML_COMM_HexDump(Data, Len, Buff, sizeof(Buff), ':');
+		Bench_Check("HexDump separator", Buff, Ref);
+	}
+	snprintf(Buff, sizeof(Buff), "%d", (int)RML_COMM_HexDump(Data, sizeof(Data), Buff, sizeof(Data) * 2, '\0'));
+	Bench_Check("HexDump buffer too small", Buff, "-1");
+
+	/* Regression: odd and even lengths, the middle char of an odd one stays put */
+	strcpy(Buff, "abcde");
+	RML_COMM_ReverseString(Buff, 5);
+	Bench_Check("ReverseString odd", Buff, "edcba");
+	strcpy(Buff, "abcdef");
+	RML_COMM_ReverseString(Buff, 6);
+	Bench_Check("ReverseString even", Buff, "fedcba");
+	strcpy(Buff, "abc");
+	RML_COMM_ReverseString(Buff, 1);
+	Bench_Check("ReverseString one", Buff, "abc");
+
+	/* Regression: the builder keeps what fits, stays terminated and counts the rest */
+	RML_COMM_SbInit(&Sb, Buff, 12);
+	RML_COMM_SbAddStr(&Sb, "temp=");
+	RML_COMM_SbAddFloat(&Sb, 21.5, 1);
+	RML_COMM_SbAddChar(&Sb, ' ');
+	snprintf(Ref, sizeof(Ref), "%d", (int)RML_COMM_SbAddUint(&Sb, 123456u));
+	Bench_Check("StrBuilder overflow return", Ref, "-1");
+	Bench_Check("StrBuilder truncation", Buff, "temp=21.5 1");
+	RML_COMM_SbAddStr(&Sb, "abc");
+	snprintf(Ref, sizeof(Ref), "%u %u", (unsigned)Sb.Len, (unsigned)Sb.Truncated);
+	Bench_Check("StrBuilder truncated count", Ref, "11 8");
+
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Bytes += (uint32_t)RML_COMM_HexDump(Data, sizeof(Data), Buff, sizeof(Buff), '\0');
+	}
+	Bench_Report("RML_COMM_HexDump(11 bytes)", Bench_Now_ns() - Start, Bytes);
+
+	Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		Pos = 0;
+		for( uint32_t j = 0; j < sizeof(Data); j++ )
+		{
+			Pos += (uint32_t)snprintf(Buff + Pos, sizeof(Buff) - Pos, "%02X", Data[j]);
+		}
+		Bytes += Pos;
+	}
+	Bench_Report("snprintf(\"%02X\") x 11", Bench_Now_ns() - Start, Bytes);
+}
+
+
+
+static void Bench_LogMsg(void)
+{
+	uint64_t Start;
+
+	printf("logger:\n");
+
+	NullSink_Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		RML_COMM_LogMsg("Bench", e_INFO, "rpm %u temp %.1f state %s", i, 21.5, "RUN");
+	}
+	Bench_Report("RML_COMM_LogMsg() -> null sink", Bench_Now_ns() - Start, NullSink_Bytes);
+
+	NullSink_Bytes = 0;
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		RML_LOG_FAST("Bench", e_INFO, "rpm %u temp %.1f state %s", i, 21.5, "RUN");
+	}
+	Bench_Report("RML_LOG_FAST() -> null sink", Bench_Now_ns() - Start, NullSink_Bytes);
+
+	RML_COMM_LogLevelSet(e_DEBUG, 0);
+	Start = Bench_Now_ns();
+	for( uint32_t i = 0; i < Bench_Iterations; i++ )
+	{
+		RML_COMM_LogMsg("Bench", e_DEBUG, "rpm %u temp %.1f state %s", i, 21.5, "RUN");
+	}
+	Bench_Report("RML_COMM_LogMsg() level disabled", Bench_Now_ns() - Start, 0);
+	RML_COMM_LogLevelSet(e_DEBUG, 1);
+}
+
+
+
+int main(int argc, char **argv)
+{
+	GenericUART_Struct Logger = { 0 };
+	LogSink_Struct NullSink = { NullSink_Write, NULL, NULL, e_DEBUG };
+
+	if( argc > 1 && atoi(argv[1]) > 0 )
+	{
+		Bench_Iterations = (uint32_t)atoi(argv[1]);
+	}
+
+	/* Sync mode logger writing into the null sink only */
+	Logger.BaudRate = 115200;
+	if( RML_COMM_LoggerInit(&Logger) != 0 || RML_COMM_LogSinkAdd(&NullSink) < 0 )
+	{
+		printf("Logger init failed\n");
+		return 1;
+	}
+	RML_COMM_LogSinkRemove(RML_LOG_SINK_TRANSPORT);
+
+	printf("Remal CommonUtils benchmark, %u iterations per case\n", Bench_Iterations);
+	Bench_Utoa();
+	Bench_Ftoa();
+	Bench_Atou();
+	Bench_Printf();
+	Bench_Strings();
+	Bench_LogMsg();
+	Bench_Sink = (uint32_t)NullSink_Bytes;
+
+	printf("%u mismatches\n", Bench_Mismatches);
+	return (Bench_Mismatches == 0) ? 0 : 1;
+}
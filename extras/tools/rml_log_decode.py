@@ -0,0 +1,396 @@
+#!/usr/bin/env python3
+"""
+@file       rml_log_decode.py
+
+@author     Remal <info@remal.io>
+
+@brief      Host side decoder for the tokenized (binary) output of RML_COMM_LogMsg(), enabled with the
+            '-D RML_LOG_TOKENIZED_ENABLE' build symbol. The firmware only sends the address of each format
+            string plus the raw argument bytes, this script looks the format strings up in the firmware ELF
+            file and rebuilds the text. Anything that isn't a valid frame (RML_COMM_printf() output, boot
+            messages...) is passed through as is.
+
+            Usage:
+                python3 rml_log_decode.py firmware.elf capture.bin
+                python3 rml_log_decode.py firmware.elf --port /dev/ttyACM0 --baud 115200     (needs pyserial)
+                cat capture.bin | python3 rml_log_decode.py firmware.elf -
+
+            Native (PC) builds must be linked with -no-pie so string addresses match the ELF file.
+
+            Profiling events sent by RML_COMM_ProfileDump() (text or tokenized builds) are written as a Chrome
+            trace (open it in chrome://tracing or ui.perfetto.dev) with --trace:
+                python3 rml_log_decode.py firmware.elf capture.bin --trace trace.json
+
+            Frame layout (little-endian), must match Remal_CommonUtils.cpp:
+                [0xA5] [PayloadLen] [LogLvl] [Timestamp_us x4] [Msg address x4] ([SeqNum x4]) [Src string + '\\0'] [Args...] [Checksum]
+            The timestamp is the low 32 bits of the time in us, it is unwrapped here. SeqNum is only there when
+            bit 7 of LogLvl is set (RML_LOG_SEQNUM_ENABLE).
+                [0xA6] [PayloadLen] [Core] [TickRate_Hz x4] ([Ticks x4] [Name address x4] [Type x1]) x N [Checksum]
+            Profiling frame, Ticks is the low 32 bits of the core's cycle counter and Type 0 = begin, 1 = end.
+                [0xA7] [PayloadLen] [CBOR map] [Checksum]
+            Key/value frame from RML_COMM_LogKV() ('-D RML_LOG_KV_BINARY'), the map holds 0: level, 1: time in us,
+            2: source, 3: sequence number and then the fields with text keys. These don't need the ELF file (pass
+            'none' if the firmware has no tokenized frames) and can also be written as JSON lines with --kv-json:
+                python3 rml_log_decode.py none capture.bin --kv-json records.jsonl
+"""
+import argparse
+import codecs
+import json
+import re
+import struct
+import sys
+
+FRAME_SYNC = 0xA5
+PROFILE_SYNC = 0xA6
+KV_SYNC = 0xA7
+LVL_SEQNUM = 0x80
+LOG_LEVELS = ["DEBUG", "INFO", "WARNING", "ERROR", "FATAL"]
+
+# Size in bytes of each integer argument on the MCU (32-bit cores), indexed by length modifier. Adjusted for 64-bit ELFs
+INT_SIZES = {"": 4, "hh": 4, "h": 4, "l": 4, "ll": 8, "z": 4, "j": 8, "t": 4, "p": 4}
+
+SPEC_RE = re.compile(r"%([-+ 0#]*)(\*|\d*)(?:\.(\*|\d*))?(hh|h|ll|l|z|j|t)?([a-zA-Z%])")
+
+
+class ElfStrings:
+    """Minimal ELF reader, maps runtime addresses of allocated sections back to file contents."""
+
+    def __init__(self, path):
+        with open(path, "rb") as f:
+            self.data = f.read()
+        if self.data[:4] != b"\x7fELF":
+            raise ValueError("%s is not an ELF file" % path)
+
+        is64 = self.data[4] == 2
+        self.is64 = is64
+        endian = "<" if self.data[5] == 1 else ">"
+        if is64:
+            shoff, = struct.unpack_from(endian + "Q", self.data, 0x28)
+            shentsize, shnum = struct.unpack_from(endian + "HH", self.data, 0x3A)
+        else:
+            shoff, = struct.unpack_from(endian + "I", self.data, 0x20)
+            shentsize, shnum = struct.unpack_from(endian + "HH", self.data, 0x2E)
+
+        self.sections = []
+        for i in range(shnum):
+            base = shoff + i * shentsize
+            if is64:
+                _, sh_type, sh_flags, sh_addr, sh_offset, sh_size = struct.unpack_from(endian + "IIQQQQ", self.data, base)
+            else:
+                _, sh_type, sh_flags, sh_addr, sh_offset, sh_size = struct.unpack_from(endian + "IIIIII", self.data, base)
+            # SHT_PROGBITS with SHF_ALLOC
+            if sh_type == 1 and (sh_flags & 0x2) and sh_addr != 0:
+                self.sections.append((sh_addr, sh_size, sh_offset))
+
+    def string_at(self, addr):
+        for sh_addr, sh_size, sh_offset in self.sections:
+            if sh_addr <= addr < sh_addr + sh_size:
+                start = sh_offset + (addr - sh_addr)
+                end = self.data.index(b"\0", start)
+                return self.data[start:end].decode("utf-8", "replace")
+        return None
+
+
+class Args:
+    """Reads raw argument bytes in the order the firmware stored them."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def take(self, size):
+        if self.pos + size > len(self.data):
+            raise IndexError("frame was cut")
+        chunk = self.data[self.pos:self.pos + size]
+        self.pos += size
+        return chunk
+
+    def string(self):
+        end = self.data.index(b"\0", self.pos)
+        value = self.data[self.pos:end].decode("utf-8", "replace")
+        self.pos = end + 1
+        return value
+
+
+def render(fmt, args):
+    """printf() style formatting of the stored args, mirrors the specifiers RML_COMM_vprintf() supports."""
+
+    def replace(match):
+        flags, width, precision, length, spec = match.groups()
+        length = length or ""
+        if spec == "%":
+            return "%"
+        try:
+            # '*' widths/precisions are stored as 4-byte ints before the arg
+            if width == "*":
+                width, = struct.unpack("<i", args.take(4))
+                if width < 0:
+                    flags, width = flags + "-", -width
+                width = str(width)
+            if precision == "*":
+                precision, = struct.unpack("<i", args.take(4))
+                precision = str(precision) if precision >= 0 else None
+            if spec == "s":
+                value = args.string()
+                if precision:
+                    value = value[:int(precision)]
+                return ("%" + flags + width + "s") % value
+            if spec == "c":
+                return ("%" + flags + width + "c") % chr(args.take(1)[0])
+            if spec == "f":
+                value, = struct.unpack("<d", args.take(8))
+                return ("%" + flags + width + "." + (precision or "2") + "f") % value
+            if spec == "p":
+                size = INT_SIZES["p"]
+                value = int.from_bytes(args.take(size), "little")
+                return ("%" + flags.replace("0", "") + width + "s") % ("0x%0*X" % (size * 2, value))
+            if spec in "diuxXb":
+                size = INT_SIZES.get(length, 4)
+                signed = spec in "di"
+                value = int.from_bytes(args.take(size), "little", signed=signed)
+                if spec == "b":
+                    return ("%" + flags + width + "s") % format(value, "b")
+                if precision:
+                    # Python ignores the precision of integers, C takes it as the min number of digits
+                    digits = "%0*d" % (int(precision), abs(value)) if spec in "diu" else "%0*X" % (int(precision), value)
+                    if spec in "di" and (value < 0 or "+" in flags or " " in flags):
+                        digits = ("-" if value < 0 else "+" if "+" in flags else " ") + digits
+                    return ("%" + flags.replace("0", "") + width + "s") % digits
+                # RML_COMM_utoa() only emits upper case hex digits
+                text = ("%" + flags + width + {"u": "d", "x": "X"}.get(spec, spec)) % value
+                return text.replace("0X", "0x") if spec == "x" else text
+        except (IndexError, ValueError):
+            return "<?>"
+        return match.group(0)
+
+    return SPEC_RE.sub(replace, fmt)
+
+
+class Clock:
+    """Rebuilds the full us timestamp from its low 32 bits (wraps every ~71 minutes)."""
+
+    def __init__(self):
+        self.last = None
+        self.high = 0
+
+    def unwrap(self, low):
+        if self.last is not None and low < self.last:
+            self.high += 1 << 32
+        self.last = low
+        return self.high + low
+
+
+def decode_frame(elf, payload, clock):
+    level = payload[0]
+    timestamp, msg_addr = struct.unpack_from("<II", payload, 1)
+    timestamp = clock.unwrap(timestamp)
+    stamp = "%u.%06u " % (timestamp // 1000000, timestamp % 1000000)
+    pos = 9
+    if level & LVL_SEQNUM:
+        level &= ~LVL_SEQNUM
+        seq, = struct.unpack_from("<I", payload, pos)
+        stamp += "#%u " % seq
+        pos += 4
+    args = Args(payload[pos:])
+    src = args.string()
+
+    fmt = elf.string_at(msg_addr)
+    if fmt is None:
+        msg = "<unknown format 0x%08X> %s" % (msg_addr, payload[args.pos:].hex())
+    else:
+        msg = render(fmt, args)
+
+    level_str = LOG_LEVELS[level] if level < len(LOG_LEVELS) else "Unknown LogLvl?"
+    return "> %s[%s] %s: %s\r\n" % (stamp, level_str, src, msg)
+
+
+class Cbor:
+    """Reads the subset of CBOR (RFC 8949) the firmware writes: integers, text, floats, null and maps."""
+
+    def __init__(self, data):
+        self.data = data
+        self.pos = 0
+
+    def head(self):
+        byte = self.data[self.pos]
+        self.pos += 1
+        info = byte & 0x1F
+        if info < 24 or info == 31:                     # 31: indefinite length, no argument
+            return byte >> 5, info, byte
+        size = 1 << (info - 24)
+        value = int.from_bytes(self.data[self.pos:self.pos + size], "big")
+        self.pos += size
+        return byte >> 5, value, byte
+
+    def item(self):
+        major, value, byte = self.head()
+        if major == 0:
+            return value
+        if major == 1:
+            return -1 - value
+        if major == 3:
+            text = self.data[self.pos:self.pos + value].decode("utf-8", "replace")
+            self.pos += value
+            return text
+        if major == 5 and byte == 0xBF:
+            items = {}
+            while self.data[self.pos] != 0xFF:
+                key = self.item()
+                items[key] = self.item()
+            self.pos += 1
+            return items
+        if byte == 0xFA:
+            return struct.unpack(">f", value.to_bytes(4, "big"))[0]
+        if byte == 0xFB:
+            return struct.unpack(">d", value.to_bytes(8, "big"))[0]
+        if byte == 0xF6:
+            return None
+        raise ValueError("unexpected CBOR item 0x%02X" % byte)
+
+
+def decode_kv(payload):
+    """Turns a key/value frame into a record: level, time_us, src, seq (or None) and the fields in order."""
+    items = Cbor(payload).item()
+    level = items.pop(0, None)
+    return {"time_us": items.pop(1, 0), "seq": items.pop(3, None), "src": items.pop(2, ""),
+            "level": LOG_LEVELS[level] if level is not None and level < len(LOG_LEVELS) else "Unknown LogLvl?",
+            "fields": {str(k): v for k, v in items.items()}}
+
+
+def render_kv(record):
+    stamp = "%u.%06u " % (record["time_us"] // 1000000, record["time_us"] % 1000000)
+    if record["seq"] is not None:
+        stamp += "#%u " % record["seq"]
+    fields = " ".join("%s=%s" % (k, "%.7g" % v if isinstance(v, float) else "(null)" if v is None else v)
+                      for k, v in record["fields"].items())
+    return "> %s[%s] %s: %s\r\n" % (stamp, record["level"], record["src"], fields)
+
+
+class Trace:
+    """Collects profiling events as Chrome trace events, one track per core."""
+
+    def __init__(self):
+        self.events = []
+        self.clocks = {}
+
+    def add_frame(self, elf, payload):
+        core = payload[0]
+        rate, = struct.unpack_from("<I", payload, 1)
+        clock = self.clocks.setdefault(core, Clock())
+        for pos in range(5, len(payload) - 8, 9):
+            ticks, name_addr, kind = struct.unpack_from("<IIB", payload, pos)
+            name = (elf.string_at(name_addr) if elf is not None else None) or "0x%08X" % name_addr
+            self.events.append({"name": name, "ph": "B" if kind == 0 else "E", "pid": 1, "tid": core,
+                                "ts": clock.unwrap(ticks) * 1e6 / rate})
+
+    def write(self, path):
+        with open(path, "w") as f:
+            json.dump({"traceEvents": self.events, "displayTimeUnit": "ns"}, f)
+
+
+def decode_stream(elf, chunks, out, trace=None, kv_json=None):
+    buff = bytearray()
+    clock = Clock()
+    syncs = [bytes([FRAME_SYNC]), bytes([PROFILE_SYNC]), bytes([KV_SYNC])]
+    # Text goes through one incremental decoder so UTF-8 sequences split
+    # across chunks, or containing a sync value (0xA5 in "\u00A5"), survive
+    utf8 = codecs.getincrementaldecoder("utf-8")("replace")
+
+    def parse(eof):
+        while buff:
+            sync = min([i for i in (buff.find(s) for s in syncs) if i >= 0] or [-1])
+            if sync != 0:
+                # Pass through text until the next possible frame
+                text = buff if sync < 0 else buff[:sync]
+                out.write(utf8.decode(bytes(text)))
+                del buff[:len(text)]
+                continue
+            if len(buff) < 2 or len(buff) < buff[1] + 3:
+                if not eof:
+                    return                              # Need more bytes
+                out.write(utf8.decode(bytes(buff[:1])))  # Input ended, was text after all
+                del buff[:1]
+                continue
+            length = buff[1]
+            payload = bytes(buff[2:2 + length])
+            if buff[0] == PROFILE_SYNC and length >= 5 and (length - 5) % 9 == 0 and (sum(payload) & 0xFF) == buff[2 + length]:
+                if trace is not None:
+                    trace.add_frame(elf, payload)
+                del buff[:length + 3]
+            elif buff[0] == FRAME_SYNC and length >= 10 and elf is not None and (sum(payload) & 0xFF) == buff[2 + length]:
+                out.write(utf8.decode(b"", True) + decode_frame(elf, payload, clock))
+                del buff[:length + 3]
+            elif (buff[0] == KV_SYNC and length >= 2 and payload[0] == 0xBF and payload[-1] == 0xFF
+                  and (sum(payload) & 0xFF) == buff[2 + length]):
+                record = decode_kv(payload)
+                out.write(utf8.decode(b"", True) + render_kv(record))
+                if kv_json is not None:
+                    kv_json.write(json.dumps(record) + "\n")
+                del buff[:length + 3]
+            else:
+                out.write(utf8.decode(bytes(buff[:1])))  # Not a frame, keep going
+                del buff[:1]
+
+    for chunk in chunks:
+        buff += chunk
+        parse(False)
+        out.flush()
+    parse(True)
+    out.write(utf8.decode(b"", True))
+    out.flush()
+
+
+def read_file(f):
+    while True:
+        chunk = f.read(4096)
+        if not chunk:
+            return
+        yield chunk
+
+
+def read_serial(port, baud):
+    import serial                                       # pip install pyserial
+    with serial.Serial(port, baud, timeout=0.1) as ser:
+        while True:
+            chunk = ser.read(4096)
+            if chunk:
+                yield chunk
+
+
+def main():
+    parser = argparse.ArgumentParser(description="Decode tokenized Remal logger output")
+    parser.add_argument("elf", help="firmware ELF file the device is running, 'none' for key/value frames only")
+    parser.add_argument("input", nargs="?", default="-", help="captured log file, '-' for stdin")
+    parser.add_argument("--port", help="read from a serial port instead (needs pyserial)")
+    parser.add_argument("--baud", type=int, default=115200, help="serial baud rate")
+    parser.add_argument("--trace", help="write the profiling events to this Chrome trace (JSON) file")
+    parser.add_argument("--kv-json", help="also write the key/value records to this file, one JSON object per line")
+    opts = parser.parse_args()
+
+    elf = ElfStrings(opts.elf) if opts.elf != "none" else None
+    if elf is not None and elf.is64:
+        # long and size_t are 64-bit on 64-bit hosts (native builds)
+        INT_SIZES.update({"l": 8, "z": 8, "t": 8, "p": 8})
+    if opts.port:
+        chunks = read_serial(opts.port, opts.baud)
+    elif opts.input == "-":
+        chunks = read_file(sys.stdin.buffer)
+    else:
+        chunks = read_file(open(opts.input, "rb"))
+
+    trace = Trace() if opts.trace else None
+    kv_json = open(opts.kv_json, "w") if opts.kv_json else None
+    sys.stdout.reconfigure(encoding="utf-8", errors="replace")   # Device text is UTF-8 whatever the host locale
+    try:
+        decode_stream(elf, chunks, sys.stdout, trace, kv_json)
+    except KeyboardInterrupt:
+        pass
+    if kv_json is not None:
+        kv_json.close()
+    if trace is not None:
+        trace.write(opts.trace)
+        sys.stderr.write("%u profiling events written to %s\n" % (len(trace.events), opts.trace))
+
+
+if __name__ == "__main__":
+    main()
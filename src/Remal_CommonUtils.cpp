@@ -27,6 +27,11 @@ typedef enum
  * Private Variables
  *********************************************/
 static uint8_t Logger_InitDone = 0;					//This flag is set to true when RML_COMM_LoggerInit() is called and is successful. Used for error handling
+static uint32_t Log_DroppedCount = 0;				//Number of messages dropped (ring buffer full, lock timeout or sync mode message from an ISR)
+static uint32_t LogLock_Timeout_ms = RML_LOG_LOCK_DEFAULT_TIMEOUT_MS;		//Max time a task waits for the logger in sync mode
+#if defined(RML_LOG_SEQNUM_ENABLE)
+static uint32_t Log_SeqNum = 0;						//Sequence number of the next log message, a gap in the output means messages were dropped
+#endif
 
 /*
  * The statements below handle deciding what processor 
@@ -35,35 +40,293 @@ static uint8_t Logger_InitDone = 0;					//This flag is set to true when RML_COMM
 #if defined(ESP32)
 	#pragma message("Auto-detected to be running on ESP32, make sure you added the lines in platformio.ini to enable logging via native USB")
 	static uint8_t CurrentMCU = e_ESP_ESP32;
-	static uint32_t MaxBaudrate = 115200;
-	#define PUTCHAR_FUNC		Serial.printf("%c",		
-	#define PUTCHAR_N_FUNC		Serial.printf("%s",
-	static portMUX_TYPE LogSpinlock = portMUX_INITIALIZER_UNLOCKED;			//Define a spinlock object for the shared resource - so logging tasks dont clash
+	static uint32_t MaxBaudrate = RML_LOG_MAX_BAUDRATE;
+	static SemaphoreHandle_t LogMutex = NULL;		//Serializes sync mode writes so logging tasks dont clash. A mutex (not a spinlock) so interrupts stay enabled during USB writes
+	static HardwareSerial *LogUART = NULL;			//Hardware UART selected by GenericUART_Struct.Port, NULL for the native USB port
+	#define LOG_MALLOC			malloc
+	#define LOG_FREE			free
+	#define LOG_FREERTOS		1
+	#define LOG_IN_ISR()		xPortInIsrContext()
+
+	//Returns the Arduino instance of a hardware UART (LogPort_Enum), NULL if this ESP32 doesn't have it
+	static HardwareSerial* Esp_UARTGet(uint8_t Port)
+	{
+		switch (Port)
+		{
+			#if ARDUINO_USB_CDC_ON_BOOT
+			case e_LOG_PORT_UART0:	return &Serial0;
+			#else
+			case e_LOG_PORT_UART0:	return &Serial;				//Without USB-CDC on boot Serial is UART 0
+			#endif
+			#if SOC_UART_NUM > 1
+			case e_LOG_PORT_UART1:	return &Serial1;
+			#endif
+			#if SOC_UART_NUM > 2
+			case e_LOG_PORT_UART2:	return &Serial2;
+			#endif
+			default:				return NULL;
+		}
+	}
+
+	//Transmit a buffer in one go, all logger/printf output goes through here
+	static void Transport_Write(const char* Buff, uint32_t Len)
+	{
+		if( LogUART != NULL )
+		{
+			LogUART->write((const uint8_t*)Buff, Len);
+			return;
+		}
+		Serial.write((const uint8_t*)Buff, Len);
+	}
+
+	//Called after a batch of writes, USB-CDC sends on its own so there is nothing to push
+	static void Transport_Flush(void)
+	{
+	}
+
+	//Waits until everything written is out (RML_COMM_LogFlush()), Serial.flush() has its own timeout
+	static int8_t Transport_WaitSent(uint32_t Timeout_ms)
+	{
+		(void)Timeout_ms;
+		if( LogUART != NULL )
+		{
+			LogUART->flush();
+			return 0;
+		}
+		Serial.flush();
+		return 0;
+	}
+
+	//Timestamp taken when a message is logged (us since boot). The esp_timer is shared by both cores, unlike the cycle counter
+	static uint64_t Log_GetTimestamp_us(void)
+	{
+		return (uint64_t)esp_timer_get_time();
+	}
+
+	//Async mode: each core queues into its own ring buffer, the drain merges them by time
+	#define LOG_RINGS				portNUM_PROCESSORS
+	#define LOG_RING_ID()			xPortGetCoreID()
+
+	#if defined(RML_PROFILE_ENABLE)
+	//Profiling events: cycle counter of the calling core, each core records into its own buffer
+	#define PROFILE_CORES			portNUM_PROCESSORS
+	#define PROFILE_CORE_ID()		xPortGetCoreID()
+	#define PROFILE_TICKS()			ESP.getCycleCount()
+	#define PROFILE_TICK_RATE_HZ()	(getCpuFrequencyMhz() * 1000000u)
+	#endif
 
 #elif defined(STM32H725xx) || defined(STM32H735xx)
 	#pragma message("Auto-detected to be running on STM32H7xxxx")
 	#include "stm32h7xx_hal.h"
 	#include <string.h>
 
-	SemaphoreHandle_t LogMutex;
+	SemaphoreHandle_t LogMutex = NULL;				//Serializes sync mode writes so logging tasks dont interleave mid-line
 
-	/* Decide which UART to use based on the processor: */
+	/* Decide which UART to use by default based on the processor, GenericUART_Struct.UART_Handle can pick another one. 
+	 * Weak so a project that only has the other UART still links: */
 	#if defined(STM32H735xx)
-		extern UART_HandleTypeDef huart3;
-		#define STM32_UART_HNDLR	&huart3
+		extern UART_HandleTypeDef huart3 __attribute__((weak));
+		#define STM32_UART_DEFAULT	&huart3
 	#else
-		extern UART_HandleTypeDef huart1;
-		#define STM32_UART_HNDLR	&huart1
+		extern UART_HandleTypeDef huart1 __attribute__((weak));
+		#define STM32_UART_DEFAULT	&huart1
+	#endif
+	static UART_HandleTypeDef *LogUART = STM32_UART_DEFAULT;
+	#define STM32_UART_HNDLR	LogUART
+
+#if defined(RML_LOG_STM32_DMA_ENABLE)
+	#pragma message("RML logger: UART transmit uses DMA double-buffering")
+
+	/*
+	 * DMA transmit engine: output is copied into the "fill" buffer while the DMA drains the other one, the
+	 * buffers are swapped in RML_COMM_UART_TxCpltCallback(). Both buffers live in D2 SRAM (reachable by
+	 * DMA1/DMA2) and are 32-byte aligned so a D-cache clean never touches neighbouring data.
+	 */
+	static uint8_t DMA_TxBuff[2][RML_LOG_DMA_BUFF_SIZE] RML_LOG_DMA_BUFF_ATTR;
+	static volatile uint32_t DMA_FillLen = 0;				//Number of bytes waiting in the fill buffer
+	static volatile uint8_t DMA_FillIdx = 0;				//Index of the buffer being filled, the other one belongs to the DMA
+	static volatile uint8_t DMA_Busy = 0;					//Set while a DMA transfer is in flight
+	static volatile uint32_t DMA_TxLen = 0;					//Number of bytes of the transfer in flight
+
+	//Counts the lines in a buffer that is thrown away (at least 1, a line may end in the next buffer)
+	static void DMA_CountDropped(const uint8_t *Buff, uint32_t Len)
+	{
+		uint32_t Lines = 0;
+
+		for( uint32_t i = 0; i < Len; i++ )
+		{
+			Lines += (Buff[i] == '\n');
+		}
+		__atomic_fetch_add(&Log_DroppedCount, (Lines > 0) ? Lines : 1, __ATOMIC_RELAXED);
+	}
+
+	//Hands the fill buffer to the DMA and swaps buffers. If the DMA can't be started the buffer is dropped (and counted) so
+	//writers never wait for a transfer that won't happen. Must be called with interrupts disabled
+	static void DMA_Kick(void)
+	{
+		uint8_t *Buff = DMA_TxBuff[DMA_FillIdx];
+		uint32_t Len = DMA_FillLen;
+
+		if( DMA_Busy || Len == 0 )
+		{
+			return;
+		}
+
+		/* Push the data out of the D-cache so the DMA sees it, the size is rounded up to a full cache line */
+		SCB_CleanDCache_by_Addr((uint32_t*)Buff, (int32_t)((Len + 31) & ~31u));
+
+		if( HAL_UART_Transmit_DMA(STM32_UART_HNDLR, Buff, (uint16_t)Len) == HAL_OK )
+		{
+			DMA_Busy = 1;
+			DMA_TxLen = Len;
+			DMA_FillIdx ^= 1;
+		}
+		else
+		{
+			DMA_CountDropped(Buff, Len);
+		}
+		DMA_FillLen = 0;
+	}
+
+	//The transfer in flight won't complete: it is counted as dropped and its buffer is free again. Must be called with 
+	//interrupts disabled
+	static void DMA_Lost(void)
+	{
+		if( DMA_Busy )
+		{
+			DMA_Busy = 0;
+			DMA_CountDropped(DMA_TxBuff[DMA_FillIdx ^ 1], DMA_TxLen);
+		}
+		DMA_Kick();
+	}
+
+	//Transmit a buffer, returns as soon as it was copied into the fill buffer. When both buffers are full the caller waits 
+	//for the DMA, at most LogLock_Timeout_ms, what can't be sent is dropped and counted
+	static void Transport_Write(const char* Buff, uint32_t Len)
+	{
+		uint32_t Chunk, Primask;
+		uint8_t CanWait = (__get_PRIMASK() == 0 && __get_IPSR() == 0);			//Never wait from an ISR or with interrupts disabled
+		uint32_t Start;
+
+		while( Len > 0 )
+		{
+			Primask = __get_PRIMASK();
+			__disable_irq();
+
+			/* Copy as much as fits, then start the DMA if it is idle */
+			Chunk = RML_LOG_DMA_BUFF_SIZE - DMA_FillLen;
+			if( Chunk > Len )
+			{
+				Chunk = Len;
+			}
+			memcpy(&DMA_TxBuff[DMA_FillIdx][DMA_FillLen], Buff, Chunk);
+			DMA_FillLen += Chunk;
+			DMA_Kick();
+
+			if( !Primask )
+			{
+				__enable_irq();
+			}
+
+			Buff += Chunk;
+			Len -= Chunk;
+
+			/* Both buffers are full, wait for the DMA to finish one */
+			if( Len > 0 && DMA_FillLen == RML_LOG_DMA_BUFF_SIZE )
+			{
+				if( !CanWait )
+				{
+					DMA_CountDropped((const uint8_t*)Buff, Len);		//Can't wait for the DMA here, the rest is lost
+					return;
+				}
+
+				Start = HAL_GetTick();
+				while( DMA_Busy && DMA_FillLen == RML_LOG_DMA_BUFF_SIZE )
+				{
+					/* The transfer should have ended long ago: its completion was lost (UART/DMA error), stop it and move on */
+					if( HAL_GetTick() - Start >= LogLock_Timeout_ms )
+					{
+						HAL_UART_AbortTransmit(STM32_UART_HNDLR);
+						__disable_irq();
+						DMA_Lost();
+						__enable_irq();
+						break;
+					}
+					if( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING )
+					{
+						vTaskDelay(1);
+					}
+				}
+			}
+		}
+	}
+
+	void RML_COMM_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+	{
+		if( huart != STM32_UART_HNDLR )
+		{
+			return;
+		}
+
+		/* Called from the DMA interrupt: the DMA buffer is free again, send whatever was filled in the meantime */
+		DMA_Busy = 0;
+		DMA_Kick();
+	}
+
+	void RML_COMM_UART_ErrorCallback(UART_HandleTypeDef *huart)
+	{
+		uint32_t Primask;
+
+		/* Only errors that ended our transfer matter (the HAL already stopped it), a receive error leaves it running */
+		if( huart != STM32_UART_HNDLR || !DMA_Busy || huart->gState != HAL_UART_STATE_READY )
+		{
+			return;
+		}
+
+		/* Called from the UART/DMA interrupt: the TX complete callback won't come for this transfer */
+		Primask = __get_PRIMASK();
+		__disable_irq();
+		DMA_Lost();
+		if( !Primask )
+		{
+			__enable_irq();
+		}
+	}
+
+	#if defined(RML_LOG_STM32_DMA_OWN_CALLBACK)
+	#ifdef __cplusplus
+	extern "C"
+	#endif
+	void HAL_UART_TxCpltCallback(UART_HandleTypeDef *huart)
+	{
+		RML_COMM_UART_TxCpltCallback(huart);
+	}
+
+	#ifdef __cplusplus
+	extern "C"
+	#endif
+	void HAL_UART_ErrorCallback(UART_HandleTypeDef *huart)
+	{
+		RML_COMM_UART_ErrorCallback(huart);
+	}
 	#endif
 
 	//Transmit a single character
 	void UART_PutChar(char ch)
 	{
-		//if( xSemaphoreTake(LogMutex, 1200) == pdTRUE )
-		//{
-			HAL_UART_Transmit(STM32_UART_HNDLR, (uint8_t*)&ch, 1, 1000);
-		//	xSemaphoreGive(LogMutex);
-		//}
+		Transport_Write(&ch, 1);
+	}
+
+	//Transmit a string
+	void UART_PutChar_n(const char* str)
+	{
+		Transport_Write(str, strlen(str));
+	}
+#else
+	//Transmit a single character
+	void UART_PutChar(char ch)
+	{
+		HAL_UART_Transmit(STM32_UART_HNDLR, (uint8_t*)&ch, 1, 1000);
 	}
 
 	//Transmit a string
@@ -72,37 +335,411 @@ static uint8_t Logger_InitDone = 0;					//This flag is set to true when RML_COMM
 		HAL_UART_Transmit(STM32_UART_HNDLR, (uint8_t*)str, strlen(str), 1000);
 	}
 
+	//Transmit a buffer in one go, all logger/printf output goes through here
+	static void Transport_Write(const char* Buff, uint32_t Len)
+	{
+		HAL_UART_Transmit(STM32_UART_HNDLR, (uint8_t*)Buff, Len, 1000);
+	}
+#endif
+
+	//Called after a batch of writes, the UART (or DMA) is already sending everything it was given
+	static void Transport_Flush(void)
+	{
+	}
+
+	//Waits until the last byte written left the UART (RML_COMM_LogFlush()). Returns 0 if it did within Timeout_ms
+	static int8_t Transport_WaitSent(uint32_t Timeout_ms)
+	{
+		uint32_t Start = HAL_GetTick();
+
+		#if defined(RML_LOG_STM32_DMA_ENABLE)
+		uint32_t Primask;
+
+		while( DMA_Busy || DMA_FillLen > 0 || !__HAL_UART_GET_FLAG(STM32_UART_HNDLR, UART_FLAG_TC) )
+		#else
+		while( !__HAL_UART_GET_FLAG(STM32_UART_HNDLR, UART_FLAG_TC) )
+		#endif
+		{
+			if( HAL_GetTick() - Start >= Timeout_ms )
+			{
+				return -1;
+			}
+
+			#if defined(RML_LOG_STM32_DMA_ENABLE)
+			/* Whatever is left in the fill buffer is sent as soon as the DMA is free */
+			Primask = __get_PRIMASK();
+			__disable_irq();
+			DMA_Kick();
+			if( !Primask )
+			{
+				__enable_irq();
+			}
+			#endif
+			if( xTaskGetSchedulerState() == taskSCHEDULER_RUNNING )
+			{
+				vTaskDelay(1);
+			}
+		}
+
+		return 0;
+	}
+
+	/*
+	 * Timestamp taken when a message is logged (us since boot), from the DWT cycle counter. The cycles elapsed 
+	 * since the last call are turned into whole us with a 32 bit division (a hardware UDIV), what is left over is
+	 * kept for the next call so no time is lost. The count is then checked against the HAL tick: the DWT misses 
+	 * the cycles the core spends asleep in WFI (FreeRTOS idle) and the wraps (every ~7.8 s at 550 MHz) when nothing 
+	 * was logged for a while, so a time that fell behind the tick is moved up to it. Timestamps are never more 
+	 * than 1 ms late and stay cycle accurate while the core runs.
+	 */
+	static uint64_t LogTime_us = 0;						//Whole us counted so far
+	static uint32_t LogTime_CycRem = 0;					//Cycles counted that don't make a whole us yet
+	static uint32_t LogTime_LastCyc = 0;
+
+	static void Log_TimestampInit(void)
+	{
+		CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+		DWT->LAR = 0xC5ACCE55;							//Unlocks the DWT on the Cortex-M7
+		DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+		LogTime_LastCyc = DWT->CYCCNT;
+		LogTime_us = (uint64_t)HAL_GetTick() * 1000;
+		LogTime_CycRem = 0;
+	}
+
+	static uint64_t Log_GetTimestamp_us(void)
+	{
+		uint32_t Primask = __get_PRIMASK();
+		uint32_t CycPerUs = SystemCoreClock / 1000000;
+		uint32_t Cyc, Delta, Us;
+		uint64_t Tick_us, Now;
+
+		__disable_irq();
+		Cyc = DWT->CYCCNT;
+		Delta = Cyc - LogTime_LastCyc;
+		LogTime_LastCyc = Cyc;
+
+		Us = Delta / CycPerUs;
+		LogTime_CycRem += Delta - Us * CycPerUs;
+		if( LogTime_CycRem >= CycPerUs )
+		{
+			Us++;
+			LogTime_CycRem -= CycPerUs;
+		}
+		LogTime_us += Us;
+
+		/* Cycles were missed (sleep or wraps): catch up with the tick */
+		Tick_us = (uint64_t)HAL_GetTick() * 1000;
+		if( LogTime_us < Tick_us )
+		{
+			LogTime_us = Tick_us;
+			LogTime_CycRem = 0;
+		}
+		Now = LogTime_us;
+
+		if( !Primask )
+		{
+			__enable_irq();
+		}
+
+		return Now;
+	}
+
+	#if defined(RML_PROFILE_ENABLE)
+	//Profiling events: the DWT cycle counter, started by RML_COMM_LoggerInit()
+	#define PROFILE_CORES			1
+	#define PROFILE_CORE_ID()		0
+	#define PROFILE_TICKS()			DWT->CYCCNT
+	#define PROFILE_TICK_RATE_HZ()	SystemCoreClock
+	#endif
+
+	//Sets the baud rate and TX FIFO of the log UART if they differ from what CubeMX configured. Returns 0 on success
+	static int8_t Stm32_UARTConfig(uint32_t BaudRate, uint8_t TxFifo)
+	{
+		static const uint32_t FifoThresholds[] = { UART_TXFIFO_THRESHOLD_1_8, UART_TXFIFO_THRESHOLD_1_4, UART_TXFIFO_THRESHOLD_1_2,
+													UART_TXFIFO_THRESHOLD_3_4, UART_TXFIFO_THRESHOLD_7_8, UART_TXFIFO_THRESHOLD_8_8 };
+
+		if( LogUART->Init.BaudRate != BaudRate )
+		{
+			LogUART->Init.BaudRate = BaudRate;
+			LogUART->Init.OverSampling = UART_OVERSAMPLING_16;
+			if( HAL_UART_Init(LogUART) != HAL_OK )
+			{
+				/* The divider is out of range at 16x oversampling for this UART clock, 8x doubles the max rate */
+				LogUART->Init.OverSampling = UART_OVERSAMPLING_8;
+				if( HAL_UART_Init(LogUART) != HAL_OK )
+				{
+					return -1;
+				}
+			}
+		}
+
+		if( TxFifo == e_TXFIFO_OFF )
+		{
+			return (HAL_UARTEx_DisableFifoMode(LogUART) == HAL_OK) ? 0 : -1;
+		}
+		if( TxFifo != e_TXFIFO_KEEP )
+		{
+			if( HAL_UARTEx_SetTxFifoThreshold(LogUART, FifoThresholds[TxFifo - e_TXFIFO_1_8]) != HAL_OK || 
+				HAL_UARTEx_EnableFifoMode(LogUART) != HAL_OK )
+			{
+				return -1;
+			}
+		}
+
+		return 0;
+	}
+
 	static uint8_t CurrentMCU = e_STM32_STM32xx;
-	#define PUTCHAR_FUNC		UART_PutChar(		
-	#define PUTCHAR_N_FUNC		UART_PutChar_n(
-	static uint32_t MaxBaudrate = 115200;
+	static uint32_t MaxBaudrate = RML_LOG_MAX_BAUDRATE;
+	#define LOG_MALLOC			pvPortMalloc
+	#define LOG_FREE			vPortFree
+	#define LOG_FREERTOS		1
+	#define LOG_IN_ISR()		(__get_IPSR() != 0)
 
 #else
 	#pragma message("Auto-detected to be running on PC or unsupported platform, defaulting to printf()")
 	//The lines below are used to add code specifically for machines with native printf() support
 	static uint8_t CurrentMCU = e_Native;
-	#define PUTCHAR_FUNC		printf("%c",		
-	#define PUTCHAR_N_FUNC		printf("%s",
-	static uint32_t MaxBaudrate = 115200;			//Unused for native
+	static uint32_t MaxBaudrate = RML_LOG_MAX_BAUDRATE;			//Unused for native
+	#define LOG_MALLOC			malloc
+	#define LOG_FREE			free
+	#define LOG_FREERTOS		0
+	#define LOG_IN_ISR()		0
+	#include <pthread.h>
+	#include <unistd.h>
+	#include <time.h>
+	#include <fcntl.h>
+	#include <errno.h>
+	#include <sys/uio.h>
+
+	static pthread_mutex_t LogMutex = PTHREAD_MUTEX_INITIALIZER;		//Serializes sync mode writes so logging threads dont interleave mid-line
+
+	//Absolute CLOCK_REALTIME deadline Timeout_ms from now, for the pthread timed waits
+	static void Native_Deadline(uint32_t Timeout_ms, struct timespec *Deadline)
+	{
+		clock_gettime(CLOCK_REALTIME, Deadline);
+		Deadline->tv_sec += Timeout_ms / 1000;
+		Deadline->tv_nsec += (long)(Timeout_ms % 1000) * 1000000;
+		if( Deadline->tv_nsec >= 1000000000 )
+		{
+			Deadline->tv_sec++;
+			Deadline->tv_nsec -= 1000000000;
+		}
+	}
+
+	/* The output is collected in Native_OutBuff and written with one writev() per batch, to stdout or to a rotating
+	 * log file (RML_COMM_LogFileSet()). There is a single writer at a time: the sync mode lock or the drain holder */
+	static char Native_OutBuff[RML_LOG_NATIVE_BUFF_SIZE];
+	static uint32_t Native_OutLen = 0;
+	static int Native_Fd = STDOUT_FILENO;
+	static char *Native_FilePath = NULL;			//NULL when writing to stdout
+	static uint64_t Native_FileBytes = 0;			//Bytes in the current log file
+	static uint64_t Native_FileMaxBytes = 0;		//The file is rotated once it reaches this size, 0 never rotates
+	static uint8_t Native_FileKeep = 0;				//Rotated files kept (Path.1 is the newest)
+
+	//Opens (truncates) the log file. Returns the file descriptor, -1 on failure
+	static int Native_FileOpen(const char *Path)
+	{
+		return open(Path, O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+	}
+
+	//Shifts Path -> Path.1 -> ... -> Path.<Keep> (the oldest is overwritten) and starts an empty Path
+	static void Native_FileRotate(void)
+	{
+		size_t PathLen = strlen(Native_FilePath);
+		char *From = (char*)malloc(PathLen + 8);
+		char *To = (char*)malloc(PathLen + 8);
+		int Fd;
+
+		if( From != NULL && To != NULL )
+		{
+			for( uint8_t i = Native_FileKeep; i > 1; i-- )
+			{
+				snprintf(From, PathLen + 8, "%s.%u", Native_FilePath, (unsigned int)(i - 1));
+				snprintf(To, PathLen + 8, "%s.%u", Native_FilePath, (unsigned int)i);
+				rename(From, To);
+			}
+			if( Native_FileKeep > 0 )
+			{
+				snprintf(To, PathLen + 8, "%s.1", Native_FilePath);
+				rename(Native_FilePath, To);
+			}
+		}
+		free(From);
+		free(To);
+
+		/* If the new file can't be opened keep appending to the old one rather than losing the log */
+		Fd = Native_FileOpen(Native_FilePath);
+		if( Fd >= 0 )
+		{
+			close(Native_Fd);
+			Native_Fd = Fd;
+		}
+		Native_FileBytes = 0;
+	}
+
+	//Writes all the buffers, retrying partial writes, then rotates the log file if it is full
+	static void Native_WriteV(struct iovec *Vec, int Count)
+	{
+		ssize_t Written;
+
+		/* Keeps our output in order with what the application printed through stdio */
+		if( Native_Fd == STDOUT_FILENO )
+		{
+			fflush(stdout);
+		}
+
+		while( Count > 0 )
+		{
+			Written = writev(Native_Fd, Vec, Count);
+			if( Written < 0 )
+			{
+				if( errno == EINTR )
+				{
+					continue;
+				}
+				return;
+			}
+			Native_FileBytes += (uint64_t)Written;
+
+			/* Skip what went out, a partial write resumes in the middle of a buffer */
+			while( Count > 0 && (size_t)Written >= Vec->iov_len )
+			{
+				Written -= (ssize_t)Vec->iov_len;
+				Vec++;
+				Count--;
+			}
+			if( Count > 0 )
+			{
+				Vec->iov_base = (char*)Vec->iov_base + Written;
+				Vec->iov_len -= (size_t)Written;
+			}
+		}
+
+		if( Native_FilePath != NULL && Native_FileMaxBytes != 0 && Native_FileBytes >= Native_FileMaxBytes )
+		{
+			Native_FileRotate();
+		}
+	}
+
+	//Transmit a buffer in one go, all logger/printf output goes through here
+	static void Transport_Write(const char* Buff, uint32_t Len)
+	{
+		if( Native_OutLen + Len <= sizeof(Native_OutBuff) )
+		{
+			memcpy(&Native_OutBuff[Native_OutLen], Buff, Len);
+			Native_OutLen += Len;
+			return;
+		}
+
+		/* Doesn't fit: what is buffered and this write go out in the same writev() */
+		struct iovec Vec[2] = { { Native_OutBuff, Native_OutLen }, { (void*)Buff, Len } };
+		Native_WriteV(Vec, 2);
+		Native_OutLen = 0;
+	}
+
+	//Called after a batch of writes, everything buffered goes out in one system call
+	static void Transport_Flush(void)
+	{
+		if( Native_OutLen > 0 )
+		{
+			struct iovec Vec = { Native_OutBuff, Native_OutLen };
+			Native_WriteV(&Vec, 1);
+			Native_OutLen = 0;
+		}
+	}
+
+	//Waits until everything written is out (RML_COMM_LogFlush()). Each batch of writes already ends with Transport_Flush()
+	//by the writer holding the lock, so nothing is left in the buffer by now
+	static int8_t Transport_WaitSent(uint32_t Timeout_ms)
+	{
+		(void)Timeout_ms;
+		return 0;
+	}
+
+	//Timestamp taken when a message is logged (us, monotonic)
+	static uint64_t Log_GetTimestamp_us(void)
+	{
+		struct timespec Now;
+		clock_gettime(CLOCK_MONOTONIC, &Now);
+		return (uint64_t)Now.tv_sec * 1000000 + (uint64_t)(Now.tv_nsec / 1000);
+	}
+
+	#if defined(RML_PROFILE_ENABLE)
+	//Profiling events: ns, monotonic. All threads share one buffer
+	static uint32_t Profile_GetTicks(void)
+	{
+		struct timespec Now;
+		clock_gettime(CLOCK_MONOTONIC, &Now);
+		return (uint32_t)((uint64_t)Now.tv_sec * 1000000000u + (uint64_t)Now.tv_nsec);
+	}
+	#define PROFILE_CORES			1
+	#define PROFILE_CORE_ID()		0
+	#define PROFILE_TICKS()			Profile_GetTicks()
+	#define PROFILE_TICK_RATE_HZ()	1000000000u
+	#endif
 #endif
 
+//Current time in ms, used by the rate limits and the timeouts
+static uint32_t Log_GetTime_ms(void)
+{
+	return (uint32_t)(Log_GetTimestamp_us() / 1000);
+}
+
 
 /*************************************************
  * @brief Log Levels to log:
- * By default, all log messages are enabled.
+ * One bit per log level (bit 0 = Debug ... bit 4
+ * = Fatal), by default all log messages are 
+ * enabled. Read with a single relaxed atomic load
+ * so no lock is needed.
  *  
  * Use RML_COMM_LogLevelSet() function to enable
  * or disable specific log level messages
  *************************************************/
-static uint8_t LogLevelsEnable[5] = 
+#define LOG_LEVELS_ALL			0x1F
+static uint8_t LogLevelsMask = LOG_LEVELS_ALL;
+
+/*************************************************
+ * @brief Log Level colors:
+ * Used to color the log level string
+ *************************************************/
+static const char *LogLevel_Color[5] =
 {
-	1,		//0- Log "Debug" messages
-	1,		//1- Log "Info" messages
-	1,		//2- Log "Warning" messages
-	1,		//3- Log "Error" messages
-	1,		//4- Log "Fatal" messages
+	ANSI_CYAN,			//Debug is cyan
+	ANSI_GREEN,			//Info is green
+	ANSI_YELLOW,		//Warning is yellow
+	ANSI_RED,			//Error is red
+	ANSI_BOLDRED		//Fatal is bold red
 };
 
+/*************************************************
+ * @brief Log modules:
+ * Registered with RML_COMM_LogModuleRegister(),
+ * the handle is the index in these tables. 
+ * LogModule_Mask holds the levels the module 
+ * itself allows, LogModule_EffMask the levels 
+ * that are actually logged (module AND global) so
+ * the check is a single load.
+ *************************************************/
+static const char *LogModule_Name[RML_LOG_MAX_MODULES];
+static uint8_t LogModule_Mask[RML_LOG_MAX_MODULES];
+static uint8_t LogModule_EffMask[RML_LOG_MAX_MODULES];
+static uint8_t LogModule_Count = 0;
+
+/*************************************************
+ * @brief Log module rate limits:
+ * Token bucket of each module (see 
+ * RML_COMM_LogModuleRateSet()), in 1/1000 of a 
+ * token so slow rates still refill smoothly. A 
+ * rate of 0 means no limit.
+ *************************************************/
+static uint16_t LogModule_Rate[RML_LOG_MAX_MODULES];			//Messages per second
+static uint16_t LogModule_Burst[RML_LOG_MAX_MODULES];			//Max messages in a burst
+static uint32_t LogModule_Tokens[RML_LOG_MAX_MODULES];			//Tokens left x1000
+static uint32_t LogModule_Refill_ms[RML_LOG_MAX_MODULES];		//Last time tokens were added
+static uint32_t LogModule_Suppressed[RML_LOG_MAX_MODULES];		//Messages dropped since the last one that went through
+
 /*************************************************
  * @brief Log Level strings:
  * Used when outputting log message
@@ -118,10 +755,1830 @@ char LogLevel_Str[5][10] =
 
 
 
+/*************************************************
+ * @brief Statistics (RML_LOG_STATS_ENABLE):
+ * Counters read by RML_COMM_LogGetStats(), each
+ * one a relaxed atomic add so the logging path 
+ * never waits on them. Dropped comes from 
+ * Log_DroppedCount and BuffPeak from the most 
+ * bytes a ring held, both when they are read.
+ *************************************************/
+#if defined(RML_LOG_STATS_ENABLE)
+#define LOG_STATS_LVL_OTHER		(RML_LOG_STATS_LEVELS - 1)		//Slot of RML_COMM_printf() output and unknown levels
+#define LOG_STAT_ADD(_Cnt, _Val)		__atomic_fetch_add(&Log_Stats._Cnt, (_Val), __ATOMIC_RELAXED)
 
+static LogStats_Struct Log_Stats;
+static uint32_t LogStats_DroppedBase = 0;		//Log_DroppedCount at the last reset
+static uint32_t LogStats_BuffPeak = 0;			//Most bytes used in a ring buffer since the last reset
 
-
-int8_t RML_COMM_LoggerInit(GenericUART_Struct *UARTComm)
+//Counts a line (or RML_COMM_printf() output) that was logged
+static inline void LogStats_Line(uint8_t LogLvl, uint32_t Len)
+{
+	LogLvl = (LogLvl > e_FATAL) ? LOG_STATS_LVL_OTHER : LogLvl;
+	LOG_STAT_ADD(Lines[LogLvl], 1);
+	LOG_STAT_ADD(Bytes[LogLvl], Len);
+}
+
+//Keeps the highest ring buffer use seen
+static inline void LogStats_BuffUsed(uint32_t Used)
+{
+	uint32_t Peak = __atomic_load_n(&LogStats_BuffPeak, __ATOMIC_RELAXED);
+
+	while( Used > Peak && !__atomic_compare_exchange_n(&LogStats_BuffPeak, &Peak, Used, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+	{
+	}
+}
+
+//Times a call of the built-in transport
+static inline void LogStats_Tx(uint64_t Start_us)
+{
+	uint32_t Time_us = (uint32_t)(Log_GetTimestamp_us() - Start_us);
+	uint32_t Max = __atomic_load_n(&Log_Stats.TxMax_us, __ATOMIC_RELAXED);
+
+	LOG_STAT_ADD(TxCalls, 1);
+	LOG_STAT_ADD(TxTotal_us, Time_us);
+	while( Time_us > Max && !__atomic_compare_exchange_n(&Log_Stats.TxMax_us, &Max, Time_us, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) )
+	{
+	}
+}
+#else
+#define LOG_STAT_ADD(_Cnt, _Val)		((void)0)
+#define LogStats_Line(_Lvl, _Len)		((void)0)
+#define LogStats_BuffUsed(_Used)		((void)0)
+#endif
+
+
+
+/*************************************************
+ * @brief Output sinks:
+ * Every finished line goes to all the active sinks
+ * whose MinLogLvl it passes. Slot 0 is the 
+ * built-in transport (RML_LOG_SINK_TRANSPORT). A
+ * slot is claimed with a CAS and only published 
+ * (LOG_SINK_ACTIVE) once it is filled in, so 
+ * writers never see a half filled entry.
+ *************************************************/
+#define LOG_SINK_FREE			0
+#define LOG_SINK_BUSY			1			//Being filled in by RML_COMM_LogSinkAdd()
+#define LOG_SINK_ACTIVE			2
+#define LOG_LVL_NONE			0x07		//Level of RML_COMM_printf() output, it goes to every sink that isn't disabled
+
+static void LogSink_TransportWrite(const char *Buff, uint32_t Len, void *Ctx)
+{
+	(void)Ctx;
+	#if defined(RML_LOG_STATS_ENABLE)
+	uint64_t Start_us = Log_GetTimestamp_us();
+	Transport_Write(Buff, Len);
+	LogStats_Tx(Start_us);
+	#else
+	Transport_Write(Buff, Len);
+	#endif
+}
+
+static void LogSink_TransportFlush(void *Ctx)
+{
+	(void)Ctx;
+	#if defined(RML_LOG_STATS_ENABLE)
+	uint64_t Start_us = Log_GetTimestamp_us();
+	Transport_Flush();
+	LogStats_Tx(Start_us);
+	#else
+	Transport_Flush();
+	#endif
+}
+
+static LogSink_Struct LogSink_Table[RML_LOG_MAX_SINKS] = { { LogSink_TransportWrite, LogSink_TransportFlush, NULL, e_DEBUG } };
+static uint8_t LogSink_State[RML_LOG_MAX_SINKS] = { LOG_SINK_ACTIVE };
+static uint8_t LogSink_Pending = 0;				//Set when something was written since the last flush
+
+
+
+//Sends a buffer to every active sink that accepts its log level
+static void LogSink_WriteAll(const char *Buff, uint32_t Len, uint8_t LogLvl)
+{
+	/* No level: filtered like e_FATAL so only disabled sinks (e_FATAL + 1) skip it */
+	if( LogLvl > e_FATAL )
+	{
+		LogLvl = e_FATAL;
+	}
+
+	for( uint8_t i = 0; i < RML_LOG_MAX_SINKS; i++ )
+	{
+		if( __atomic_load_n(&LogSink_State[i], __ATOMIC_ACQUIRE) == LOG_SINK_ACTIVE 
+			&& LogLvl >= __atomic_load_n(&LogSink_Table[i].MinLogLvl, __ATOMIC_RELAXED) )
+		{
+			LogSink_Table[i].Write(Buff, Len, LogSink_Table[i].Ctx);
+		}
+	}
+	LogSink_Pending = 1;
+}
+
+//Ends a batch of writes: lets every sink push out what it buffered
+static void LogSink_FlushAll(void)
+{
+	if( !LogSink_Pending )
+	{
+		return;
+	}
+	LogSink_Pending = 0;
+
+	for( uint8_t i = 0; i < RML_LOG_MAX_SINKS; i++ )
+	{
+		if( __atomic_load_n(&LogSink_State[i], __ATOMIC_ACQUIRE) == LOG_SINK_ACTIVE && LogSink_Table[i].Flush != NULL )
+		{
+			LogSink_Table[i].Flush(LogSink_Table[i].Ctx);
+		}
+	}
+}
+
+
+
+/*********************************************
+ * Formatter output
+ *********************************************/
+/*************************************************
+ * @brief Formatter output struct:
+ * Where the formatter writes its output. Chars
+ * are appended to Buff, once it is full they are
+ * either dropped (truncated, but still counted)
+ * or, if ToTransport is set, the buffer is sent
+ * to the transport and reused so nothing is lost.
+ *************************************************/
+typedef struct
+{
+	char *Buff;						//Destination buffer
+	uint32_t Size;					//Max number of chars that can be written to Buff
+	uint32_t Len;					//Number of chars written so far
+	uint8_t ToTransport;			//1 to send Buff to the transport when full instead of truncating
+	uint32_t Truncated;				//Number of chars dropped because Buff was full
+} FmtOut_Struct;
+
+
+//Sends what was buffered so far to the sinks (RML_COMM_printf() output, so no log level)
+static void Fmt_Flush(FmtOut_Struct *Out)
+{
+	if( Out->Len > 0 )
+	{
+		LogSink_WriteAll(Out->Buff, Out->Len, LOG_LVL_NONE);
+		LOG_STAT_ADD(Bytes[LOG_STATS_LVL_OTHER], Out->Len);
+	}
+	Out->Len = 0;
+}
+
+//Output a single character
+static void Fmt_PutChar(FmtOut_Struct *Out, char Ch)
+{
+	if( Out->Len >= Out->Size && Out->ToTransport )
+	{
+		Fmt_Flush(Out);
+	}
+
+	if( Out->Len < Out->Size )
+	{
+		Out->Buff[Out->Len++] = Ch;
+	}
+	else
+	{
+		Out->Truncated++;
+	}
+}
+
+//Output a string
+static void Fmt_PutStr(FmtOut_Struct *Out, const char *Str)
+{
+	for(;;)
+	{
+		while( *Str && Out->Len < Out->Size )
+		{
+			Out->Buff[Out->Len++] = *Str++;
+		}
+
+		if( *Str == '\0' )
+		{
+			return;
+		}
+		if( !Out->ToTransport )
+		{
+			Out->Truncated += strlen(Str);
+			return;
+		}
+		Fmt_Flush(Out);
+	}
+}
+
+//Output Len chars of Str
+static void Fmt_PutStrN(FmtOut_Struct *Out, const char *Str, uint32_t Len)
+{
+	for(;;)
+	{
+		while( Len && Out->Len < Out->Size )
+		{
+			Out->Buff[Out->Len++] = *Str++;
+			Len--;
+		}
+
+		if( Len == 0 )
+		{
+			return;
+		}
+		if( !Out->ToTransport )
+		{
+			Out->Truncated += Len;
+			return;
+		}
+		Fmt_Flush(Out);
+	}
+}
+
+//Output Count copies of Ch
+static void Fmt_Repeat(FmtOut_Struct *Out, char Ch, int32_t Count)
+{
+	while( Count-- > 0 )
+	{
+		Fmt_PutChar(Out, Ch);
+	}
+}
+
+
+/*************************************************
+ * @brief Format specifier (FmtSpec_Struct) flags
+ * and conversions, parsed in one pass by 
+ * Fmt_ParseSpec():
+ * %[flags][width][.precision][length]conversion
+ *************************************************/
+#define FMT_FLAG_LEFT			0x01		//'-' left align in the field
+#define FMT_FLAG_PLUS			0x02		//'+' always print a sign
+#define FMT_FLAG_SPACE			0x04		//' ' print a space instead of '+'
+#define FMT_FLAG_ZERO			0x08		//'0' pad numbers with zeros instead of spaces
+#define FMT_FLAG_ALT			0x10		//'#' 0x prefix for hex
+#define FMT_FLAG_STAR_WIDTH		0x20		//Width was given as an arg ('*')
+#define FMT_FLAG_STAR_PREC		0x40		//Precision was given as an arg ('.*')
+
+#define FMT_CONV_UNKNOWN		0
+#define FMT_CONV_PERCENT		1
+#define FMT_CONV_STR			2
+#define FMT_CONV_CHAR			3
+#define FMT_CONV_SIGNED			4
+#define FMT_CONV_UNSIGNED		5			//u, x, X (Char tells them apart)
+#define FMT_CONV_FLOAT			6
+#define FMT_CONV_PTR			7
+#define FMT_CONV_COUNT			8
+
+#define FMT_MAX_WIDTH			1000		//Longer widths/precisions are clamped
+
+#define FMT_PROG_EMPTY			0			//FmtProgram_Struct.State: not compiled yet (zero-initialized static)
+#define FMT_PROG_BUSY			1			//Being compiled by another task
+#define FMT_PROG_READY			2			//Compiled
+#define FMT_PROG_PARSE			3			//Can't be compiled ('*' args or too many specifiers), parsed on every call
+
+//Conversion of each lower case letter 'a'..'z'. Upper case letters only exist for 'X' and 'F'
+static const uint8_t FmtConv_LUT[26] = 
+{
+	/* a */ FMT_CONV_UNKNOWN,	/* b */ FMT_CONV_UNKNOWN,	/* c */ FMT_CONV_CHAR,		/* d */ FMT_CONV_SIGNED,
+	/* e */ FMT_CONV_UNKNOWN,	/* f */ FMT_CONV_FLOAT,		/* g */ FMT_CONV_UNKNOWN,	/* h */ FMT_CONV_UNKNOWN,
+	/* i */ FMT_CONV_SIGNED,	/* j */ FMT_CONV_UNKNOWN,	/* k */ FMT_CONV_UNKNOWN,	/* l */ FMT_CONV_UNKNOWN,
+	/* m */ FMT_CONV_UNKNOWN,	/* n */ FMT_CONV_UNKNOWN,	/* o */ FMT_CONV_UNKNOWN,	/* p */ FMT_CONV_PTR,
+	/* q */ FMT_CONV_UNKNOWN,	/* r */ FMT_CONV_UNKNOWN,	/* s */ FMT_CONV_STR,		/* t */ FMT_CONV_UNKNOWN,
+	/* u */ FMT_CONV_UNSIGNED,	/* v */ FMT_CONV_UNKNOWN,	/* w */ FMT_CONV_UNKNOWN,	/* x */ FMT_CONV_UNSIGNED,
+	/* y */ FMT_CONV_UNKNOWN,	/* z */ FMT_CONV_UNKNOWN
+};
+
+//Reads a decimal number (clamped to FMT_MAX_WIDTH), moves Str past it
+static uint16_t Fmt_ParseNum(const char **Str)
+{
+	uint32_t Num = 0;
+
+	while( **Str >= '0' && **Str <= '9' )
+	{
+		Num = Num * 10 + (uint32_t)(*(*Str)++ - '0');
+		if( Num > FMT_MAX_WIDTH )
+		{
+			Num = FMT_MAX_WIDTH;
+		}
+	}
+
+	return (uint16_t)Num;
+}
+
+//Parses the specifier that starts right after a '%', '*' widths/precisions are read from Args. Returns the 
+//position after the conversion char (or at the '\0' if the string ended early)
+static const char* Fmt_ParseSpec(const char *Str, FmtSpec_Struct *Spec, va_list *Args)
+{
+	int32_t StarArg;
+
+	Spec->Flags = 0;
+	Spec->Width = 0;
+	Spec->Precision = -1;
+	Spec->Length = 0;
+
+	/* Flags */
+	for(;; Str++)
+	{
+		if( *Str == '-' )		Spec->Flags |= FMT_FLAG_LEFT;
+		else if( *Str == '+' )	Spec->Flags |= FMT_FLAG_PLUS;
+		else if( *Str == ' ' )	Spec->Flags |= FMT_FLAG_SPACE;
+		else if( *Str == '0' )	Spec->Flags |= FMT_FLAG_ZERO;
+		else if( *Str == '#' )	Spec->Flags |= FMT_FLAG_ALT;
+		else					break;
+	}
+
+	/* Width, a negative '*' width means left aligned */
+	if( *Str == '*' )
+	{
+		StarArg = va_arg(*Args, int);
+		Spec->Flags |= FMT_FLAG_STAR_WIDTH | ((StarArg < 0) ? FMT_FLAG_LEFT : 0);
+		StarArg = (StarArg < 0) ? -StarArg : StarArg;
+		Spec->Width = (uint16_t)((StarArg > FMT_MAX_WIDTH) ? FMT_MAX_WIDTH : StarArg);
+		Str++;
+	}
+	else
+	{
+		Spec->Width = Fmt_ParseNum(&Str);
+	}
+
+	/* Precision, a negative '*' precision is the same as none */
+	if( *Str == '.' )
+	{
+		Str++;
+		if( *Str == '*' )
+		{
+			StarArg = va_arg(*Args, int);
+			Spec->Flags |= FMT_FLAG_STAR_PREC;
+			Spec->Precision = (int16_t)((StarArg < 0) ? -1 : (StarArg > FMT_MAX_WIDTH) ? FMT_MAX_WIDTH : StarArg);
+			Str++;
+		}
+		else
+		{
+			Spec->Precision = (int16_t)Fmt_ParseNum(&Str);
+		}
+	}
+
+	/* Length */
+	if( *Str == 'h' || *Str == 'l' )
+	{
+		Spec->Length = *Str++;
+		if( *Str == Spec->Length )
+		{
+			Spec->Length = (Spec->Length == 'h') ? 'H' : 'L';
+			Str++;
+		}
+	}
+	else if( *Str == 'z' )
+	{
+		Spec->Length = *Str++;
+	}
+
+	/* Conversion */
+	Spec->Char = *Str;
+	if( *Str == '%' )
+	{
+		Spec->Conv = FMT_CONV_PERCENT;
+	}
+	else if( *Str >= 'a' && *Str <= 'z' )
+	{
+		Spec->Conv = FmtConv_LUT[*Str - 'a'];
+	}
+	else if( *Str == 'X' || *Str == 'F' )
+	{
+		Spec->Conv = FmtConv_LUT[*Str - 'A'];
+	}
+	else
+	{
+		Spec->Conv = FMT_CONV_UNKNOWN;
+	}
+
+	return *Str ? Str + 1 : Str;
+}
+
+//Starts a field: leading spaces, Prefix (sign/0x) then leading zeros (Zeros + the padding when ZeroPad is set) for
+//a BodyLen chars long body. Returns the number of trailing spaces to pass to Fmt_FieldEnd() once the body is out
+static int32_t Fmt_FieldBegin(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, const char *Prefix, uint32_t BodyLen, 
+							  uint32_t Zeros, uint8_t ZeroPad)
+{
+	int32_t Pad = (int32_t)Spec->Width - (int32_t)(strlen(Prefix) + Zeros + BodyLen);
+
+	if( Spec->Flags & FMT_FLAG_LEFT )
+	{
+		Fmt_PutStr(Out, Prefix);
+		Fmt_Repeat(Out, '0', Zeros);
+		return Pad;
+	}
+
+	if( ZeroPad )
+	{
+		Zeros += (Pad > 0) ? Pad : 0;
+	}
+	else
+	{
+		Fmt_Repeat(Out, ' ', Pad);
+	}
+	Fmt_PutStr(Out, Prefix);
+	Fmt_Repeat(Out, '0', Zeros);
+
+	return 0;
+}
+
+//Ends a field started with Fmt_FieldBegin()
+static void Fmt_FieldEnd(FmtOut_Struct *Out, int32_t Pad)
+{
+	Fmt_Repeat(Out, ' ', Pad);
+}
+
+static void Fmt_vformat(FmtOut_Struct *Out, const char *InputStr, va_list VaList);
+static void Fmt_vformatCompiled(FmtOut_Struct *Out, const FmtProgram_Struct *Prog, const char *Fmt, va_list VaList);
+static int8_t Fmt_Compile(FmtProgram_Struct *Prog, const char *Fmt);
+static void Fmt_Float(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, double Value);
+static int32_t Utoa_Core(uint32_t Value, char *ResultBuff, uint32_t ResultBuff_Size, uint8_t Base);
+static void Utoa10_WriteFixed(uint64_t Value, char *End, uint32_t Digits);
+
+
+
+/*********************************************
+ * Async ring buffer
+ *********************************************/
+/*
+ * The ring buffer is a multi-producer, single-consumer byte ring made of variable
+ * length records. Producers reserve space by moving 'Head' forward with a CAS, copy
+ * their record in and then commit it by writing its 'Stamp' (the absolute position 
+ * of the record) last. The drain only consumes a record once its stamp matches the
+ * position it expects, so no lock is ever taken. Records never wrap, if one doesn't
+ * fit at the end of the ring a padding record is inserted first.
+ * On multi-core chips (LOG_RINGS > 1) each core gets its own ring, so producers on
+ * different cores never fight over the same Head. Records then also carry the time
+ * they were queued at and the drain always takes the oldest of the rings' first records.
+ * A task moved to another core while queuing only means two producers share a ring
+ * for that record, which the CAS already handles.
+ */
+#ifndef LOG_RINGS
+#define LOG_RINGS				1
+#define LOG_RING_ID()			0
+#endif
+
+#define LOGREC_HDR_SIZE			sizeof(LogRecHdr_Struct)
+#define LOGREC_ALIGN(_len)		(((_len) + LOGREC_HDR_SIZE - 1) & ~(uint32_t)(LOGREC_HDR_SIZE - 1))		//Records are kept header size aligned so headers never straddle
+#define LOG_RING_WAKE_LEVEL(_ring)	(((_ring)->Size / 100) * RML_LOG_ASYNC_WAKE_PERCENT)		//Fill level where producers wake the drain early
+#define LOGREC_FLAG_LVL_MASK	0x07								//Bits 0-2 of the flags hold the log level
+#define LOGREC_LVL_NONE			LOG_LVL_NONE						//Used for RML_COMM_printf() output
+#define LOGREC_FLAG_PAD			0x80								//Padding record, skipped by the drain
+
+/***************************************
+ * @brief Record header, followed by
+ * the payload in the ring
+ ***************************************/
+typedef struct
+{
+	uint32_t Stamp;					//Absolute position of the record, written last to commit it
+	uint32_t Info;					//Payload length (bits 0-15), flags (bits 16-23) and a check byte (bits 24-31)
+#if LOG_RINGS > 1
+	uint32_t Time_us;				//When the record was queued (low 32 bits), orders the records of different rings
+	uint32_t Reserved;				//Keeps the header size a power of 2
+#endif
+} LogRecHdr_Struct;
+
+/***************************************
+ * @brief Ring buffer state
+ ***************************************/
+typedef struct
+{
+	uint8_t *Buff;					//Ring storage, allocated once in RML_COMM_LoggerInit()
+	uint32_t Size;					//Size of Buff in bytes, always a power of 2
+	uint32_t Head;					//Producers reserve space by moving this forward (free running, masked on access)
+	uint32_t Tail;					//The drain (and e_OVERFLOW_DROP_OLD producers) release space by moving this forward
+	uint8_t OverflowPolicy;			//LogOverflow_Enum
+} LogRing_Struct;
+
+static LogRing_Struct LogRings[LOG_RINGS];
+static uint8_t LogDrain_Busy = 0;				//Set while someone (the drain or RML_COMM_LogFlush()) moves records to the sinks
+static uint8_t LogAsync_Running = 0;			//Set once the ring buffer and the drain are up
+
+#if LOG_FREERTOS
+static TaskHandle_t LogDrainTaskHandle = NULL;
+#else
+static pthread_t LogDrainThread;
+static pthread_mutex_t LogAsync_Mutex = PTHREAD_MUTEX_INITIALIZER;		//Guards the wake flag and the two conditions below
+static pthread_cond_t LogAsync_DrainCond = PTHREAD_COND_INITIALIZER;	//Signalled to wake the drain thread up
+static pthread_cond_t LogAsync_SpaceCond = PTHREAD_COND_INITIALIZER;	//Broadcast by the drain once it freed room for blocked producers
+static uint8_t LogAsync_WakePending = 0;		//Set by a wake the drain thread hasn't seen yet
+static uint32_t LogAsync_Waiters = 0;			//Producers waiting on LogAsync_SpaceCond
+#endif
+
+
+//Builds the info word of a record header, the check byte guards against stale bytes that happen to match a stamp
+static inline uint32_t LogRec_Info(uint32_t Stamp, uint32_t Len, uint32_t Flags)
+{
+	uint32_t Check = (Stamp ^ (Stamp >> 8) ^ (Stamp >> 16) ^ (Stamp >> 24) ^ Len ^ (Len >> 8) ^ Flags ^ 0x5A) & 0xFF;
+	return (Len & 0xFFFF) | ((Flags & 0xFF) << 16) | (Check << 24);
+}
+
+//Writes a record at the reserved position and commits it
+static void LogRing_Commit(LogRing_Struct *Ring, uint32_t Pos, const char *Data, uint32_t Len, uint8_t Flags, uint32_t Time_us)
+{
+	LogRecHdr_Struct *Hdr = (LogRecHdr_Struct*)&Ring->Buff[Pos & (Ring->Size - 1)];
+
+	Hdr->Info = LogRec_Info(Pos, Len, Flags);
+	#if LOG_RINGS > 1
+	Hdr->Time_us = Time_us;
+	#endif
+	(void)Time_us;
+	if( Data != NULL )
+	{
+		memcpy(Hdr + 1, Data, Len);
+	}
+	__atomic_store_n(&Hdr->Stamp, Pos, __ATOMIC_RELEASE);
+}
+
+//Checks if the record at position 'Pos' is committed and gets its length and flags. Returns 1 if it is, 0 if not
+static uint8_t LogRing_Peek(LogRing_Struct *Ring, uint32_t Pos, uint32_t *Len, uint8_t *Flags)
+{
+	uint32_t Offset = Pos & (Ring->Size - 1);
+	LogRecHdr_Struct *Hdr = (LogRecHdr_Struct*)&Ring->Buff[Offset];
+	uint32_t Info;
+
+	if( __atomic_load_n(&Hdr->Stamp, __ATOMIC_ACQUIRE) != Pos )
+	{
+		return 0;
+	}
+
+	Info = __atomic_load_n(&Hdr->Info, __ATOMIC_RELAXED);
+	*Len = Info & 0xFFFF;
+	*Flags = (Info >> 16) & 0xFF;
+
+	/* Make sure the header is sane before trusting it */
+	if( LogRec_Info(Pos, *Len, *Flags) != Info || Offset + LOGREC_HDR_SIZE + LOGREC_ALIGN(*Len) > Ring->Size )
+	{
+		return 0;
+	}
+
+	return 1;
+}
+
+//Evicts the oldest record (e_OVERFLOW_DROP_OLD). Returns 1 if progress was made and the caller should retry, 0 if not
+static uint8_t LogRing_DropOldest(LogRing_Struct *Ring, uint32_t Tail)
+{
+	uint32_t Len;
+	uint8_t Flags;
+
+	/* The oldest record is still being written by another producer, nothing we can do */
+	if( !LogRing_Peek(Ring, Tail, &Len, &Flags) )
+	{
+		return 0;
+	}
+
+	if( __atomic_compare_exchange_n(&Ring->Tail, &Tail, Tail + LOGREC_HDR_SIZE + LOGREC_ALIGN(Len), 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) )
+	{
+		if( !(Flags & LOGREC_FLAG_PAD) )
+		{
+			__atomic_fetch_add(&Log_DroppedCount, 1, __ATOMIC_RELAXED);
+		}
+	}
+
+	return 1;
+}
+
+//Wakes the drain up
+static void LogAsync_Wake(uint8_t FromISR)
+{
+	#if LOG_FREERTOS
+	BaseType_t Woken = pdFALSE;
+
+	if( LogDrainTaskHandle == NULL )
+	{
+		return;
+	}
+
+	if( FromISR )
+	{
+		vTaskNotifyGiveFromISR(LogDrainTaskHandle, &Woken);
+		portYIELD_FROM_ISR(Woken);
+	}
+	else
+	{
+		xTaskNotifyGive(LogDrainTaskHandle);
+	}
+	#else
+	(void)FromISR;
+	pthread_mutex_lock(&LogAsync_Mutex);
+	LogAsync_WakePending = 1;
+	pthread_cond_signal(&LogAsync_DrainCond);
+	pthread_mutex_unlock(&LogAsync_Mutex);
+	#endif
+}
+
+//Checks if the caller is allowed to wait for room in the ring buffer (e_OVERFLOW_BLOCK)
+static uint8_t LogAsync_CanBlock(uint8_t FromISR)
+{
+	if( FromISR )
+	{
+		return 0;
+	}
+
+	#if LOG_FREERTOS
+	return (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING && xTaskGetCurrentTaskHandle() != LogDrainTaskHandle);
+	#else
+	return !pthread_equal(pthread_self(), LogDrainThread);
+	#endif
+}
+
+//Gives the drain some time to make room in the ring buffer
+static void LogAsync_Sleep(void)
+{
+	#if LOG_FREERTOS
+	vTaskDelay(1);
+	#else
+	usleep(1000);
+	#endif
+}
+
+//Waits for the drain to free room in a full ring (e_OVERFLOW_BLOCK). Tail is the ring's tail the caller found full.
+//Native threads sleep until the drain signals, FreeRTOS tasks give it a tick
+static void LogAsync_WaitSpace(LogRing_Struct *Ring, uint32_t Tail)
+{
+	#if LOG_FREERTOS
+	(void)Ring;
+	(void)Tail;
+	vTaskDelay(1);
+	#else
+	struct timespec Deadline;
+
+	Native_Deadline(RML_LOG_ASYNC_DRAIN_PERIOD_MS, &Deadline);
+	pthread_mutex_lock(&LogAsync_Mutex);
+	__atomic_fetch_add(&LogAsync_Waiters, 1, __ATOMIC_SEQ_CST);
+
+	/* The tail is checked after announcing ourselves, so a drain that moved it before seeing us can't be missed */
+	while( __atomic_load_n(&Ring->Tail, __ATOMIC_SEQ_CST) == Tail && 
+		   pthread_cond_timedwait(&LogAsync_SpaceCond, &LogAsync_Mutex, &Deadline) == 0 )
+	{
+	}
+
+	__atomic_fetch_sub(&LogAsync_Waiters, 1, __ATOMIC_RELAXED);
+	pthread_mutex_unlock(&LogAsync_Mutex);
+	#endif
+}
+
+//Lets blocked producers know the drain freed room in a ring
+static void LogAsync_SpaceFreed(void)
+{
+	#if !LOG_FREERTOS
+	__atomic_thread_fence(__ATOMIC_SEQ_CST);				//Pairs with the waiter count taken before the tail check
+	if( __atomic_load_n(&LogAsync_Waiters, __ATOMIC_RELAXED) > 0 )
+	{
+		pthread_mutex_lock(&LogAsync_Mutex);
+		pthread_cond_broadcast(&LogAsync_SpaceCond);
+		pthread_mutex_unlock(&LogAsync_Mutex);
+	}
+	#endif
+}
+
+//Queues a record into the ring buffer of the calling core, never blocks when called from an ISR. Returns 0 on success, -1 if 
+//the record was dropped
+static int8_t LogRing_Push(const char *Data, uint32_t Len, uint8_t Flags, uint8_t FromISR)
+{
+	LogRing_Struct *Ring = &LogRings[LOG_RING_ID()];
+	uint32_t Need = LOGREC_HDR_SIZE + LOGREC_ALIGN(Len);
+	uint32_t Head, Tail, Offset, Pad;
+	#if LOG_RINGS > 1
+	uint32_t Time_us = (uint32_t)Log_GetTimestamp_us();
+	#else
+	uint32_t Time_us = 0;
+	#endif
+
+	for(;;)
+	{
+		Head = __atomic_load_n(&Ring->Head, __ATOMIC_RELAXED);
+		Tail = __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE);
+		Offset = Head & (Ring->Size - 1);
+		Pad = (Offset + Need > Ring->Size) ? (Ring->Size - Offset) : 0;
+
+		/* Ring buffer is full, apply the overflow policy: */
+		if( (Head + Pad + Need) - Tail > Ring->Size )
+		{
+			if( Ring->OverflowPolicy == e_OVERFLOW_DROP_OLD && LogRing_DropOldest(Ring, Tail) )
+			{
+				continue;
+			}
+			if( Ring->OverflowPolicy == e_OVERFLOW_BLOCK && LogAsync_CanBlock(FromISR) )
+			{
+				LogAsync_Wake(FromISR);
+				LogAsync_WaitSpace(Ring, Tail);
+				continue;
+			}
+
+			__atomic_fetch_add(&Log_DroppedCount, 1, __ATOMIC_RELAXED);
+			return -1;
+		}
+
+		/* Reserve the space, if another producer beat us to it try again */
+		if( __atomic_compare_exchange_n(&Ring->Head, &Head, Head + Pad + Need, 1, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) )
+		{
+			break;
+		}
+	}
+	LogStats_BuffUsed((Head + Pad + Need) - Tail);
+
+	if( Pad )
+	{
+		LogRing_Commit(Ring, Head, NULL, Pad - LOGREC_HDR_SIZE, LOGREC_FLAG_PAD, Time_us);		//Same time as its record so the merge order holds
+	}
+	LogRing_Commit(Ring, Head + Pad, Data, Len, Flags, Time_us);
+
+	/* Only poke the drain when it is likely idle or the ring is filling up, else it will pick the record up on its own */
+	if( Head == Tail || 
+		((Head - Tail) < LOG_RING_WAKE_LEVEL(Ring) && (Head + Pad + Need) - Tail >= LOG_RING_WAKE_LEVEL(Ring)) )
+	{
+		LogAsync_Wake(FromISR);
+	}
+
+	return 0;
+}
+
+//Takes the oldest committed record out of a ring buffer. Returns 1 if a record was copied into Out, 0 if the ring is empty
+static uint8_t LogRing_Pop(LogRing_Struct *Ring, char *Out, uint32_t OutSize, uint32_t *OutLen, uint8_t *OutFlags)
+{
+	uint32_t Tail, Len, CopyLen;
+	uint8_t Flags;
+
+	for(;;)
+	{
+		Tail = __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE);
+		if( Tail == __atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE) || !LogRing_Peek(Ring, Tail, &Len, &Flags) )
+		{
+			return 0;
+		}
+
+		/* Copy out first, the record only belongs to us once Tail was moved past it (drop-old producers race us) */
+		CopyLen = (Len < OutSize) ? Len : OutSize;
+		if( !(Flags & LOGREC_FLAG_PAD) )
+		{
+			memcpy(Out, &Ring->Buff[(Tail & (Ring->Size - 1)) + LOGREC_HDR_SIZE], CopyLen);
+		}
+
+		if( __atomic_compare_exchange_n(&Ring->Tail, &Tail, Tail + LOGREC_HDR_SIZE + LOGREC_ALIGN(Len), 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) 
+			&& !(Flags & LOGREC_FLAG_PAD) )
+		{
+			*OutLen = CopyLen;
+			*OutFlags = Flags;
+			return 1;
+		}
+	}
+}
+
+//Picks the ring whose first committed record was queued first. Returns NULL if all rings are empty
+static LogRing_Struct* LogRing_Oldest(void)
+{
+	#if LOG_RINGS > 1
+	LogRing_Struct *Oldest = NULL;
+	uint32_t Oldest_us = 0;
+	uint32_t Tail, Len;
+	uint8_t Flags;
+
+	for( uint32_t i = 0; i < LOG_RINGS; i++ )
+	{
+		LogRing_Struct *Ring = &LogRings[i];
+
+		Tail = __atomic_load_n(&Ring->Tail, __ATOMIC_ACQUIRE);
+		if( Tail == __atomic_load_n(&Ring->Head, __ATOMIC_ACQUIRE) || !LogRing_Peek(Ring, Tail, &Len, &Flags) )
+		{
+			continue;
+		}
+
+		/* Wrap safe compare, the time is only the low 32 bits */
+		uint32_t Time_us = ((LogRecHdr_Struct*)&Ring->Buff[Tail & (Ring->Size - 1)])->Time_us;
+		if( Oldest == NULL || (int32_t)(Time_us - Oldest_us) < 0 )
+		{
+			Oldest = Ring;
+			Oldest_us = Time_us;
+		}
+	}
+
+	return Oldest;
+	#else
+	return &LogRings[0];
+	#endif
+}
+
+//Locks out other drainers so records reach the sinks in order, waiting at most Timeout_ms. Returns 1 if locked
+static uint8_t LogDrain_Lock(uint32_t Timeout_ms)
+{
+	uint32_t Start_ms = Log_GetTime_ms();
+	uint8_t Expected;
+
+	for(;;)
+	{
+		Expected = 0;
+		if( __atomic_compare_exchange_n(&LogDrain_Busy, &Expected, 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+		{
+			return 1;
+		}
+		if( !LogAsync_CanBlock(0) || Log_GetTime_ms() - Start_ms >= Timeout_ms )
+		{
+			return 0;
+		}
+		LogAsync_Sleep();
+	}
+}
+
+static void LogDrain_Unlock(void)
+{
+	__atomic_store_n(&LogDrain_Busy, 0, __ATOMIC_RELEASE);
+}
+
+//Moves everything in the ring buffers to the sinks, oldest first. The caller holds the drain lock
+static void LogRing_DrainLocked(void)
+{
+	char Line[RML_LOG_LINE_MAX_SIZE];
+	LogRing_Struct *Ring;
+	uint32_t Len;
+	uint8_t Flags;
+
+	while( (Ring = LogRing_Oldest()) != NULL && LogRing_Pop(Ring, Line, sizeof(Line), &Len, &Flags) )
+	{
+		LogAsync_SpaceFreed();
+		LogSink_WriteAll(Line, Len, Flags & LOGREC_FLAG_LVL_MASK);
+	}
+}
+
+//Checks if the drain got past the positions the rings' heads were at in Target. Returns 1 if it did
+static uint8_t LogRing_Reached(const uint32_t *Target)
+{
+	for( uint32_t i = 0; i < LOG_RINGS; i++ )
+	{
+		if( (int32_t)(__atomic_load_n(&LogRings[i].Tail, __ATOMIC_ACQUIRE) - Target[i]) < 0 )
+		{
+			return 0;
+		}
+	}
+	return 1;
+}
+
+//Moves everything in the ring buffers to the sinks, they are flushed once the rings are empty. Returns 0 if someone
+//else was draining already
+static uint8_t LogRing_Drain(void)
+{
+	if( !LogDrain_Lock(0) )
+	{
+		return 0;
+	}
+	LogRing_DrainLocked();
+	LogSink_FlushAll();
+	LogDrain_Unlock();
+
+	return 1;
+}
+
+#if LOG_FREERTOS
+//Drain task, sleeps until a producer wakes it up or the drain period passes
+static void LogDrain_Task(void *Param)
+{
+	(void)Param;
+
+	for(;;)
+	{
+		LogRing_Drain();
+		ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(RML_LOG_ASYNC_DRAIN_PERIOD_MS));
+	}
+}
+#else
+//Drain thread, sleeps until a producer wakes it up or the drain period passes
+static void* LogDrain_Thread(void *Param)
+{
+	struct timespec Deadline;
+	(void)Param;
+
+	for(;;)
+	{
+		LogRing_Drain();
+
+		Native_Deadline(RML_LOG_ASYNC_DRAIN_PERIOD_MS, &Deadline);
+		pthread_mutex_lock(&LogAsync_Mutex);
+		while( !LogAsync_WakePending && pthread_cond_timedwait(&LogAsync_DrainCond, &LogAsync_Mutex, &Deadline) == 0 )
+		{
+		}
+		LogAsync_WakePending = 0;
+		pthread_mutex_unlock(&LogAsync_Mutex);
+	}
+
+	return NULL;
+}
+#endif
+
+//Frees the ring buffers after a failed start
+static void LogAsync_Free(void)
+{
+	for( uint32_t i = 0; i < LOG_RINGS; i++ )
+	{
+		if( LogRings[i].Buff != NULL )
+		{
+			LOG_FREE(LogRings[i].Buff);
+			LogRings[i].Buff = NULL;
+		}
+	}
+}
+
+//Allocates the ring buffers and starts the drain. Returns 0 on success, -1 on failure
+static int8_t LogAsync_Start(GenericUART_Struct *UARTComm)
+{
+	uint32_t Size = 64;
+	uint32_t Wanted = (UARTComm->AsyncBuffSize == 0) ? RML_LOG_ASYNC_DEFAULT_BUFF_SIZE : UARTComm->AsyncBuffSize;
+
+	/* The rings share the size, each is rounded up to a power of 2 so positions can be masked */
+	Wanted /= LOG_RINGS;
+	if( Wanted < 2 * (LOGREC_HDR_SIZE + LOGREC_ALIGN(RML_LOG_LINE_MAX_SIZE)) )
+	{
+		Wanted = 2 * (LOGREC_HDR_SIZE + LOGREC_ALIGN(RML_LOG_LINE_MAX_SIZE));
+	}
+	while( Size < Wanted )
+	{
+		Size <<= 1;
+	}
+
+	for( uint32_t i = 0; i < LOG_RINGS; i++ )
+	{
+		LogRing_Struct *Ring = &LogRings[i];
+
+		Ring->Buff = (uint8_t*)LOG_MALLOC(Size);
+		if( Ring->Buff == NULL )
+		{
+			LogAsync_Free();
+			return -1;
+		}
+		memset(Ring->Buff, 0xFF, Size);
+		Ring->Size = Size;
+		Ring->Head = 0;
+		Ring->Tail = 0;
+		Ring->OverflowPolicy = UARTComm->AsyncOverflowPolicy;
+	}
+
+	#if defined(ESP32)
+	if( xTaskCreatePinnedToCore(LogDrain_Task, "RML_LogDrain", RML_LOG_ASYNC_DRAIN_STACK_SIZE, NULL, RML_LOG_ASYNC_DRAIN_PRIORITY, &LogDrainTaskHandle, RML_LOG_ASYNC_DRAIN_CORE) != pdPASS )
+	{
+		LogAsync_Free();
+		return -1;
+	}
+	#elif LOG_FREERTOS
+	if( xTaskCreate(LogDrain_Task, "RML_LogDrain", RML_LOG_ASYNC_DRAIN_STACK_SIZE, NULL, RML_LOG_ASYNC_DRAIN_PRIORITY, &LogDrainTaskHandle) != pdPASS )
+	{
+		LogAsync_Free();
+		return -1;
+	}
+	#else
+	if( pthread_create(&LogDrainThread, NULL, LogDrain_Thread, NULL) != 0 )
+	{
+		LogAsync_Free();
+		return -1;
+	}
+	#endif
+
+	LogAsync_Running = 1;
+	return 0;
+}
+
+
+
+
+
+
+//Takes the sync mode logger lock, waiting at most LogLock_Timeout_ms. Returns 1 if taken, 2 if there was nothing to take, 0 on timeout
+static uint8_t LogLock_Take(void)
+{
+	#if LOG_FREERTOS
+	/* Before the scheduler runs there is only one caller, nothing to serialize */
+	if( LogMutex == NULL || xTaskGetSchedulerState() != taskSCHEDULER_RUNNING )
+	{
+		return 2;
+	}
+
+	return (xSemaphoreTake(LogMutex, pdMS_TO_TICKS(LogLock_Timeout_ms)) == pdTRUE) ? 1 : 0;
+	#else
+	struct timespec Deadline;
+
+	if( pthread_mutex_trylock(&LogMutex) == 0 )
+	{
+		return 1;
+	}
+
+	Native_Deadline(LogLock_Timeout_ms, &Deadline);
+	return (pthread_mutex_timedlock(&LogMutex, &Deadline) == 0) ? 1 : 0;
+	#endif
+}
+
+//Gives back the lock taken by LogLock_Take()
+static void LogLock_Give(uint8_t Taken)
+{
+	#if LOG_FREERTOS
+	if( Taken == 1 )
+	{
+		xSemaphoreGive(LogMutex);
+	}
+	#else
+	if( Taken == 1 )
+	{
+		pthread_mutex_unlock(&LogMutex);
+	}
+	#endif
+}
+
+
+
+/*********************************************
+ * Batches
+ *********************************************/
+/*
+ * Between RML_COMM_LogBatchBegin() and RML_COMM_LogBatchEnd() the lines of the task that opened the batch are
+ * appended to LogBatch.Buff instead of being sent, with where each one ends and its level so every sink still only
+ * gets the lines it accepts. The batch is sent when it ends (or fills up) with one write per sink for each run of
+ * accepted lines, so nothing from other tasks lands in the middle. There is one batch at a time: it is claimed with
+ * a CAS and only published (LOG_BATCH_OPEN) once the owner is set.
+ */
+#if RML_LOG_BATCH_BUFF_SIZE < RML_LOG_LINE_MAX_SIZE || RML_LOG_BATCH_BUFF_SIZE > 0xFFFF
+#error "RML_LOG_BATCH_BUFF_SIZE must be between RML_LOG_LINE_MAX_SIZE and 65535"
+#endif
+#define LOG_BATCH_FREE			0
+#define LOG_BATCH_BUSY			1			//Being claimed by RML_COMM_LogBatchBegin()
+#define LOG_BATCH_OPEN			2
+
+typedef struct
+{
+	char *Buff;										//RML_LOG_BATCH_BUFF_SIZE bytes, allocated by the first batch
+	uint32_t Len;									//Bytes held
+	uint16_t LineEnd[RML_LOG_BATCH_MAX_LINES];		//Where each line ends in Buff
+	uint8_t LineLvl[RML_LOG_BATCH_MAX_LINES];		//Log level of each line
+	uint8_t Lines;									//Number of lines held
+	uint8_t State;									//LOG_BATCH_FREE/BUSY/OPEN
+	uintptr_t Owner;								//Task (thread on native) that opened the batch
+} LogBatch_Struct;
+
+static LogBatch_Struct LogBatch;
+
+//Identifies the calling task (thread on native)
+static uintptr_t Log_TaskId(void)
+{
+	#if LOG_FREERTOS
+	return (uintptr_t)xTaskGetCurrentTaskHandle();
+	#else
+	return (uintptr_t)pthread_self();
+	#endif
+}
+
+//Checks if the caller owns the open batch (never true in an interrupt)
+static uint8_t LogBatch_IsMine(uint8_t FromISR)
+{
+	return !FromISR && __atomic_load_n(&LogBatch.State, __ATOMIC_ACQUIRE) == LOG_BATCH_OPEN && LogBatch.Owner == Log_TaskId();
+}
+
+//Writes the batch to every active sink, one write per run of lines the sink accepts
+static void LogBatch_WriteAll(void)
+{
+	uint32_t RunStart, LineStart;
+	uint8_t MinLogLvl, LogLvl;
+
+	for( uint8_t i = 0; i < RML_LOG_MAX_SINKS; i++ )
+	{
+		if( __atomic_load_n(&LogSink_State[i], __ATOMIC_ACQUIRE) != LOG_SINK_ACTIVE )
+		{
+			continue;
+		}
+		MinLogLvl = __atomic_load_n(&LogSink_Table[i].MinLogLvl, __ATOMIC_RELAXED);
+
+		RunStart = 0;
+		LineStart = 0;
+		for( uint8_t Line = 0; Line < LogBatch.Lines; Line++ )
+		{
+			/* No level: filtered like e_FATAL, same as LogSink_WriteAll() */
+			LogLvl = (LogBatch.LineLvl[Line] > e_FATAL) ? (uint8_t)e_FATAL : LogBatch.LineLvl[Line];
+			if( LogLvl < MinLogLvl )
+			{
+				if( LineStart > RunStart )
+				{
+					LogSink_Table[i].Write(&LogBatch.Buff[RunStart], LineStart - RunStart, LogSink_Table[i].Ctx);
+				}
+				RunStart = LogBatch.LineEnd[Line];
+			}
+			LineStart = LogBatch.LineEnd[Line];
+		}
+		if( LineStart > RunStart )
+		{
+			LogSink_Table[i].Write(&LogBatch.Buff[RunStart], LineStart - RunStart, LogSink_Table[i].Ctx);
+		}
+	}
+	LogSink_Pending = 1;
+}
+
+//Sends the lines held by the batch, called by its owner
+static void LogBatch_Send(void)
+{
+	uint8_t Taken;
+
+	if( LogBatch.Lines == 0 )
+	{
+		return;
+	}
+
+	if( LogAsync_Running )
+	{
+		/* What was queued before goes out first, the drain is locked out while the batch is written */
+		Taken = LogDrain_Lock(LogLock_Timeout_ms);
+		if( Taken )
+		{
+			LogRing_DrainLocked();
+			LogBatch_WriteAll();
+			LogSink_FlushAll();
+			LogDrain_Unlock();
+		}
+	}
+	else
+	{
+		Taken = LogLock_Take();
+		if( Taken )
+		{
+			LogBatch_WriteAll();
+			LogSink_FlushAll();
+			LogLock_Give(Taken);
+		}
+	}
+
+	if( !Taken )
+	{
+		__atomic_fetch_add(&Log_DroppedCount, LogBatch.Lines, __ATOMIC_RELAXED);
+	}
+	LogBatch.Len = 0;
+	LogBatch.Lines = 0;
+}
+
+//Adds a line to the caller's batch, sending the batch first if the line doesn't fit. Returns 0 if the line is too
+//long for any batch, it should then be sent as usual
+static uint8_t LogBatch_Append(const char *Line, uint32_t Len, uint8_t Flags)
+{
+	if( Len > RML_LOG_BATCH_BUFF_SIZE )
+	{
+		LogBatch_Send();
+		return 0;
+	}
+	if( LogBatch.Len + Len > RML_LOG_BATCH_BUFF_SIZE || LogBatch.Lines == RML_LOG_BATCH_MAX_LINES )
+	{
+		LogBatch_Send();
+	}
+
+	memcpy(&LogBatch.Buff[LogBatch.Len], Line, Len);
+	LogBatch.Len += Len;
+	LogBatch.LineEnd[LogBatch.Lines] = (uint16_t)LogBatch.Len;
+	LogBatch.LineLvl[LogBatch.Lines] = Flags & LOGREC_FLAG_LVL_MASK;
+	LogBatch.Lines++;
+
+	return 1;
+}
+
+#if defined(RML_LOG_CRASHLOG_ENABLE)
+/*********************************************
+ * Crash log
+ *********************************************/
+/*
+ * Copy of the last RML_LOG_CRASHLOG_SIZE bytes of the log stream kept in RAM that isn't cleared at boot
+ * (RML_LOG_CRASHLOG_ATTR), so it survives a reset (watchdog, panic, RML_ASSERT() followed by a reset...) but not
+ * a power cycle. Lines are appended as raw bytes: a producer reserves room by moving 'Head' forward with an atomic
+ * add and copies its line in, wrapping around, so recording a line costs a memcpy and never blocks. 'Dumped' is 
+ * where the last dump stopped, so every boot only dumps what was logged since.
+ */
+#if (RML_LOG_CRASHLOG_SIZE & (RML_LOG_CRASHLOG_SIZE - 1)) != 0
+#error "RML_LOG_CRASHLOG_SIZE must be a power of 2"
+#endif
+#define CRASHLOG_MAGIC			0x524D4C43							//"RMLC"
+#define CRASHLOG_CHECK			((uint32_t)(~CRASHLOG_MAGIC ^ RML_LOG_CRASHLOG_SIZE))		//Catches a retained log left by a build with another size
+#define CRASHLOG_LVL_MASK		(LOG_LEVELS_ALL & ~((1 << RML_LOG_CRASHLOG_MIN_LEVEL) - 1))	//Log levels that are recorded
+
+/***************************************
+ * @brief Retained crash log
+ ***************************************/
+typedef struct
+{
+	uint32_t Magic;					//CRASHLOG_MAGIC once set up, anything else means the RAM content was lost
+	uint32_t Check;					//CRASHLOG_CHECK
+	uint32_t Head;					//Total number of bytes appended (free running, masked on access)
+	uint32_t Dumped;				//Value of Head when the log was last dumped
+	uint32_t Reason;				//CrashReason_Enum of the current boot
+	uint8_t Buff[RML_LOG_CRASHLOG_SIZE];
+} CrashLog_Struct;
+
+static CrashLog_Struct CrashLog RML_LOG_CRASHLOG_ATTR;
+static uint8_t CrashLog_Opened = 0;				//Set once the retained log was checked this boot
+static uint8_t CrashLog_PrevReason = e_CRASH_NONE;	//Reason recorded by the previous boot
+
+
+//Checks the retained log once per boot and starts a new one if it was lost
+static void CrashLog_Open(void)
+{
+	if( CrashLog_Opened )
+	{
+		return;
+	}
+
+	if( CrashLog.Magic != CRASHLOG_MAGIC || CrashLog.Check != CRASHLOG_CHECK || CrashLog.Reason > e_CRASH_ASSERT 
+		|| CrashLog.Head - CrashLog.Dumped > CrashLog.Head )
+	{
+		memset(&CrashLog, 0, sizeof(CrashLog));
+		CrashLog.Check = CRASHLOG_CHECK;
+		CrashLog.Magic = CRASHLOG_MAGIC;
+	}
+
+	CrashLog_PrevReason = (uint8_t)CrashLog.Reason;
+	CrashLog.Reason = e_CRASH_NONE;
+	__atomic_store_n(&CrashLog_Opened, 1, __ATOMIC_RELEASE);
+}
+
+//Copies a line into the crash log, safe from any task or interrupt
+static void CrashLog_Append(const char *Line, uint32_t Len)
+{
+	uint32_t Pos, Chunk;
+
+	if( !__atomic_load_n(&CrashLog_Opened, __ATOMIC_ACQUIRE) )
+	{
+		return;
+	}
+
+	/* Only the end of lines longer than the whole log are kept */
+	if( Len > RML_LOG_CRASHLOG_SIZE )
+	{
+		Line += Len - RML_LOG_CRASHLOG_SIZE;
+		Len = RML_LOG_CRASHLOG_SIZE;
+	}
+
+	Pos = __atomic_fetch_add(&CrashLog.Head, Len, __ATOMIC_RELAXED) & (RML_LOG_CRASHLOG_SIZE - 1);
+	Chunk = RML_LOG_CRASHLOG_SIZE - Pos;
+	if( Chunk > Len )
+	{
+		Chunk = Len;
+	}
+	memcpy(&CrashLog.Buff[Pos], Line, Chunk);
+	memcpy(CrashLog.Buff, Line + Chunk, Len - Chunk);
+}
+
+//Records why this boot is going down, an assert is never overwritten by a later fatal message
+static void CrashLog_SetReason(uint8_t Reason)
+{
+	if( __atomic_load_n(&CrashLog_Opened, __ATOMIC_ACQUIRE) && Reason > CrashLog.Reason )
+	{
+		CrashLog.Reason = Reason;
+	}
+}
+
+//Gets the position of the oldest byte worth reading when reading from 'From' to the head, the first line is skipped if it was cut
+static uint32_t CrashLog_Start(uint32_t From, uint32_t Head)
+{
+	if( Head - From <= RML_LOG_CRASHLOG_SIZE )
+	{
+		return From;
+	}
+
+	From = Head - RML_LOG_CRASHLOG_SIZE;
+	#if !defined(RML_LOG_TOKENIZED_ENABLE)
+	/* Text lines: skip to the start of the next line, tokenized frames are resynced by the decoder instead */
+	for( uint32_t p = From; p != Head; p++ )
+	{
+		if( CrashLog.Buff[p & (RML_LOG_CRASHLOG_SIZE - 1)] == '\n' )
+		{
+			return p + 1;
+		}
+	}
+	#endif
+
+	return From;
+}
+
+//Sends what was logged since the last dump to the sinks, called once at init so the previous boot's last lines show up first
+static void CrashLog_Dump(void)
+{
+	uint32_t Head = CrashLog.Head;
+	uint32_t Pos = CrashLog_Start(CrashLog.Dumped, Head);
+	uint32_t Chunk;
+	char Title[64];
+
+	if( Pos == Head )
+	{
+		return;
+	}
+
+	#if !defined(RML_LOG_TOKENIZED_ENABLE)
+	static const char *Reason_Str[3] = { "reset", "fatal", "assert" };
+	Chunk = (uint32_t)RML_COMM_snprintf(Title, sizeof(Title), "> --- Crash log of the previous boot (%s) ---\r\n", Reason_Str[CrashLog_PrevReason]);
+	LogSink_WriteAll(Title, Chunk, e_FATAL);
+	#endif
+
+	/* At most 2 chunks, the ring may wrap once */
+	while( Pos != Head )
+	{
+		Chunk = RML_LOG_CRASHLOG_SIZE - (Pos & (RML_LOG_CRASHLOG_SIZE - 1));
+		if( Chunk > Head - Pos )
+		{
+			Chunk = Head - Pos;
+		}
+		LogSink_WriteAll((const char*)&CrashLog.Buff[Pos & (RML_LOG_CRASHLOG_SIZE - 1)], Chunk, e_FATAL);
+		Pos += Chunk;
+	}
+
+	#if !defined(RML_LOG_TOKENIZED_ENABLE)
+	Chunk = (uint32_t)RML_COMM_snprintf(Title, sizeof(Title), "> --- End of crash log ---\r\n");
+	LogSink_WriteAll(Title, Chunk, e_FATAL);
+	#endif
+	(void)Title;
+	LogSink_FlushAll();
+
+	CrashLog.Dumped = Head;
+}
+#endif
+
+
+
+//Sends or queues a finished log line (or tokenized frame) depending on the logger mode
+static void LogLine_Send(const char *Line, uint32_t Len, uint8_t Flags, uint8_t FromISR)
+{
+	uint8_t Taken;
+
+	LogStats_Line(Flags & LOGREC_FLAG_LVL_MASK, Len);
+
+	#if defined(RML_LOG_CRASHLOG_ENABLE)
+	/* Recorded before anything can drop it, so the crash log also has what never made it out */
+	if( (CRASHLOG_LVL_MASK >> (Flags & LOGREC_FLAG_LVL_MASK)) & 1 )
+	{
+		CrashLog_Append(Line, Len);
+		if( (Flags & LOGREC_FLAG_LVL_MASK) == e_FATAL )
+		{
+			CrashLog_SetReason(e_CRASH_FATAL);
+		}
+	}
+	#endif
+
+	/* Lines of the task that owns the open batch are held back until the batch is sent */
+	if( LogBatch_IsMine(FromISR) && LogBatch_Append(Line, Len, Flags) )
+	{
+		return;
+	}
+
+	/* Async mode: queue the line, the drain task/thread sends it */
+	if( LogAsync_Running )
+	{
+		LogRing_Push(Line, Len, Flags, FromISR);
+		return;
+	}
+
+	/* Sync mode from an ISR: we can't wait for the UART here */
+	if( FromISR )
+	{
+		__atomic_fetch_add(&Log_DroppedCount, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	/* Sync mode: send the line with a single write per sink. The line is already formatted, 
+	 * so the lock is only held for the writes themselves */
+	Taken = LogLock_Take();
+	if( !Taken )
+	{
+		__atomic_fetch_add(&Log_DroppedCount, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	LogSink_WriteAll(Line, Len, Flags & LOGREC_FLAG_LVL_MASK);
+	LogSink_FlushAll();
+	LogLock_Give(Taken);
+}
+
+
+
+#if defined(RML_LOG_TOKENIZED_ENABLE) || defined(RML_LOG_KV_BINARY)
+/*********************************************
+ * Tokenized (binary) logging
+ *********************************************/
+/*
+ * Frame layout (little-endian), see extras/tools/rml_log_decode.py:
+ * 		[0xA5] [PayloadLen] [LogLvl] [Timestamp_us x4] [Msg address x4] ([SeqNum x4]) [Src string + '\0'] [Args...] [Checksum]
+ * The timestamp holds the low 32 bits of the time in us (the decoder unwraps it). Bit 7 of LogLvl 
+ * (LOGTOK_LVL_SEQNUM) is set when the sequence number is there (symbol RML_LOG_SEQNUM_ENABLE). 
+ * Args are stored raw in the order of the specifiers in Msg: %c as 1 byte, integers as 4 bytes (%l, %ll and %z
+ * integers with the size of their C type), %p with the size of a pointer, %f as an 8-byte double and %s as a null
+ * terminated string. '*' widths/precisions are stored as 4-byte ints before their arg. The checksum is the sum of
+ * the payload bytes.
+ */
+#define LOGTOK_SYNC				0xA5
+#define LOGTOK_PAYLOAD_MAX		255
+#define LOGTOK_MAX_STR_LEN		48					//Longest %s/Src copied into a frame, longer strings are cut
+#define LOGTOK_LVL_SEQNUM		0x80				//LogLvl flag: a sequence number follows the Msg address
+
+//Appends raw bytes to the frame payload, all or nothing. Returns 0 if it didn't fit
+static uint8_t LogTok_Put(FmtOut_Struct *Out, const void *Data, uint32_t Len)
+{
+	if( Out->Len + Len > Out->Size )
+	{
+		return 0;
+	}
+	memcpy(&Out->Buff[Out->Len], Data, Len);
+	Out->Len += Len;
+	return 1;
+}
+
+//Adds the header and checksum around a payload built at &Frame[2]. Returns the frame length
+static uint32_t LogTok_Seal(uint8_t *Frame, uint8_t Sync, uint32_t PayloadLen)
+{
+	uint8_t Checksum = 0;
+
+	Frame[0] = Sync;
+	Frame[1] = (uint8_t)PayloadLen;
+	for( uint32_t i = 0; i < PayloadLen; i++ )
+	{
+		Checksum += Frame[2 + i];
+	}
+	Frame[2 + PayloadLen] = Checksum;
+
+	return PayloadLen + 3;
+}
+#endif
+
+
+
+#if defined(RML_LOG_TOKENIZED_ENABLE)
+//Appends a null terminated string (cut at LOGTOK_MAX_STR_LEN). Returns 0 if it didn't fit
+static uint8_t LogTok_PutStr(FmtOut_Struct *Out, const char *Str)
+{
+	uint32_t Len = 0;
+
+	if( Str == NULL )
+	{
+		Str = "";
+	}
+	while( Str[Len] && Len < LOGTOK_MAX_STR_LEN )
+	{
+		Len++;
+	}
+
+	return LogTok_Put(Out, Str, Len) && LogTok_Put(Out, "", 1);
+}
+
+//Builds a complete frame into Frame (at least LOGTOK_PAYLOAD_MAX + 3 bytes). Returns the frame length
+static uint32_t LogTok_Build(uint8_t *Frame, const char *Src, uint8_t LogLvl, const char *Msg, va_list VaList, 
+							 uint64_t Time_us, uint32_t SeqNum)
+{
+	FmtOut_Struct Out = { (char*)&Frame[2], LOGTOK_PAYLOAD_MAX, 0, 0, 0 };
+	uint32_t Timestamp = (uint32_t)Time_us;
+	uint32_t MsgAddr = (uint32_t)(uintptr_t)Msg;
+	FmtSpec_Struct Spec;
+	va_list Args;
+	int32_t I32Arg;
+	uint64_t U64Arg;
+	uint8_t ArgSize;
+	double DoubleArg;
+	char CharArg;
+	uint8_t Fits;
+
+	#if defined(RML_LOG_SEQNUM_ENABLE)
+	LogLvl |= LOGTOK_LVL_SEQNUM;
+	#endif
+	LogTok_Put(&Out, &LogLvl, 1);
+	LogTok_Put(&Out, &Timestamp, 4);
+	LogTok_Put(&Out, &MsgAddr, 4);
+	#if defined(RML_LOG_SEQNUM_ENABLE)
+	LogTok_Put(&Out, &SeqNum, 4);
+	#else
+	(void)SeqNum;
+	#endif
+	Fits = LogTok_PutStr(&Out, Src);
+
+	/* Walk the specifiers to pull the args out, no conversion is done here */
+	va_copy(Args, VaList);
+	while( *Msg && Fits )
+	{
+		if( *Msg++ != '%' )
+		{
+			continue;
+		}
+		Msg = Fmt_ParseSpec(Msg, &Spec, &Args);
+
+		/* '*' widths/precisions were read by the parser, they go in the frame before the arg */
+		if( Spec.Flags & FMT_FLAG_STAR_WIDTH )
+		{
+			I32Arg = (Spec.Flags & FMT_FLAG_LEFT) ? -(int32_t)Spec.Width : (int32_t)Spec.Width;
+			Fits = Fits && LogTok_Put(&Out, &I32Arg, 4);
+		}
+		if( Spec.Flags & FMT_FLAG_STAR_PREC )
+		{
+			I32Arg = Spec.Precision;
+			Fits = Fits && LogTok_Put(&Out, &I32Arg, 4);
+		}
+
+		switch( Spec.Conv )
+		{
+			case FMT_CONV_STR:
+				Fits = Fits && LogTok_PutStr(&Out, va_arg(Args, char *));
+				break;
+
+			case FMT_CONV_CHAR:
+				CharArg = va_arg(Args, int);
+				Fits = Fits && LogTok_Put(&Out, &CharArg, 1);
+				break;
+
+			/* Integers are stored with the size of their C type (little-endian), hh/h are promoted to int */
+			case FMT_CONV_SIGNED:
+			case FMT_CONV_UNSIGNED:
+				if( Spec.Length == 'L' )
+				{
+					U64Arg = va_arg(Args, unsigned long long);
+					ArgSize = sizeof(unsigned long long);
+				}
+				else if( Spec.Length == 'l' )
+				{
+					U64Arg = va_arg(Args, unsigned long);
+					ArgSize = sizeof(unsigned long);
+				}
+				else if( Spec.Length == 'z' )
+				{
+					U64Arg = va_arg(Args, size_t);
+					ArgSize = sizeof(size_t);
+				}
+				else
+				{
+					U64Arg = va_arg(Args, unsigned);
+					ArgSize = 4;
+				}
+				Fits = Fits && LogTok_Put(&Out, &U64Arg, ArgSize);
+				break;
+
+			case FMT_CONV_PTR:
+				U64Arg = (uintptr_t)va_arg(Args, void *);
+				Fits = Fits && LogTok_Put(&Out, &U64Arg, sizeof(void *));
+				break;
+
+			case FMT_CONV_FLOAT:
+				DoubleArg = va_arg(Args, double);
+				Fits = Fits && LogTok_Put(&Out, &DoubleArg, 8);
+				break;
+
+			default:
+				break;
+		}
+	}
+	va_end(Args);
+
+	return LogTok_Seal(Frame, LOGTOK_SYNC, Out.Len);
+}
+#endif
+
+
+
+#if defined(RML_LOG_KV_BINARY)
+/*********************************************
+ * Structured (key/value) logging
+ *********************************************/
+/*
+ * Frame layout, see RML_COMM_LogKV() and extras/tools/rml_log_decode.py:
+ * 		[0xA7] [PayloadLen] [CBOR map] [Checksum]
+ * The map is an indefinite length CBOR map (RFC 8949, big-endian) so fields can be added until the frame is full 
+ * without counting them first. Integer keys 0-3 hold the log level, the timestamp, Src and the sequence number, the
+ * fields of the message follow with text keys. A field that doesn't fit is rolled back, the map always ends with
+ * its break byte.
+ */
+#define LOGKV_SYNC				0xA7
+#define LOGKV_KEY_LEVEL			0
+#define LOGKV_KEY_TIME			1
+#define LOGKV_KEY_SRC			2
+#define LOGKV_KEY_SEQNUM		3
+
+#define CBOR_MAJOR_UINT			0
+#define CBOR_MAJOR_NEGINT		1
+#define CBOR_MAJOR_TEXT			3
+#define CBOR_MAP_BEGIN			0xBF				//Indefinite length map
+#define CBOR_FLOAT32			0xFA
+#define CBOR_FLOAT64			0xFB
+#define CBOR_NULL				0xF6
+#define CBOR_BREAK				0xFF
+
+//Appends Len bytes of Val, most significant byte first. Returns 0 if it didn't fit
+static uint8_t Cbor_PutBE(FmtOut_Struct *Out, uint64_t Val, uint8_t Len)
+{
+	uint8_t Bytes[8];
+
+	for( uint8_t i = 0; i < Len; i++ )
+	{
+		Bytes[i] = (uint8_t)(Val >> (8 * (Len - 1 - i)));
+	}
+	return LogTok_Put(Out, Bytes, Len);
+}
+
+//Appends a data item head (major type + argument in the shortest form). Returns 0 if it didn't fit
+static uint8_t Cbor_PutHead(FmtOut_Struct *Out, uint8_t Major, uint64_t Val)
+{
+	uint8_t Head = Major << 5;
+
+	if( Val < 24 )
+	{
+		Head |= (uint8_t)Val;
+		return LogTok_Put(Out, &Head, 1);
+	}
+	if( Val <= 0xFF )
+	{
+		Head |= 24;
+		return LogTok_Put(Out, &Head, 1) && Cbor_PutBE(Out, Val, 1);
+	}
+	if( Val <= 0xFFFF )
+	{
+		Head |= 25;
+		return LogTok_Put(Out, &Head, 1) && Cbor_PutBE(Out, Val, 2);
+	}
+	if( Val <= 0xFFFFFFFF )
+	{
+		Head |= 26;
+		return LogTok_Put(Out, &Head, 1) && Cbor_PutBE(Out, Val, 4);
+	}
+	Head |= 27;
+	return LogTok_Put(Out, &Head, 1) && Cbor_PutBE(Out, Val, 8);
+}
+
+//Appends a text string (cut at LOGTOK_MAX_STR_LEN). Returns 0 if it didn't fit
+static uint8_t Cbor_PutText(FmtOut_Struct *Out, const char *Str, uint32_t Len)
+{
+	if( Len > LOGTOK_MAX_STR_LEN )
+	{
+		Len = LOGTOK_MAX_STR_LEN;
+	}
+	return Cbor_PutHead(Out, CBOR_MAJOR_TEXT, Len) && LogTok_Put(Out, Str, Len);
+}
+
+//Appends a signed integer. Returns 0 if it didn't fit
+static uint8_t Cbor_PutInt(FmtOut_Struct *Out, int64_t Val)
+{
+	return (Val < 0) ? Cbor_PutHead(Out, CBOR_MAJOR_NEGINT, ~(uint64_t)Val) : Cbor_PutHead(Out, CBOR_MAJOR_UINT, (uint64_t)Val);
+}
+
+//Appends a float, as a float32 when that loses nothing. Returns 0 if it didn't fit
+static uint8_t Cbor_PutFloat(FmtOut_Struct *Out, double Val)
+{
+	float Single = (float)Val;
+	uint8_t Head;
+	uint32_t Bits32;
+	uint64_t Bits64;
+
+	if( (double)Single == Val || Val != Val )
+	{
+		Head = CBOR_FLOAT32;
+		memcpy(&Bits32, &Single, 4);
+		return LogTok_Put(Out, &Head, 1) && Cbor_PutBE(Out, Bits32, 4);
+	}
+	Head = CBOR_FLOAT64;
+	memcpy(&Bits64, &Val, 8);
+	return LogTok_Put(Out, &Head, 1) && Cbor_PutBE(Out, Bits64, 8);
+}
+
+//Reads the arg of Spec and appends it as a typed value (Out NULL: the arg is only read). Returns 0 if it didn't fit
+static uint8_t LogKV_PutValue(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	int64_t I64Arg;
+	uint64_t U64Arg;
+	double DoubleArg;
+	const char *StrArg;
+	char CharArg;
+	uint8_t Null = CBOR_NULL;
+
+	switch( Spec->Conv )
+	{
+		case FMT_CONV_STR:
+			StrArg = va_arg(*Args, const char *);
+			if( Out == NULL )
+			{
+				return 1;
+			}
+			return (StrArg != NULL) ? Cbor_PutText(Out, StrArg, strlen(StrArg)) : LogTok_Put(Out, &Null, 1);
+
+		case FMT_CONV_CHAR:
+			CharArg = (char)va_arg(*Args, int);
+			return (Out == NULL) || Cbor_PutText(Out, &CharArg, 1);
+
+		/* Integers keep the value of their C type, hh/h are promoted to int and cut back here */
+		case FMT_CONV_SIGNED:
+			if( Spec->Length == 'L' )			I64Arg = va_arg(*Args, long long);
+			else if( Spec->Length == 'l' )		I64Arg = va_arg(*Args, long);
+			else if( Spec->Length == 'z' )		I64Arg = (intptr_t)va_arg(*Args, size_t);
+			else if( Spec->Length == 'H' )		I64Arg = (signed char)va_arg(*Args, int);
+			else if( Spec->Length == 'h' )		I64Arg = (short)va_arg(*Args, int);
+			else								I64Arg = va_arg(*Args, int);
+			return (Out == NULL) || Cbor_PutInt(Out, I64Arg);
+
+		case FMT_CONV_UNSIGNED:
+			if( Spec->Length == 'L' )			U64Arg = va_arg(*Args, unsigned long long);
+			else if( Spec->Length == 'l' )		U64Arg = va_arg(*Args, unsigned long);
+			else if( Spec->Length == 'z' )		U64Arg = va_arg(*Args, size_t);
+			else if( Spec->Length == 'H' )		U64Arg = (unsigned char)va_arg(*Args, unsigned);
+			else if( Spec->Length == 'h' )		U64Arg = (unsigned short)va_arg(*Args, unsigned);
+			else								U64Arg = va_arg(*Args, unsigned);
+			return (Out == NULL) || Cbor_PutHead(Out, CBOR_MAJOR_UINT, U64Arg);
+
+		case FMT_CONV_PTR:
+			U64Arg = (uintptr_t)va_arg(*Args, void *);
+			return (Out == NULL) || Cbor_PutHead(Out, CBOR_MAJOR_UINT, U64Arg);
+
+		case FMT_CONV_FLOAT:
+			DoubleArg = va_arg(*Args, double);
+			return (Out == NULL) || Cbor_PutFloat(Out, DoubleArg);
+
+		/* Nothing to read */
+		default:
+			return (Out == NULL) || LogTok_Put(Out, &Null, 1);
+	}
+}
+
+//Builds a complete frame into Frame (at least LOGTOK_PAYLOAD_MAX + 3 bytes). Returns the frame length
+static uint32_t LogKV_Build(uint8_t *Frame, const char *Src, uint8_t LogLvl, const char *Fields, va_list VaList, 
+							uint64_t Time_us, uint32_t SeqNum)
+{
+	FmtOut_Struct Out = { (char*)&Frame[2], LOGTOK_PAYLOAD_MAX - 1, 0, 0, 0 };		//Keep room for the break byte
+	const char *Key;
+	uint32_t KeyLen;
+	uint32_t PairStart;
+	FmtSpec_Struct Spec;
+	va_list Args;
+	uint8_t Fits = 1;
+	uint8_t Byte = CBOR_MAP_BEGIN;
+
+	/* Message info, these always fit */
+	LogTok_Put(&Out, &Byte, 1);
+	Cbor_PutHead(&Out, CBOR_MAJOR_UINT, LOGKV_KEY_LEVEL);
+	Cbor_PutHead(&Out, CBOR_MAJOR_UINT, LogLvl);
+	Cbor_PutHead(&Out, CBOR_MAJOR_UINT, LOGKV_KEY_TIME);
+	Cbor_PutHead(&Out, CBOR_MAJOR_UINT, Time_us);
+	Cbor_PutHead(&Out, CBOR_MAJOR_UINT, LOGKV_KEY_SRC);
+	Cbor_PutText(&Out, (Src != NULL) ? Src : "", (Src != NULL) ? strlen(Src) : 0);
+	#if defined(RML_LOG_SEQNUM_ENABLE)
+	Cbor_PutHead(&Out, CBOR_MAJOR_UINT, LOGKV_KEY_SEQNUM);
+	Cbor_PutHead(&Out, CBOR_MAJOR_UINT, SeqNum);
+	#else
+	(void)SeqNum;
+	#endif
+
+	/* One pair per "key=value" word, args are always read so the ones after a dropped pair stay in step */
+	va_copy(Args, VaList);
+	while( *Fields )
+	{
+		while( *Fields == ' ' )
+		{
+			Fields++;
+		}
+
+		/* Key */
+		Key = Fields;
+		while( *Fields && *Fields != ' ' && *Fields != '=' && *Fields != '%' )
+		{
+			Fields++;
+		}
+		KeyLen = Fields - Key;
+
+		/* Value: a specifier or literal text */
+		if( *Fields == '=' )
+		{
+			Fields++;
+			PairStart = Out.Len;
+			if( Fits )
+			{
+				Fits = Cbor_PutText(&Out, Key, KeyLen);
+			}
+			if( Fields[0] == '%' && Fields[1] != '%' )
+			{
+				Fields = Fmt_ParseSpec(Fields + 1, &Spec, &Args);
+				Fits = LogKV_PutValue(Fits ? &Out : NULL, &Spec, &Args) && Fits;
+			}
+			else
+			{
+				Key = Fields;
+				while( *Fields && *Fields != ' ' && *Fields != '%' )
+				{
+					Fields++;
+				}
+				Fits = Fits && Cbor_PutText(&Out, Key, Fields - Key);
+			}
+			if( !Fits )
+			{
+				Out.Len = PairStart;
+			}
+		}
+
+		/* Anything else up to the next space isn't sent, its args are still read */
+		while( *Fields && *Fields != ' ' )
+		{
+			if( Fields[0] == '%' && Fields[1] == '%' )
+			{
+				Fields += 2;
+			}
+			else if( *Fields++ == '%' )
+			{
+				Fields = Fmt_ParseSpec(Fields, &Spec, &Args);
+				LogKV_PutValue(NULL, &Spec, &Args);
+			}
+		}
+	}
+	va_end(Args);
+
+	Out.Buff[Out.Len++] = (char)CBOR_BREAK;
+
+	return LogTok_Seal(Frame, LOGKV_SYNC, Out.Len);
+}
+#endif
+
+
+
+int8_t RML_COMM_LoggerInit(GenericUART_Struct *UARTComm)
 {
 	/* Error check: 
 	* is the baudrate greater than the max value or 0 */
@@ -130,602 +2587,3026 @@ int8_t RML_COMM_LoggerInit(GenericUART_Struct *UARTComm)
 		return -1;
 	}
 
-	/* Based on the processor we are running on, call different UART init functions: */
-	switch (CurrentMCU)
+	/* Error check: 
+	* is the log mode or overflow policy unknown */
+	if(UARTComm->LogMode > e_LOG_MODE_ASYNC || UARTComm->AsyncOverflowPolicy > e_OVERFLOW_BLOCK)
+	{
+		return -1;
+	}
+
+	/* Error check: 
+	* is the port or TX FIFO threshold unknown */
+	if(UARTComm->Port > e_LOG_PORT_UART2 || UARTComm->TxFifoThreshold > e_TXFIFO_EMPTY)
+	{
+		return -1;
+	}
+
+	/* Sync mode lock timeout, 0 keeps the default */
+	LogLock_Timeout_ms = (UARTComm->LockTimeout_ms == 0) ? RML_LOG_LOCK_DEFAULT_TIMEOUT_MS : UARTComm->LockTimeout_ms;
+
+	/* Error check:
+	* async mode can't be changed once started */
+	if(LogAsync_Running)
+	{
+		return (UARTComm->LogMode == e_LOG_MODE_ASYNC) ? 0 : -1;
+	}
+
+	/* Based on the processor we are running on, call different UART init functions: */
+	switch (CurrentMCU)
+	{
+		case e_ESP_ESP32:
+			#if defined(ESP32)
+			if(UARTComm->Port == e_LOG_PORT_USB)
+			{
+				/* We use native USB port, no need to set pins */
+				Serial.begin(UARTComm->BaudRate);
+				Serial.setTxTimeoutMs(0);				//This is used to avoid waiting if the USB is not connected 
+				LogUART = NULL;
+			}
+			else
+			{
+				/* Hardware UART on the given pins, its TX buffer has to be sized before begin() */
+				HardwareSerial *Uart = Esp_UARTGet(UARTComm->Port);
+				if(Uart == NULL)
+				{
+					return -1;
+				}
+				if(UARTComm->TxBuffSize > 0)
+				{
+					Uart->setTxBufferSize(UARTComm->TxBuffSize);
+				}
+				Uart->begin(UARTComm->BaudRate, SERIAL_8N1, UARTComm->RX_Pin, UARTComm->TX_Pin);
+				LogUART = Uart;
+			}
+			if(LogMutex == NULL)
+			{
+				LogMutex = xSemaphoreCreateMutex();
+			}
+			#endif
+			break;
+
+		case e_STM32_STM32xx:
+			#if defined(STM32H725xx) || defined(STM32H735xx)
+			/* Start the cycle counter used for timestamps, once */
+			if(!Logger_InitDone)
+			{
+				Log_TimestampInit();
+			}
+			#endif
+
+			#if defined(STM32H725xx) || defined(STM32H735xx)
+			/* The UART and its pins come from CubeMX, by default the ones hard-wired on our boards:
+			 *		> STM32H725: UART1, RX Pin: B15, TX Pin: A9
+			 *		> STM32H735: UART3, RX Pin: PD9, TX Pin: PD8
+			 * Only the baud rate and TX FIFO are changed, if asked for */
+			LogUART = (UARTComm->UART_Handle != NULL) ? (UART_HandleTypeDef*)UARTComm->UART_Handle : STM32_UART_DEFAULT;
+			if(LogUART == NULL || Stm32_UARTConfig(UARTComm->BaudRate, UARTComm->TxFifoThreshold) != 0)
+			{
+				return -1;
+			}
+			if(LogMutex == NULL)
+			{
+				LogMutex = xSemaphoreCreateMutex();
+			}
+			#endif
+			break;
+		
+		default:
+			//Native selected - nothing to do
+			break;
+	}
+
+	#if defined(RML_LOG_CRASHLOG_ENABLE)
+	/* Check the retained crash log and dump the previous boot's last lines before anything new is logged */
+	if(!CrashLog_Opened)
+	{
+		CrashLog_Open();
+		#if RML_LOG_CRASHLOG_DUMP_ON_INIT
+		CrashLog_Dump();
+		#endif
+	}
+	#endif
+
+	/* Start the async backend if needed: */
+	if(UARTComm->LogMode == e_LOG_MODE_ASYNC)
+	{
+		if(LogAsync_Start(UARTComm) != 0)
+		{
+			return -1;
+		}
+	}
+
+	/* Logger was init successfully */
+	Logger_InitDone = 1;
+
+	return 0;
+}
+
+
+
+
+#if defined(RML_LOG_TIMESTAMP_ENABLE) || defined(RML_LOG_SEQNUM_ENABLE)
+//Outputs the timestamp ("s.us ") and/or the sequence number ("#N ") of a log line
+static void LogMsg_PutStamp(FmtOut_Struct *Out, uint64_t Time_us, uint32_t SeqNum)
+{
+	char Buff[16];
+	int32_t Len;
+
+	#if defined(RML_LOG_TIMESTAMP_ENABLE)
+	uint32_t Sec = (uint32_t)(Time_us / 1000000);
+
+	Len = Utoa_Core(Sec, Buff, sizeof(Buff) - 7, 10);
+	Buff[Len] = '.';
+	Utoa10_WriteFixed(Time_us - (uint64_t)Sec * 1000000, &Buff[Len + 7], 6);
+	Fmt_PutStrN(Out, Buff, (uint32_t)Len + 7);
+	Fmt_PutChar(Out, ' ');
+	#endif
+
+	#if defined(RML_LOG_SEQNUM_ENABLE)
+	Len = Utoa_Core(SeqNum, Buff, sizeof(Buff), 10);
+	Fmt_PutChar(Out, '#');
+	Fmt_PutStrN(Out, Buff, (uint32_t)Len);
+	Fmt_PutChar(Out, ' ');
+	#endif
+
+	(void)Time_us;
+	(void)SeqNum;
+}
+#endif
+
+static void LogMsg_v(const char *Src, uint8_t LogLvl, const char *Msg, va_list VaList, uint8_t FromISR, 
+					 const FmtProgram_Struct *Prog);
+
+//Logs a message generated by the logger itself (repeat and rate limit summaries)
+static void LogMsg_Notice(const char *Src, uint8_t LogLvl, uint8_t FromISR, const char *Fmt, ... )
+{
+	va_list VaList;
+	va_start(VaList, Fmt);
+	LogMsg_v(Src, LogLvl, Fmt, VaList, FromISR, NULL);
+	va_end(VaList);
+}
+
+//Formats of the hex dump lines (RML_COMM_LogHex()), they are never collapsed as repeats
+static const char LogHex_HeadFmt[] = "%u bytes:";
+static const char LogHex_RowFmt[] = "%.48s%s";			//Rows are sent in 2 parts, tokenized frames cut strings at 48 chars
+
+//Takes a token from a module's bucket. Returns 1 if the message can be logged, 0 if the module is over its rate
+static uint8_t LogModule_TakeToken(int8_t Handle, uint8_t LogLvl, uint8_t FromISR)
+{
+	uint32_t Rate = __atomic_load_n(&LogModule_Rate[Handle], __ATOMIC_RELAXED);
+	uint32_t Max, Now_ms, Suppressed;
+	uint32_t Tokens, New;
+	uint64_t Add;
+	uint8_t Allowed;
+
+	if( Rate == 0 )
+	{
+		return 1;
+	}
+
+	/* Refill for the time elapsed since the last call, each call credits its own slice of time once */
+	Max = (uint32_t)__atomic_load_n(&LogModule_Burst[Handle], __ATOMIC_RELAXED) * 1000;
+	Now_ms = Log_GetTime_ms();
+	Add = (uint64_t)(Now_ms - __atomic_exchange_n(&LogModule_Refill_ms[Handle], Now_ms, __ATOMIC_RELAXED)) * Rate;
+
+	Tokens = __atomic_load_n(&LogModule_Tokens[Handle], __ATOMIC_RELAXED);
+	do
+	{
+		New = (Tokens + Add > Max) ? Max : (uint32_t)(Tokens + Add);
+		Allowed = (New >= 1000);
+		if( Allowed )
+		{
+			New -= 1000;
+		}
+	} while( !__atomic_compare_exchange_n(&LogModule_Tokens[Handle], &Tokens, New, 1, __ATOMIC_RELAXED, __ATOMIC_RELAXED) );
+
+	if( !Allowed )
+	{
+		__atomic_fetch_add(&LogModule_Suppressed[Handle], 1, __ATOMIC_RELAXED);
+		LOG_STAT_ADD(Suppressed, 1);
+		return 0;
+	}
+
+	/* Let the reader know messages are missing before the one that goes through */
+	Suppressed = __atomic_exchange_n(&LogModule_Suppressed[Handle], 0, __ATOMIC_RELAXED);
+	if( Suppressed > 0 )
+	{
+		LogMsg_Notice(LogModule_Name[Handle], LogLvl, FromISR, "%u messages suppressed by the rate limit", Suppressed);
+	}
+
+	return 1;
+}
+
+#if defined(RML_LOG_COLLAPSE_REPEATS)
+/*
+ * Repeat collapsing: a message with the same format string, source and log level as the one just before it is
+ * dropped and counted, the count is logged as a single "repeated N times" line once another message comes. A run
+ * that lasts longer than RML_LOG_COLLAPSE_MAX_MS logs its count and lets the next repeat through, so a value is
+ * still seen every RML_LOG_COLLAPSE_MAX_MS. Only pointers are compared, so nothing is formatted. 
+ * The state is shared by all tasks without a lock, interleaved callers may at worst miscount the repeats.
+ */
+static const char LogRepeat_Fmt[] = "last message repeated %u times";
+static const char *LogRepeat_Msg = NULL;
+static const char *LogRepeat_Src = NULL;
+static uint8_t LogRepeat_Lvl = 0;
+static uint32_t LogRepeat_Count = 0;
+static uint32_t LogRepeat_Since_ms = 0;				//When the last summary (or the first message of the run) was logged
+
+//Returns 1 if the message repeats the last one and must be dropped
+static uint8_t LogRepeat_Check(const char *Src, uint8_t LogLvl, const char *Msg, uint8_t FromISR)
+{
+	const char *PrevSrc = LogRepeat_Src;
+	uint8_t PrevLvl = LogRepeat_Lvl;
+	uint32_t Now_ms, Count;
+
+	/* Our own summary and hex dump rows are never collapsed */
+	if( Msg == LogRepeat_Fmt || Msg == LogHex_HeadFmt || Msg == LogHex_RowFmt )
+	{
+		return 0;
+	}
+
+	Now_ms = Log_GetTime_ms();
+	if( Msg == LogRepeat_Msg && Src == LogRepeat_Src && LogLvl == LogRepeat_Lvl )
+	{
+		if( Now_ms - LogRepeat_Since_ms < RML_LOG_COLLAPSE_MAX_MS )
+		{
+			__atomic_fetch_add(&LogRepeat_Count, 1, __ATOMIC_RELAXED);
+			LOG_STAT_ADD(Suppressed, 1);
+			return 1;
+		}
+
+		/* Still repeating after a while: log how many so far and let this one through with its current values */
+		LogRepeat_Since_ms = Now_ms;
+		Count = __atomic_exchange_n(&LogRepeat_Count, 0, __ATOMIC_RELAXED);
+		if( Count > 0 )
+		{
+			LogMsg_Notice(Src, LogLvl, FromISR, LogRepeat_Fmt, Count);
+		}
+		return 0;
+	}
+
+	/* A new message ends the run of repeats */
+	Count = __atomic_exchange_n(&LogRepeat_Count, 0, __ATOMIC_RELAXED);
+	if( Count > 0 )
+	{
+		LogMsg_Notice(PrevSrc, PrevLvl, FromISR, LogRepeat_Fmt, Count);
+	}
+	LogRepeat_Msg = Msg;
+	LogRepeat_Src = Src;
+	LogRepeat_Lvl = LogLvl;
+	LogRepeat_Since_ms = Now_ms;
+
+	return 0;
+}
+#endif
+
+//Builds and sends a log message, the caller already checked the log level is enabled
+static void LogMsg_v(const char *Src, uint8_t LogLvl, const char *Msg, va_list VaList, uint8_t FromISR, 
+					 const FmtProgram_Struct *Prog)
+{
+	uint8_t LogLvlUnknown = (LogLvl > e_FATAL);						//Used to check if the Log level is defined or not
+	const char *ColorStr = LogLvlUnknown ? "" : LogLevel_Color[LogLvl];		//Used to color the log level string
+
+	#if defined(RML_LOG_COLLAPSE_REPEATS)
+	/* Repeats are dropped before any formatting */
+	if( LogRepeat_Check(Src, LogLvl, Msg, FromISR) )
+	{
+		return;
+	}
+	#endif
+
+	/* Time and sequence number are taken now, not when the line reaches the transport */
+	#if defined(RML_LOG_TOKENIZED_ENABLE) || defined(RML_LOG_TIMESTAMP_ENABLE)
+	uint64_t Time_us = Log_GetTimestamp_us();
+	#else
+	uint64_t Time_us = 0;
+	#endif
+	#if defined(RML_LOG_SEQNUM_ENABLE)
+	uint32_t SeqNum = __atomic_fetch_add(&Log_SeqNum, 1, __ATOMIC_RELAXED);
+	#else
+	uint32_t SeqNum = 0;
+	#endif
+
+	#if defined(RML_LOG_TOKENIZED_ENABLE)
+	/* Tokenized mode: only the address of Msg and the raw args are sent, the host decoder does the formatting */
+	uint8_t Frame[LOGTOK_PAYLOAD_MAX + 3];
+	uint32_t FrameLen = LogTok_Build(Frame, Src, LogLvlUnknown ? LOGREC_LVL_NONE : LogLvl, Msg, VaList, Time_us, SeqNum);
+
+	LogLine_Send((const char*)Frame, FrameLen, LogLvlUnknown ? LOGREC_LVL_NONE : LogLvl, FromISR);
+	(void)ColorStr;
+	return;
+	#endif
+
+	/* The whole line is built on the stack first (truncated at RML_LOG_LINE_MAX_SIZE) 
+	 * and then sent or queued in one go */
+	char Line[RML_LOG_LINE_MAX_SIZE];
+	FmtOut_Struct LineOut = { Line, sizeof(Line) - (sizeof(ANSI_RESET "\r\n") - 1), 0, 0, 0 };		//Keep room for the line ending
+	FmtOut_Struct *Out = &LineOut;
+
+	/* The log message is built by segments depending on
+	 * what needs to be sent or formatting */
+	Fmt_PutStr(Out, ColorStr);					//Color string
+	Fmt_PutStr(Out, "> ");
+
+	/* Time and sequence number, if enabled */
+	#if defined(RML_LOG_TIMESTAMP_ENABLE) || defined(RML_LOG_SEQNUM_ENABLE)
+	LogMsg_PutStamp(Out, Time_us, SeqNum);
+	#endif
+	(void)Time_us;
+	(void)SeqNum;
+	Fmt_PutChar(Out, '[');
+
+	/* Output log level: */
+	if( LogLvlUnknown )
+	{
+		Fmt_PutStr(Out, "Unknown LogLvl?");
+	}
+	else
+	{
+		Fmt_PutStr(Out, LogLevel_Str[LogLvl]);	//LogLevel
+	}
+	Fmt_PutStr(Out, "] ");
+	
+
+	/* Logs source of log (inception) */
+	Fmt_PutStr(Out, Src);
+	Fmt_PutStr(Out, ": ");
+
+	/* Logs message, from its compiled format if there is one */
+	if( Prog )
+	{
+		Fmt_vformatCompiled(Out, Prog, Msg, VaList);
+	}
+	else
+	{
+		Fmt_vformat(Out, Msg, VaList);
+	}
+
+	/* Newline */
+	LineOut.Size = sizeof(Line);
+	Fmt_PutStr(Out, ANSI_RESET);
+	Fmt_PutStr(Out, "\r\n");
+
+	LogLine_Send(Line, LineOut.Len, LogLvlUnknown ? LOGREC_LVL_NONE : LogLvl, FromISR);
+}
+
+
+
+#if defined(RML_LOG_KV_BINARY)
+//Builds and sends a key/value frame, the caller already checked the log level is enabled
+static void LogKV_v(const char *Src, uint8_t LogLvl, const char *Fields, va_list VaList, uint8_t FromISR)
+{
+	uint8_t Frame[LOGTOK_PAYLOAD_MAX + 3];
+	uint32_t FrameLen;
+
+	#if defined(RML_LOG_COLLAPSE_REPEATS)
+	if( LogRepeat_Check(Src, LogLvl, Fields, FromISR) )
+	{
+		return;
+	}
+	#endif
+
+	#if defined(RML_LOG_SEQNUM_ENABLE)
+	uint32_t SeqNum = __atomic_fetch_add(&Log_SeqNum, 1, __ATOMIC_RELAXED);
+	#else
+	uint32_t SeqNum = 0;
+	#endif
+
+	LogLvl = (LogLvl > e_FATAL) ? LOGREC_LVL_NONE : LogLvl;
+	FrameLen = LogKV_Build(Frame, Src, LogLvl, Fields, VaList, Log_GetTimestamp_us(), SeqNum);
+	LogLine_Send((const char*)Frame, FrameLen, LogLvl, FromISR);
+}
+#endif
+
+
+
+void RML_COMM_LogMsg(char *Src, uint8_t LogLvl, char* Msg, ... )
+{
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return;
+	}
+
+	/* Check if Log level is enabled (unknown log levels are always logged): */
+	if( LogLvl <= e_FATAL && !((__atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED) >> LogLvl) & 1) )
+	{
+		LOG_STAT_ADD(Filtered, 1);
+		return;
+	}
+
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
+	va_start(VaList, Msg);					//Create a list for arguments given after 'Msg'
+	LogMsg_v(Src, LogLvl, Msg, VaList, LOG_IN_ISR(), NULL);
+	va_end(VaList);							//Clean up the list
+}
+
+
+
+void RML_COMM_LogMsgFromISR(char *Src, uint8_t LogLvl, char* Msg, ... )
+{
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return;
+	}
+
+	/* Check if Log level is enabled (unknown log levels are always logged): */
+	if( LogLvl <= e_FATAL && !((__atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED) >> LogLvl) & 1) )
+	{
+		LOG_STAT_ADD(Filtered, 1);
+		return;
+	}
+
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
+	va_start(VaList, Msg);					//Create a list for arguments given after 'Msg'
+	LogMsg_v(Src, LogLvl, Msg, VaList, 1, NULL);
+	va_end(VaList);							//Clean up the list
+}
+
+
+
+
+void RML_COMM_LogMsgCompiled(FmtProgram_Struct *Prog, char *Src, uint8_t LogLvl, char* Msg, ... )
+{
+	uint8_t State;
+	uint8_t Expected = FMT_PROG_EMPTY;
+
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return;
+	}
+
+	/* Check if Log level is enabled (unknown log levels are always logged): */
+	if( LogLvl <= e_FATAL && !((__atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED) >> LogLvl) & 1) )
+	{
+		LOG_STAT_ADD(Filtered, 1);
+		return;
+	}
+
+	/* The first caller compiles the format, anyone logging from the same call site meanwhile parses it as usual */
+	State = __atomic_load_n(&Prog->State, __ATOMIC_ACQUIRE);
+	if( State == FMT_PROG_EMPTY && 
+		__atomic_compare_exchange_n(&Prog->State, &Expected, FMT_PROG_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+	{
+		State = (Fmt_Compile(Prog, Msg) == 0) ? FMT_PROG_READY : FMT_PROG_PARSE;
+		__atomic_store_n(&Prog->State, State, __ATOMIC_RELEASE);
+	}
+
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
+	va_start(VaList, Msg);					//Create a list for arguments given after 'Msg'
+	LogMsg_v(Src, LogLvl, Msg, VaList, LOG_IN_ISR(), (State == FMT_PROG_READY) ? Prog : NULL);
+	va_end(VaList);							//Clean up the list
+}
+
+
+
+void RML_COMM_LogKV(char *Src, uint8_t LogLvl, char* Fields, ... )
+{
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return;
+	}
+
+	/* Check if Log level is enabled (unknown log levels are always logged): */
+	if( LogLvl <= e_FATAL && !((__atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED) >> LogLvl) & 1) )
+	{
+		LOG_STAT_ADD(Filtered, 1);
+		return;
+	}
+
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
+	va_start(VaList, Fields);				//Create a list for arguments given after 'Fields'
+	#if defined(RML_LOG_KV_BINARY)
+	LogKV_v(Src, LogLvl, Fields, VaList, LOG_IN_ISR());
+	#else
+	LogMsg_v(Src, LogLvl, Fields, VaList, LOG_IN_ISR(), NULL);		//The pairs are already readable text
+	#endif
+	va_end(VaList);							//Clean up the list
+}
+
+
+
+
+//"00" to "FF", the 2 chars of each byte value
+static const char Hex_Pairs[] = 
+	"000102030405060708090A0B0C0D0E0F"
+	"101112131415161718191A1B1C1D1E1F"
+	"202122232425262728292A2B2C2D2E2F"
+	"303132333435363738393A3B3C3D3E3F"
+	"404142434445464748494A4B4C4D4E4F"
+	"505152535455565758595A5B5C5D5E5F"
+	"606162636465666768696A6B6C6D6E6F"
+	"707172737475767778797A7B7C7D7E7F"
+	"808182838485868788898A8B8C8D8E8F"
+	"909192939495969798999A9B9C9D9E9F"
+	"A0A1A2A3A4A5A6A7A8A9AAABACADAEAF"
+	"B0B1B2B3B4B5B6B7B8B9BABBBCBDBEBF"
+	"C0C1C2C3C4C5C6C7C8C9CACBCCCDCECF"
+	"D0D1D2D3D4D5D6D7D8D9DADBDCDDDEDF"
+	"E0E1E2E3E4E5E6E7E8E9EAEBECEDEEEF"
+	"F0F1F2F3F4F5F6F7F8F9FAFBFCFDFEFF";
+
+#define LOG_HEX_ROW_BYTES			16
+#define LOG_HEX_ROW_SIZE			(8 + 2 + LOG_HEX_ROW_BYTES * 3 + 1 + 2 + LOG_HEX_ROW_BYTES + 2)
+
+//One row of a hex dump, like hexdump -C: the offset, up to 16 bytes in hex (with a gap after the 8th) and the same 
+//bytes as ASCII, '.' for anything not printable. Returns the row length
+static uint32_t LogHex_Row(char *Row, uint32_t Offset, uint8_t OffsetDigits, const uint8_t *Bytes, uint32_t Count)
+{
+	char *Ptr = Row;
+
+	for( int8_t Shift = (int8_t)((OffsetDigits - 2) * 4); Shift >= 0; Shift -= 8 )
+	{
+		memcpy(Ptr, &Hex_Pairs[((Offset >> Shift) & 0xFF) * 2], 2);
+		Ptr += 2;
+	}
+	*Ptr++ = ' ';
+
+	/* Hex columns, a short last row is padded so the ASCII column still lines up */
+	for( uint32_t i = 0; i < LOG_HEX_ROW_BYTES; i++ )
+	{
+		*Ptr++ = ' ';
+		if( i == LOG_HEX_ROW_BYTES / 2 )
+		{
+			*Ptr++ = ' ';
+		}
+		if( i < Count )
+		{
+			memcpy(Ptr, &Hex_Pairs[Bytes[i] * 2], 2);
+		}
+		else
+		{
+			Ptr[0] = ' ';
+			Ptr[1] = ' ';
+		}
+		Ptr += 2;
+	}
+
+	/* ASCII column */
+	*Ptr++ = ' ';
+	*Ptr++ = ' ';
+	*Ptr++ = '|';
+	for( uint32_t i = 0; i < Count; i++ )
+	{
+		*Ptr++ = (Bytes[i] >= 0x20 && Bytes[i] < 0x7F) ? (char)Bytes[i] : '.';
+	}
+	*Ptr++ = '|';
+	*Ptr = '\0';
+
+	return (uint32_t)(Ptr - Row);
+}
+
+
+
+void RML_COMM_LogHex(char *Src, uint8_t LogLvl, const void *Data, uint32_t Len)
+{
+	const uint8_t *Bytes = (const uint8_t*)Data;
+	char Row[LOG_HEX_ROW_SIZE];
+	uint8_t FromISR = LOG_IN_ISR();
+	uint8_t OffsetDigits;
+	uint8_t Batched;
+	uint32_t Count, RowLen;
+
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return;
+	}
+
+	/* Check if Log level is enabled (unknown log levels are always logged): */
+	if( LogLvl <= e_FATAL && !((__atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED) >> LogLvl) & 1) )
+	{
+		LOG_STAT_ADD(Filtered, 1);
+		return;
+	}
+
+	if( Bytes == NULL )
+	{
+		Len = 0;
+	}
+	OffsetDigits = (Len > 0x10000) ? 8 : 4;
+
+	/* The dump goes out as one batch so lines from other tasks can't land between its rows, unless the caller 
+	 * already has a batch open (the rows then join it) */
+	Batched = !FromISR && RML_COMM_LogBatchBegin() == 0;
+
+	LogMsg_Notice(Src, LogLvl, FromISR, LogHex_HeadFmt, (unsigned int)Len);
+	for( uint32_t Offset = 0; Offset < Len; Offset += Count )
+	{
+		Count = (Len - Offset < LOG_HEX_ROW_BYTES) ? Len - Offset : LOG_HEX_ROW_BYTES;
+		RowLen = LogHex_Row(Row, Offset, OffsetDigits, &Bytes[Offset], Count);
+		LogMsg_Notice(Src, LogLvl, FromISR, LogHex_RowFmt, Row, &Row[(RowLen > 48) ? 48 : RowLen]);
+	}
+
+	if( Batched )
+	{
+		RML_COMM_LogBatchEnd();
+	}
+}
+
+
+
+void RML_COMM_LogModMsg(int8_t Handle, uint8_t LogLvl, char* Msg, ... )
+{
+	/* Error check: Makes sure the logger was initialized and the handle is valid */
+	if( !Logger_InitDone || Handle < 0 || Handle >= __atomic_load_n(&LogModule_Count, __ATOMIC_ACQUIRE) )
+	{
+		return;
+	}
+
+	/* Check if Log level is enabled for this module (unknown log levels are always logged): */
+	if( LogLvl <= e_FATAL && !((__atomic_load_n(&LogModule_EffMask[Handle], __ATOMIC_RELAXED) >> LogLvl) & 1) )
+	{
+		LOG_STAT_ADD(Filtered, 1);
+		return;
+	}
+
+	/* Over the module's rate limit: dropped before any formatting */
+	if( !LogModule_TakeToken(Handle, LogLvl, LOG_IN_ISR()) )
+	{
+		return;
+	}
+	LOG_STAT_ADD(ModuleLines[Handle], 1);
+
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
+	va_start(VaList, Msg);					//Create a list for arguments given after 'Msg'
+	LogMsg_v(LogModule_Name[Handle], LogLvl, Msg, VaList, LOG_IN_ISR(), NULL);
+	va_end(VaList);							//Clean up the list
+}
+
+
+
+//Recomputes the effective mask of every module after the global mask changed
+static void LogModule_UpdateAll(void)
+{
+	uint8_t Count = __atomic_load_n(&LogModule_Count, __ATOMIC_ACQUIRE);
+	uint8_t Global = __atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED);
+
+	for( uint8_t i = 0; i < Count; i++ )
+	{
+		__atomic_store_n(&LogModule_EffMask[i], LogModule_Mask[i] & Global, __ATOMIC_RELAXED);
+	}
+}
+
+
+
+int8_t RML_COMM_LogLevelSet(uint8_t LogLvl, uint8_t Enable)
+{
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return -1;
+	}
+
+	/* Error check: Log level is unknown */
+	if(LogLvl > e_FATAL)
+	{
+		return -1;
+	}
+
+	/* Set or clear the bit of that log level */
+	if(Enable)
+	{
+		__atomic_fetch_or(&LogLevelsMask, (uint8_t)(1 << LogLvl), __ATOMIC_RELAXED);
+	}
+	else
+	{
+		__atomic_fetch_and(&LogLevelsMask, (uint8_t)~(1 << LogLvl), __ATOMIC_RELAXED);
+	}
+	LogModule_UpdateAll();
+
+	return 0;
+}
+
+
+
+int8_t RML_COMM_LogModuleRegister(const char *Name)
+{
+	uint8_t Count = __atomic_load_n(&LogModule_Count, __ATOMIC_ACQUIRE);
+
+	/* Error check: no name given */
+	if( Name == NULL )
+	{
+		return -1;
+	}
+
+	/* Already registered? Hand out the same handle */
+	for( uint8_t i = 0; i < Count; i++ )
+	{
+		if( strcmp(LogModule_Name[i], Name) == 0 )
+		{
+			return i;
+		}
+	}
+
+	/* Error check: the table is full */
+	if( Count >= RML_LOG_MAX_MODULES )
+	{
+		return -1;
+	}
+
+	/* New module, all levels enabled by default. Count is published last so readers never see a half filled entry */
+	LogModule_Name[Count] = Name;
+	LogModule_Mask[Count] = LOG_LEVELS_ALL;
+	LogModule_EffMask[Count] = __atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED);
+	__atomic_store_n(&LogModule_Count, Count + 1, __ATOMIC_RELEASE);
+
+	return Count;
+}
+
+
+
+int8_t RML_COMM_LogModuleLevelSet(int8_t Handle, uint8_t MinLogLvl)
+{
+	/* Error check: invalid handle or log level */
+	if( Handle < 0 || Handle >= __atomic_load_n(&LogModule_Count, __ATOMIC_ACQUIRE) || MinLogLvl > e_FATAL + 1 )
+	{
+		return -1;
+	}
+
+	/* Enable MinLogLvl and everything above it */
+	LogModule_Mask[Handle] = (uint8_t)(LOG_LEVELS_ALL & ~((1 << MinLogLvl) - 1));
+	__atomic_store_n(&LogModule_EffMask[Handle], LogModule_Mask[Handle] & __atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED), __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+
+
+int8_t RML_COMM_LogModuleRateSet(int8_t Handle, uint16_t Rate_per_s, uint16_t Burst)
+{
+	/* Error check: invalid handle */
+	if( Handle < 0 || Handle >= __atomic_load_n(&LogModule_Count, __ATOMIC_ACQUIRE) )
+	{
+		return -1;
+	}
+
+	/* Start with a full bucket, the rate is published last */
+	Burst = (Burst == 0) ? 1 : Burst;
+	__atomic_store_n(&LogModule_Rate[Handle], 0, __ATOMIC_RELAXED);
+	__atomic_store_n(&LogModule_Burst[Handle], Burst, __ATOMIC_RELAXED);
+	__atomic_store_n(&LogModule_Tokens[Handle], (uint32_t)Burst * 1000, __ATOMIC_RELAXED);
+	__atomic_store_n(&LogModule_Refill_ms[Handle], Log_GetTime_ms(), __ATOMIC_RELAXED);
+	__atomic_store_n(&LogModule_Rate[Handle], Rate_per_s, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+
+uint8_t RML_COMM_LogRateCheck(uint32_t *Last_ms, uint32_t Period_ms)
+{
+	uint32_t Now_ms = Log_GetTime_ms() | 1;				//0 is kept for "never logged"
+	uint32_t Last = __atomic_load_n(Last_ms, __ATOMIC_RELAXED);
+
+	if( Last != 0 && Now_ms - Last < Period_ms )
+	{
+		return 0;
+	}
+
+	/* Only one of several callers racing for the same period wins */
+	return __atomic_compare_exchange_n(Last_ms, &Last, Now_ms, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED) ? 1 : 0;
+}
+
+
+
+uint8_t RML_COMM_LogEnabled(int8_t Handle, uint8_t LogLvl)
+{
+	if( !Logger_InitDone || LogLvl > e_FATAL )
+	{
+		return Logger_InitDone;
+	}
+
+	/* No module: only the global mask applies */
+	if( Handle < 0 || Handle >= __atomic_load_n(&LogModule_Count, __ATOMIC_ACQUIRE) )
+	{
+		return (__atomic_load_n(&LogLevelsMask, __ATOMIC_RELAXED) >> LogLvl) & 1;
+	}
+
+	return (__atomic_load_n(&LogModule_EffMask[Handle], __ATOMIC_RELAXED) >> LogLvl) & 1;
+}
+
+
+
+uint32_t RML_COMM_LogDroppedGet(void)
+{
+	return __atomic_load_n(&Log_DroppedCount, __ATOMIC_RELAXED);
+}
+
+
+
+int8_t RML_COMM_LogFlush(uint32_t Timeout_ms)
+{
+	uint32_t Start_ms, Elapsed_ms;
+	uint32_t Target[LOG_RINGS];
+
+	/* Error check: Makes sure the logger was initialized, and we can't wait for anything in an interrupt */
+	if( !Logger_InitDone || LOG_IN_ISR() )
+	{
+		return -1;
+	}
+
+	/* The caller's own batch goes out first */
+	if( LogBatch_IsMine(0) )
+	{
+		LogBatch_Send();
+	}
+
+	/* Async mode: wait until everything queued so far went through the sinks, draining it right here when the drain 
+	 * task/thread isn't busy with it (it may never get to run, ex: in RML_ASSERT()) */
+	Start_ms = Log_GetTime_ms();
+	if( LogAsync_Running )
+	{
+		for( uint32_t i = 0; i < LOG_RINGS; i++ )
+		{
+			Target[i] = __atomic_load_n(&LogRings[i].Head, __ATOMIC_ACQUIRE);
+		}
+		while( !LogRing_Drain() || !LogRing_Reached(Target) )
+		{
+			if( !LogAsync_CanBlock(0) || Log_GetTime_ms() - Start_ms >= Timeout_ms )
+			{
+				return -1;
+			}
+			LogAsync_Sleep();
+		}
+	}
+
+	/* Then the bytes have to leave the transport */
+	Elapsed_ms = Log_GetTime_ms() - Start_ms;
+	return Transport_WaitSent((Elapsed_ms < Timeout_ms) ? Timeout_ms - Elapsed_ms : 0);
+}
+
+
+
+int8_t RML_COMM_LogBatchBegin(void)
+{
+	uint32_t Start_ms;
+	uint8_t Expected;
+
+	/* Error check: Makes sure the logger was initialized, batches belong to a task so not from an interrupt */
+	if( !Logger_InitDone || LOG_IN_ISR() || LogBatch_IsMine(0) )
+	{
+		return -1;
+	}
+
+	/* Wait for the batch of another task to end, at most as long as a sync mode line would wait for the lock */
+	Start_ms = Log_GetTime_ms();
+	for(;;)
+	{
+		Expected = LOG_BATCH_FREE;
+		if( __atomic_compare_exchange_n(&LogBatch.State, &Expected, LOG_BATCH_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+		{
+			break;
+		}
+		if( !LogAsync_CanBlock(0) || Log_GetTime_ms() - Start_ms >= LogLock_Timeout_ms )
+		{
+			return -1;
+		}
+		LogAsync_Sleep();
+	}
+
+	/* The buffer is only allocated if batches are used */
+	if( LogBatch.Buff == NULL )
+	{
+		LogBatch.Buff = (char*)LOG_MALLOC(RML_LOG_BATCH_BUFF_SIZE);
+		if( LogBatch.Buff == NULL )
+		{
+			__atomic_store_n(&LogBatch.State, LOG_BATCH_FREE, __ATOMIC_RELEASE);
+			return -1;
+		}
+	}
+
+	LogBatch.Len = 0;
+	LogBatch.Lines = 0;
+	LogBatch.Owner = Log_TaskId();
+	__atomic_store_n(&LogBatch.State, LOG_BATCH_OPEN, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+
+int8_t RML_COMM_LogBatchEnd(void)
+{
+	/* Error check: the caller has no open batch */
+	if( !LogBatch_IsMine(LOG_IN_ISR()) )
+	{
+		return -1;
+	}
+
+	LogBatch_Send();
+	__atomic_store_n(&LogBatch.State, LOG_BATCH_FREE, __ATOMIC_RELEASE);
+
+	return 0;
+}
+
+
+
+uint8_t RML_COMM_LogBuffFill(void)
+{
+	uint32_t Used, MaxUsed = 0;
+
+	/* Sync mode has nothing queued */
+	if( !LogAsync_Running )
+	{
+		return 0;
+	}
+
+	/* With a ring per core the fullest one is what overflows first */
+	for( uint32_t i = 0; i < LOG_RINGS; i++ )
+	{
+		Used = __atomic_load_n(&LogRings[i].Head, __ATOMIC_RELAXED) - __atomic_load_n(&LogRings[i].Tail, __ATOMIC_RELAXED);
+		MaxUsed = (Used > MaxUsed) ? Used : MaxUsed;
+	}
+	return (uint8_t)(((uint64_t)MaxUsed * 100) / LogRings[0].Size);
+}
+
+
+
+#if defined(RML_LOG_STATS_ENABLE)
+//Reads a counter of the statistics, restarting it if asked to
+static uint32_t LogStats_Take(uint32_t *Cnt, uint8_t Reset)
+{
+	return Reset ? __atomic_exchange_n(Cnt, 0, __ATOMIC_RELAXED) : __atomic_load_n(Cnt, __ATOMIC_RELAXED);
+}
+
+int8_t RML_COMM_LogGetStats(LogStats_Struct *Stats, uint8_t Reset)
+{
+	uint32_t Dropped, Peak;
+
+	/* Error check: Makes sure the output struct is valid */
+	if( Stats == NULL )
+	{
+		return -1;
+	}
+
+	/* Each counter is read (and reset) on its own, a message logged meanwhile may show up in some counters and 
+	 * not in others */
+	for( uint32_t i = 0; i < RML_LOG_STATS_LEVELS; i++ )
+	{
+		Stats->Lines[i] = LogStats_Take(&Log_Stats.Lines[i], Reset);
+		Stats->Bytes[i] = LogStats_Take(&Log_Stats.Bytes[i], Reset);
+	}
+	for( uint32_t i = 0; i < RML_LOG_MAX_MODULES; i++ )
+	{
+		Stats->ModuleLines[i] = LogStats_Take(&Log_Stats.ModuleLines[i], Reset);
+	}
+	Stats->Filtered = LogStats_Take(&Log_Stats.Filtered, Reset);
+	Stats->Suppressed = LogStats_Take(&Log_Stats.Suppressed, Reset);
+	Stats->TxCalls = LogStats_Take(&Log_Stats.TxCalls, Reset);
+	Stats->TxMax_us = LogStats_Take(&Log_Stats.TxMax_us, Reset);
+	Stats->TxTotal_us = LogStats_Take(&Log_Stats.TxTotal_us, Reset);
+	Stats->TxAvg_us = (Stats->TxCalls > 0) ? (Stats->TxTotal_us / Stats->TxCalls) : 0;
+
+	Dropped = __atomic_load_n(&Log_DroppedCount, __ATOMIC_RELAXED);
+	Stats->Dropped = Dropped - __atomic_load_n(&LogStats_DroppedBase, __ATOMIC_RELAXED);
+	Peak = LogStats_Take(&LogStats_BuffPeak, Reset);
+	Stats->BuffPeak = (LogRings[0].Size > 0) ? (uint8_t)(((uint64_t)Peak * 100) / LogRings[0].Size) : 0;
+	if( Reset )
+	{
+		__atomic_store_n(&LogStats_DroppedBase, Dropped, __ATOMIC_RELAXED);
+	}
+
+	return 0;
+}
+#endif
+
+
+
+#if !defined(ESP32) && !defined(STM32H725xx) && !defined(STM32H735xx)
+int8_t RML_COMM_LogFileSet(const char *Path, uint32_t MaxBytes, uint8_t Keep)
+{
+	char *NewPath = NULL;
+	int NewFd = STDOUT_FILENO;
+	uint8_t Taken, Drain = 0;
+
+	/* Open the new output first, on failure the current one is kept */
+	if( Path != NULL )
+	{
+		NewPath = strdup(Path);
+		NewFd = Native_FileOpen(Path);
+		if( NewPath == NULL || NewFd < 0 )
+		{
+			free(NewPath);
+			if( NewFd >= 0 )
+			{
+				close(NewFd);
+			}
+			return -1;
+		}
+	}
+
+	/* Nobody may be writing while the output is switched: hold the sync mode lock and the drain */
+	Taken = LogLock_Take();
+	if( Taken != 0 && LogAsync_Running )
+	{
+		Drain = LogDrain_Lock(LogLock_Timeout_ms);
+	}
+	if( Taken == 0 || (LogAsync_Running && !Drain) )
+	{
+		LogLock_Give(Taken);
+		free(NewPath);
+		if( NewFd != STDOUT_FILENO )
+		{
+			close(NewFd);
+		}
+		return -1;
+	}
+
+	/* What is still queued or buffered belongs to the old output */
+	if( Drain )
+	{
+		LogRing_DrainLocked();
+		LogSink_FlushAll();
+	}
+	Transport_Flush();
+	if( Native_Fd != STDOUT_FILENO )
+	{
+		close(Native_Fd);
+	}
+	free(Native_FilePath);
+
+	Native_Fd = NewFd;
+	Native_FilePath = NewPath;
+	Native_FileBytes = 0;
+	Native_FileMaxBytes = MaxBytes;
+	Native_FileKeep = Keep;
+
+	if( Drain )
+	{
+		LogDrain_Unlock();
+	}
+	LogLock_Give(Taken);
+
+	return 0;
+}
+#endif
+
+
+
+int8_t RML_COMM_LogSinkAdd(const LogSink_Struct *Sink)
+{
+	uint8_t Expected;
+
+	/* Error check: no sink or no write callback given, or the log level is unknown */
+	if( Sink == NULL || Sink->Write == NULL || Sink->MinLogLvl > e_FATAL + 1 )
+	{
+		return -1;
+	}
+
+	/* Claim a free slot, it is only published once filled in */
+	for( uint8_t i = 0; i < RML_LOG_MAX_SINKS; i++ )
+	{
+		Expected = LOG_SINK_FREE;
+		if( __atomic_compare_exchange_n(&LogSink_State[i], &Expected, LOG_SINK_BUSY, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED) )
+		{
+			LogSink_Table[i] = *Sink;
+			__atomic_store_n(&LogSink_State[i], LOG_SINK_ACTIVE, __ATOMIC_RELEASE);
+			return i;
+		}
+	}
+
+	/* Error check: the table is full */
+	return -1;
+}
+
+
+
+int8_t RML_COMM_LogSinkRemove(int8_t Handle)
+{
+	uint8_t Expected = LOG_SINK_ACTIVE;
+
+	/* Error check: invalid handle */
+	if( Handle < 0 || Handle >= RML_LOG_MAX_SINKS )
+	{
+		return -1;
+	}
+
+	return __atomic_compare_exchange_n(&LogSink_State[Handle], &Expected, LOG_SINK_FREE, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED) ? 0 : -1;
+}
+
+
+
+int8_t RML_COMM_LogSinkLevelSet(int8_t Handle, uint8_t MinLogLvl)
+{
+	/* Error check: invalid handle or log level */
+	if( Handle < 0 || Handle >= RML_LOG_MAX_SINKS || MinLogLvl > e_FATAL + 1 
+		|| __atomic_load_n(&LogSink_State[Handle], __ATOMIC_ACQUIRE) != LOG_SINK_ACTIVE )
+	{
+		return -1;
+	}
+
+	__atomic_store_n(&LogSink_Table[Handle].MinLogLvl, MinLogLvl, __ATOMIC_RELAXED);
+
+	return 0;
+}
+
+
+
+#if defined(RML_LOG_CRASHLOG_ENABLE)
+int32_t RML_COMM_CrashLogRead(char *Buff, uint32_t BuffSize)
+{
+	uint32_t Head, Pos, Chunk, Len = 0;
+
+	/* Error check: nowhere to write to */
+	if( Buff == NULL )
+	{
+		return -1;
+	}
+	CrashLog_Open();
+
+	/* Oldest to newest, only the newest BuffSize bytes if it doesn't all fit */
+	Head = __atomic_load_n(&CrashLog.Head, __ATOMIC_RELAXED);
+	Pos = CrashLog_Start((Head > RML_LOG_CRASHLOG_SIZE) ? Head - RML_LOG_CRASHLOG_SIZE - 1 : 0, Head);
+	if( Head - Pos > BuffSize )
+	{
+		Pos = Head - BuffSize;
+	}
+
+	while( Pos != Head )
+	{
+		Chunk = RML_LOG_CRASHLOG_SIZE - (Pos & (RML_LOG_CRASHLOG_SIZE - 1));
+		if( Chunk > Head - Pos )
+		{
+			Chunk = Head - Pos;
+		}
+		memcpy(&Buff[Len], &CrashLog.Buff[Pos & (RML_LOG_CRASHLOG_SIZE - 1)], Chunk);
+		Len += Chunk;
+		Pos += Chunk;
+	}
+
+	return (int32_t)Len;
+}
+
+
+
+uint8_t RML_COMM_CrashLogReason(void)
+{
+	CrashLog_Open();
+	return CrashLog_PrevReason;
+}
+
+
+
+void RML_COMM_CrashLogClear(void)
+{
+	CrashLog_Open();
+	CrashLog.Head = 0;
+	CrashLog.Dumped = 0;
+	CrashLog_PrevReason = e_CRASH_NONE;
+}
+#endif
+
+
+
+#if defined(RML_PROFILE_ENABLE)
+/*********************************************
+ * Profiling
+ *********************************************/
+/*
+ * Begin/end events are recorded into a per-core ring of RML_PROFILE_BUFF_EVENTS entries, keeping the newest ones.
+ * A slot is reserved with an atomic add so tasks and interrupts on the same core never share one. 
+ * RML_COMM_ProfileDump() sends them as binary frames (see extras/tools/rml_log_decode.py --trace):
+ * 		[0xA6] [PayloadLen] [Core] [TickRate_Hz x4] ([Ticks x4] [Name address x4] [Type x1]) x N [Checksum]
+ * Ticks are the low 32 bits of the core's cycle counter (ns on native), the decoder unwraps them so two events
+ * of a core must not be more than one wrap apart.
+ */
+#if (RML_PROFILE_BUFF_EVENTS & (RML_PROFILE_BUFF_EVENTS - 1)) != 0
+#error "RML_PROFILE_BUFF_EVENTS must be a power of 2"
+#endif
+#define PROFILE_SYNC			0xA6
+#define PROFILE_EVENT_SIZE		9					//Size of an event in a frame
+#define PROFILE_FRAME_MAX		(((RML_LOG_LINE_MAX_SIZE < 258) ? RML_LOG_LINE_MAX_SIZE : 258) - 3)		//Payload limit, a frame must fit in a log line
+
+/***************************************
+ * @brief Recorded event
+ ***************************************/
+typedef struct
+{
+	uint32_t Ticks;					//Cycle counter when the event was recorded
+	const char *Name;				//String literal given to the macro
+	uint8_t Type;					//ProfileEvent_Enum
+} ProfileEvent_Struct;
+
+static ProfileEvent_Struct Profile_Events[PROFILE_CORES][RML_PROFILE_BUFF_EVENTS];
+static uint32_t Profile_Count[PROFILE_CORES];		//Total number of events recorded on each core (free running)
+static uint8_t Profile_Paused = 0;					//Set while the buffers are being dumped
+
+
+
+void RML_COMM_ProfileEvent(const char *Name, uint8_t Type)
+{
+	uint32_t Ticks = PROFILE_TICKS();				//Read first so the bookkeeping below isn't measured
+	uint32_t Core = PROFILE_CORE_ID();
+	ProfileEvent_Struct *Event;
+
+	if( __atomic_load_n(&Profile_Paused, __ATOMIC_RELAXED) )
+	{
+		return;
+	}
+
+	Event = &Profile_Events[Core][__atomic_fetch_add(&Profile_Count[Core], 1, __ATOMIC_RELAXED) & (RML_PROFILE_BUFF_EVENTS - 1)];
+	Event->Ticks = Ticks;
+	Event->Name = Name;
+	Event->Type = Type;
+}
+
+
+
+int32_t RML_COMM_ProfileDump(void)
+{
+	uint8_t Frame[PROFILE_FRAME_MAX + 3];
+	uint32_t TickRate = PROFILE_TICK_RATE_HZ();
+	uint32_t Count, Pos, Len, NameAddr, Total = 0;
+	uint8_t Checksum;
+	ProfileEvent_Struct *Event;
+
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return -1;
+	}
+
+	__atomic_store_n(&Profile_Paused, 1, __ATOMIC_RELAXED);
+
+	for( uint8_t Core = 0; Core < PROFILE_CORES; Core++ )
+	{
+		/* Oldest to newest, the ring keeps the last RML_PROFILE_BUFF_EVENTS events */
+		Count = __atomic_load_n(&Profile_Count[Core], __ATOMIC_RELAXED);
+		Pos = (Count > RML_PROFILE_BUFF_EVENTS) ? Count - RML_PROFILE_BUFF_EVENTS : 0;
+
+		while( Pos != Count )
+		{
+			Frame[2] = Core;
+			memcpy(&Frame[3], &TickRate, 4);
+			Len = 5;
+
+			for( ; Pos != Count && Len + PROFILE_EVENT_SIZE <= PROFILE_FRAME_MAX; Pos++ )
+			{
+				Event = &Profile_Events[Core][Pos & (RML_PROFILE_BUFF_EVENTS - 1)];
+				NameAddr = (uint32_t)(uintptr_t)Event->Name;
+				memcpy(&Frame[2 + Len], &Event->Ticks, 4);
+				memcpy(&Frame[2 + Len + 4], &NameAddr, 4);
+				Frame[2 + Len + 8] = Event->Type;
+				Len += PROFILE_EVENT_SIZE;
+				Total++;
+			}
+
+			/* Header and checksum, same as tokenized log frames */
+			Checksum = 0;
+			for( uint32_t i = 0; i < Len; i++ )
+			{
+				Checksum += Frame[2 + i];
+			}
+			Frame[0] = PROFILE_SYNC;
+			Frame[1] = (uint8_t)Len;
+			Frame[2 + Len] = Checksum;
+			LogLine_Send((const char*)Frame, Len + 3, LOGREC_LVL_NONE, 0);
+		}
+
+		__atomic_store_n(&Profile_Count[Core], 0, __ATOMIC_RELAXED);
+	}
+
+	__atomic_store_n(&Profile_Paused, 0, __ATOMIC_RELAXED);
+
+	return (int32_t)Total;
+}
+#endif
+
+
+
+
+void RML_COMM_printf( char * InputStr, ... )
+{
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return;
+	}
+
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
+	va_start(VaList, InputStr);				//Create a list for arguments given after 'InputStr'
+
+	RML_COMM_vprintf(InputStr, VaList);	//Call the vprintf function to handle the rest
+
+	va_end(VaList);							//Clean up the list
+}
+
+
+
+
+void RML_COMM_vprintf( char * InputStr, va_list VaList )
+{
+	/* Error check: Makes sure the logger was initialized */
+	if(!Logger_InitDone)
+	{
+		return;
+	}
+
+	/* Format on the stack: in sync mode the buffer is sent whenever it fills up so output isn't limited 
+	 * in length, in async mode it is queued in one go (truncated at RML_LOG_LINE_MAX_SIZE) */
+	char Line[RML_LOG_LINE_MAX_SIZE];
+	FmtOut_Struct Out = { Line, sizeof(Line), 0, (uint8_t)!LogAsync_Running, 0 };
+	uint8_t Taken;
+
+	/* Inside a batch the output joins it (truncated at RML_LOG_LINE_MAX_SIZE) */
+	if( LogBatch_IsMine(LOG_IN_ISR()) )
+	{
+		Out.ToTransport = 0;
+		Fmt_vformat(&Out, InputStr, VaList);
+		LogStats_Line(LOGREC_LVL_NONE, Out.Len);
+		LogBatch_Append(Line, Out.Len, LOGREC_LVL_NONE);
+		return;
+	}
+
+	if( LogAsync_Running )
+	{
+		Fmt_vformat(&Out, InputStr, VaList);
+		LogStats_Line(LOGREC_LVL_NONE, Out.Len);
+		LogRing_Push(Line, Out.Len, LOGREC_LVL_NONE, LOG_IN_ISR());
+		return;
+	}
+
+	/* Sync mode: hold the logger lock for the whole output so it doesn't interleave with log lines */
+	if( LOG_IN_ISR() || (Taken = LogLock_Take()) == 0 )
+	{
+		__atomic_fetch_add(&Log_DroppedCount, 1, __ATOMIC_RELAXED);
+		return;
+	}
+
+	LogStats_Line(LOGREC_LVL_NONE, 0);				//Its bytes are counted as they are sent
+	Fmt_vformat(&Out, InputStr, VaList);
+	Fmt_Flush(&Out);
+	LogSink_FlushAll();
+	LogLock_Give(Taken);
+}
+
+
+
+int32_t RML_COMM_snprintf(char *Buff, uint32_t BuffSize, const char *InputStr, ... )
+{
+	int32_t Len;
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
+
+	va_start(VaList, InputStr);				//Create a list for arguments given after 'InputStr'
+	Len = RML_COMM_vsnprintf(Buff, BuffSize, InputStr, VaList);
+	va_end(VaList);							//Clean up the list
+
+	return Len;
+}
+
+
+
+int32_t RML_COMM_vsnprintf(char *Buff, uint32_t BuffSize, const char *InputStr, va_list VaList)
+{
+	char Dummy;
+
+	/* Error check: Nowhere to write to, a size of 0 only measures the output */
+	if( Buff == NULL && BuffSize != 0 )
+	{
+		return -1;
+	}
+
+	FmtOut_Struct Out = { (BuffSize == 0) ? &Dummy : Buff, (BuffSize == 0) ? 0 : BuffSize - 1, 0, 0, 0 };		//Keep room for the null terminator
+
+	Fmt_vformat(&Out, InputStr, VaList);
+	if( BuffSize != 0 )
+	{
+		Buff[Out.Len] = '\0';
+	}
+
+	return (int32_t)(Out.Len + Out.Truncated);
+}
+
+
+
+//Sign prefix of a number for the '+'/' ' flags
+static const char* Fmt_SignPrefix(const FmtSpec_Struct *Spec, uint8_t Negative)
+{
+	if( Negative )						return "-";
+	if( Spec->Flags & FMT_FLAG_PLUS )	return "+";
+	if( Spec->Flags & FMT_FLAG_SPACE )	return " ";
+	return "";
+}
+
+//Prints an integer magnitude, the precision is the min number of digits
+static void Fmt_Integer(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, uint64_t Magnitude, const char *Prefix, uint8_t Base)
+{
+	char IntStr[24];				//A 64-bit int is up to 20 digits (16 in hex)
+	int32_t Len = 0;
+	int32_t Pad;
+
+	if( Spec->Precision != 0 || Magnitude != 0 )		//"%.0d" of 0 prints no digits
+	{
+		Len = RML_COMM_utoa64(Magnitude, IntStr, sizeof(IntStr), Base);
+	}
+
+	Pad = Fmt_FieldBegin(Out, Spec, Prefix, Len, (Spec->Precision > Len) ? (Spec->Precision - Len) : 0,
+						 (Spec->Flags & FMT_FLAG_ZERO) && Spec->Precision < 0);
+	Fmt_PutStrN(Out, IntStr, Len);
+	Fmt_FieldEnd(Out, Pad);
+}
+
+
+/* Conversion handlers, called through Fmt_ConvHandlers[] with the parsed specifier */
+
+//Unknown conversion - just print it in hopes of the user realizing that
+static void Fmt_ConvUnknown(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	(void)Args;
+	if( Spec->Char )
+	{
+		Fmt_PutChar(Out, '%');
+		Fmt_PutChar(Out, Spec->Char);
+	}
+}
+
+//User wants to print a '%'
+static void Fmt_ConvPercent(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	(void)Spec;
+	(void)Args;
+	Fmt_PutChar(Out, '%');
+}
+
+//String, the precision is the max number of chars printed
+static void Fmt_ConvStr(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	const char *StringArg = va_arg(*Args, const char *);
+	uint32_t Len = 0;
+	int32_t Pad;
+
+	if( StringArg == NULL )
+	{
+		StringArg = "(null)";
+	}
+	while( StringArg[Len] && (Spec->Precision < 0 || Len < (uint32_t)Spec->Precision) )
+	{
+		Len++;
+	}
+
+	Pad = Fmt_FieldBegin(Out, Spec, "", Len, 0, 0);
+	Fmt_PutStrN(Out, StringArg, Len);
+	Fmt_FieldEnd(Out, Pad);
+}
+
+//Character
+static void Fmt_ConvChar(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	char CharArg = (char)va_arg(*Args, int);					//va_arg() needs int for char
+	int32_t Pad = Fmt_FieldBegin(Out, Spec, "", 1, 0, 0);
+
+	Fmt_PutChar(Out, CharArg);
+	Fmt_FieldEnd(Out, Pad);
+}
+
+//Signed int, read with the size given by the length modifier
+static void Fmt_ConvSigned(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	int64_t SignedArg;
+
+	switch( Spec->Length )
+	{
+		case 'L':	SignedArg = va_arg(*Args, long long);					break;
+		case 'l':	SignedArg = va_arg(*Args, long);						break;
+		case 'z':	SignedArg = (sizeof(size_t) == 8) ? (int64_t)va_arg(*Args, size_t) : (int32_t)va_arg(*Args, size_t);	break;
+		case 'h':	SignedArg = (short)va_arg(*Args, int);					break;
+		case 'H':	SignedArg = (signed char)va_arg(*Args, int);			break;
+		default:	SignedArg = va_arg(*Args, int);							break;
+	}
+
+	/* Work on the magnitude, computed in unsigned so INT64_MIN doesn't overflow */
+	Fmt_Integer(Out, Spec, (SignedArg < 0) ? (0u - (uint64_t)SignedArg) : (uint64_t)SignedArg, 
+				Fmt_SignPrefix(Spec, SignedArg < 0), 10);
+}
+
+//Unsigned int (%u) or hex value (%x/%X, digits are always upper case)
+static void Fmt_ConvUnsigned(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	uint64_t UnsignedArg;
+	const char *Prefix = "";
+
+	switch( Spec->Length )
+	{
+		case 'L':	UnsignedArg = va_arg(*Args, unsigned long long);		break;
+		case 'l':	UnsignedArg = va_arg(*Args, unsigned long);				break;
+		case 'z':	UnsignedArg = va_arg(*Args, size_t);					break;
+		case 'h':	UnsignedArg = (unsigned short)va_arg(*Args, unsigned);	break;
+		case 'H':	UnsignedArg = (unsigned char)va_arg(*Args, unsigned);	break;
+		default:	UnsignedArg = va_arg(*Args, unsigned);					break;
+	}
+
+	if( Spec->Char == 'u' )
+	{
+		Fmt_Integer(Out, Spec, UnsignedArg, Prefix, 10);
+		return;
+	}
+
+	if( (Spec->Flags & FMT_FLAG_ALT) && UnsignedArg != 0 )
+	{
+		Prefix = (Spec->Char == 'X') ? "0X" : "0x";
+	}
+	Fmt_Integer(Out, Spec, UnsignedArg, Prefix, 16);
+}
+
+//Double/float value, default precision is 2 decimal places
+static void Fmt_ConvFloat(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	Fmt_Float(Out, Spec, va_arg(*Args, double));
+}
+
+//Pointer, printed as 0x followed by all of its hex digits
+static void Fmt_ConvPtr(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args)
+{
+	FmtSpec_Struct PtrSpec = *Spec;
+
+	if( PtrSpec.Precision < 0 )
+	{
+		PtrSpec.Precision = sizeof(void *) * 2;
+	}
+	Fmt_Integer(Out, &PtrSpec, (uintptr_t)va_arg(*Args, void *), "0x", 16);
+}
+
+static void (* const Fmt_ConvHandlers[FMT_CONV_COUNT])(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, va_list *Args) = 
+{
+	Fmt_ConvUnknown,			//FMT_CONV_UNKNOWN
+	Fmt_ConvPercent,			//FMT_CONV_PERCENT
+	Fmt_ConvStr,				//FMT_CONV_STR
+	Fmt_ConvChar,				//FMT_CONV_CHAR
+	Fmt_ConvSigned,				//FMT_CONV_SIGNED
+	Fmt_ConvUnsigned,			//FMT_CONV_UNSIGNED
+	Fmt_ConvFloat,				//FMT_CONV_FLOAT
+	Fmt_ConvPtr					//FMT_CONV_PTR
+};
+
+
+//Does the actual formatting for RML_COMM_vprintf() and the logger
+static void Fmt_vformat(FmtOut_Struct *Out, const char *InputStr, va_list VaList)
+{
+	FmtSpec_Struct Spec;
+	const char *Literal;
+	va_list Args;
+
+	va_copy(Args, VaList);				//Local copy so the handlers can take its address
+
+	while( *InputStr )
+	{
+		/* Output everything up to the next format specifier in one go */
+		Literal = InputStr;
+		while( *InputStr && *InputStr != '%' )
+		{
+			InputStr++;
+		}
+		Fmt_PutStrN(Out, Literal, InputStr - Literal);
+
+		/* Parse the specifier and let its handler print the arg */
+		if( *InputStr == '%' )
+		{
+			InputStr = Fmt_ParseSpec(InputStr + 1, &Spec, &Args);
+			Fmt_ConvHandlers[Spec.Conv](Out, &Spec, &Args);
+		}
+	}
+
+	va_end(Args);
+}
+
+//1 if the specifier starting at Str takes a '*' arg, the parser needs the args for those so they can't be compiled
+static uint8_t Fmt_HasStarArg(const char *Str)
+{
+	while( *Str && strchr("-+ 0#.123456789", *Str) )
+	{
+		Str++;
+	}
+
+	return *Str == '*';
+}
+
+//Splits Fmt into literal spans and parsed specifiers. Returns 0 on success, -1 if it can't be compiled
+static int8_t Fmt_Compile(FmtProgram_Struct *Prog, const char *Fmt)
+{
+	const char *Str = Fmt;
+	const char *Literal;
+	uint8_t Count = 0;
+
+	for(;;)
+	{
+		Literal = Str;
+		while( *Str && *Str != '%' )
+		{
+			Str++;
+		}
+		if( Str - Fmt > 0xFFFF )
+		{
+			return -1;																	//Offsets are 16 bits
+		}
+		Prog->LitPos[Count] = (uint16_t)(Literal - Fmt);
+		Prog->LitLen[Count] = (uint16_t)(Str - Literal);
+
+		if( *Str == '\0' )
+		{
+			break;
+		}
+		if( Count == RML_PRINTF_MAX_ARGS || Fmt_HasStarArg(Str + 1) )
+		{
+			return -1;
+		}
+		Str = Fmt_ParseSpec(Str + 1, &Prog->Spec[Count], NULL);						//No '*', the args aren't needed
+		Count++;
+	}
+
+	Prog->Count = Count;
+	return 0;
+}
+
+//Same as Fmt_vformat() for a compiled format: the literal spans are written in one go and each arg goes straight to its handler
+static void Fmt_vformatCompiled(FmtOut_Struct *Out, const FmtProgram_Struct *Prog, const char *Fmt, va_list VaList)
+{
+	va_list Args;
+	uint8_t i;
+
+	va_copy(Args, VaList);
+
+	for( i = 0; i < Prog->Count; i++ )
+	{
+		Fmt_PutStrN(Out, &Fmt[Prog->LitPos[i]], Prog->LitLen[i]);
+		Fmt_ConvHandlers[Prog->Spec[i].Conv](Out, &Prog->Spec[i], &Args);
+	}
+	Fmt_PutStrN(Out, &Fmt[Prog->LitPos[i]], Prog->LitLen[i]);
+
+	va_end(Args);
+}
+
+
+
+
+/*************************************************
+ * @brief Digit pairs "00".."99":
+ * Base 10 conversions emit 2 digits per division
+ * by 100 (which the compiler turns into a 
+ * multiply) using this table
+ *************************************************/
+static const char DigitPairs_LUT[201] =
+	"00010203040506070809101112131415161718192021222324252627282930313233343536373839"
+	"40414243444546474849505152535455565758596061626364656667686970717273747576777879"
+	"8081828384858687888990919293949596979899";
+
+static const char Digits_Str[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ";
+
+static const uint32_t Pow10_U32[10] = { 1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000 };
+
+
+//Number of base 10 digits of Value, no division needed
+static uint32_t CountDigits10(uint32_t Value)
+{
+	uint32_t Approx = ((32 - __builtin_clz(Value | 1)) * 1233) >> 12;		//log10(2) ~= 1233/4096
+	uint32_t Digits = Approx + (Value >= Pow10_U32[Approx]);
+
+	return Digits ? Digits : 1;
+}
+
+//Writes the base 10 digits of Value right to left, ending just before End
+static void Utoa10_Write(uint32_t Value, char *End)
+{
+	uint32_t Quot;
+
+	while( Value >= 100 )
+	{
+		Quot = Value / 100;
+		End -= 2;
+		memcpy(End, &DigitPairs_LUT[(Value - Quot * 100) * 2], 2);
+		Value = Quot;
+	}
+
+	if( Value >= 10 )
+	{
+		memcpy(End - 2, &DigitPairs_LUT[Value * 2], 2);
+	}
+	else
+	{
+		End[-1] = (char)('0' + Value);
+	}
+}
+
+//Converts Value into ResultBuff (terminated), the caller already checked the base. Returns the length or -1 if it doesn't fit
+static int32_t Utoa_Core(uint32_t Value, char *ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+{
+	uint32_t Len;
+
+	/* Base 10: count the digits first so the string is written in place, right to left */
+	if( Base == 10 )
+	{
+		Len = CountDigits10(Value);
+		if( Len >= ResultBuff_Size )
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+		Utoa10_Write(Value, &ResultBuff[Len]);
+	}
+
+	/* Power of 2 bases (2, 4, 8, 16, 32): shifts and masks, no division */
+	else if( (Base & (Base - 1)) == 0 )
+	{
+		uint32_t Shift = __builtin_ctz(Base);
+		uint32_t Mask = Base - 1;
+
+		Len = ((32 - __builtin_clz(Value | 1)) + Shift - 1) / Shift;
+		if( Len >= ResultBuff_Size )
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+		for( char *Ptr = &ResultBuff[Len]; Ptr != ResultBuff; Value >>= Shift )
+		{
+			*--Ptr = Digits_Str[Value & Mask];
+		}
+	}
+
+	/* Any other base: divide, still written right to left into a scratch buffer */
+	else
+	{
+		char Tmp[32];
+		char *Ptr = &Tmp[sizeof(Tmp)];
+
+		do
+		{
+			*--Ptr = Digits_Str[Value % Base];
+			Value /= Base;
+		} while( Value );
+
+		Len = &Tmp[sizeof(Tmp)] - Ptr;
+		if( Len >= ResultBuff_Size )
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+		memcpy(ResultBuff, Ptr, Len);
+	}
+
+	ResultBuff[Len] = '\0';
+	return Len;
+}
+
+//Writes exactly 9 base 10 digits of Value (< 1e9, zero padded) right to left, ending just before End
+static void Utoa10_Write9(uint32_t Value, char *End)
+{
+	uint32_t Quot;
+
+	for( uint8_t i = 0; i < 4; i++ )
+	{
+		Quot = Value / 100;
+		End -= 2;
+		memcpy(End, &DigitPairs_LUT[(Value - Quot * 100) * 2], 2);
+		Value = Quot;
+	}
+	End[-1] = (char)('0' + Value);
+}
+
+//High 64 bits of the 128-bit product A * B, 4 32x32->64 multiplies on cores without a wide multiply
+static uint64_t MulHi64(uint64_t A, uint64_t B)
+{
+#if defined(__SIZEOF_INT128__)
+	__extension__ typedef unsigned __int128 U128;
+	return (uint64_t)(((U128)A * B) >> 64);
+#else
+	uint64_t ALo = (uint32_t)A, AHi = A >> 32;
+	uint64_t BLo = (uint32_t)B, BHi = B >> 32;
+	uint64_t LoLo = ALo * BLo;
+	uint64_t HiLo = AHi * BLo;
+	uint64_t Cross = (LoLo >> 32) + (uint32_t)HiLo + ALo * BHi;
+
+	return AHi * BHi + (HiLo >> 32) + (Cross >> 32);
+#endif
+}
+
+//Value / 1e9 without a 64-bit division (a libgcc call on 32-bit cores): 1e9 = 2^9 * 1953125, so shift out the 2^9
+//then multiply by ceil(2^75 / 1953125), exact for every 64-bit Value
+static uint64_t Div1e9_U64(uint64_t Value)
+{
+	return MulHi64(Value >> 9, 0x44B82FA09B5A53ull) >> 11;
+}
+
+//64-bit version of Utoa_Core(), values that fit in 32 bits go through the 32-bit kernels
+static int32_t Utoa64_Core(uint64_t Value, char *ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+{
+	uint32_t Len;
+
+	if( (Value >> 32) == 0 )
+	{
+		return Utoa_Core((uint32_t)Value, ResultBuff, ResultBuff_Size, Base);
+	}
+
+	/* Base 10: split into base 1e9 chunks (at most 3: Top <= 18), each printed with the 32-bit kernel */
+	if( Base == 10 )
+	{
+		uint64_t Quot = Div1e9_U64(Value);
+		uint32_t Low = (uint32_t)Value - (uint32_t)Quot * 1000000000u;		//Wraps correctly, the result is < 1e9
+		uint32_t Top = (uint32_t)Div1e9_U64(Quot);
+		uint32_t Mid = (uint32_t)Quot - Top * 1000000000u;
+
+		Len = Top ? (CountDigits10(Top) + 18) : (CountDigits10(Mid) + 9);
+		if( Len >= ResultBuff_Size )
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+
+		Utoa10_Write9(Low, &ResultBuff[Len]);
+		if( Top )
+		{
+			Utoa10_Write9(Mid, &ResultBuff[Len - 9]);
+			Utoa10_Write(Top, &ResultBuff[Len - 18]);
+		}
+		else
+		{
+			Utoa10_Write(Mid, &ResultBuff[Len - 9]);
+		}
+	}
+
+	/* Power of 2 bases: shifts and masks, no division */
+	else if( (Base & (Base - 1)) == 0 )
+	{
+		uint32_t Shift = __builtin_ctz(Base);
+		uint32_t Mask = Base - 1;
+
+		Len = ((64 - __builtin_clzll(Value)) + Shift - 1) / Shift;
+		if( Len >= ResultBuff_Size )
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+		for( char *Ptr = &ResultBuff[Len]; Ptr != ResultBuff; Value >>= Shift )
+		{
+			*--Ptr = Digits_Str[Value & Mask];
+		}
+	}
+
+	/* Any other base: a real 64-bit division, these are rare enough not to matter */
+	else
+	{
+		char Tmp[64];
+		char *Ptr = &Tmp[sizeof(Tmp)];
+
+		do
+		{
+			*--Ptr = Digits_Str[Value % Base];
+			Value /= Base;
+		} while( Value );
+
+		Len = &Tmp[sizeof(Tmp)] - Ptr;
+		if( Len >= ResultBuff_Size )
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+		memcpy(ResultBuff, Ptr, Len);
+	}
+
+	ResultBuff[Len] = '\0';
+	return Len;
+}
+
+
+
+
+/*************************************************
+ * @brief Float conversion:
+ * A float/double is split into integers once 
+ * and then printed with the integer kernels:
+ * [-][Whole][WholeZeros x '0'][.][Frac, zero 
+ * padded to FracDigits][Afterpoint - FracDigits
+ * x '0']
+ *************************************************/
+typedef struct
+{
+	uint64_t Whole;					//Integer part (or its 19/9 significant digits if WholeZeros isn't 0)
+	uint64_t Frac;					//Fractional part scaled by 10^FracDigits and rounded
+	uint16_t WholeZeros;			//Zeros printed after Whole, for values too big for an integer
+	uint8_t FracDigits;				//Number of computed decimal places
+	uint8_t Afterpoint;				//Number of printed decimal places, the ones past FracDigits are 0
+	uint8_t Negative;				//1 to print a '-'
+	const char *Special;			//"nan"/"inf" instead of digits, NULL for a normal number
+} FloatParts_Struct;
+
+#define FTOA_MAX_FRAC_DIGITS		17				//Decimal places computed by the double engine
+#define FTOAF_MAX_FRAC_DIGITS		9				//Decimal places computed by the float engine
+
+static const double Pow10_F64[FTOA_MAX_FRAC_DIGITS + 1] = 
+	{ 1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11, 1e12, 1e13, 1e14, 1e15, 1e16, 1e17 };
+
+static const float Pow10_F32[FTOAF_MAX_FRAC_DIGITS + 1] = 
+	{ 1e0f, 1e1f, 1e2f, 1e3f, 1e4f, 1e5f, 1e6f, 1e7f, 1e8f, 1e9f };
+
+//10^(2^i), used to bring huge values down to their significant digits
+static const double Pow10Bin_F64[9] = { 1e1, 1e2, 1e4, 1e8, 1e16, 1e32, 1e64, 1e128, 1e256 };
+static const float Pow10Bin_F32[6] = { 1e1f, 1e2f, 1e4f, 1e8f, 1e16f, 1e32f };
+
+//Exact error of the rounded product P = A * B (A * B - P). Only fused (exact) when the FPU has a fused multiply-add, 
+//otherwise a Dekker split which is safe since the compiler can't contract without one
+static double Float_MulErr(double A, double B, double P)
+{
+#if defined(__FP_FAST_FMA)
+	return __builtin_fma(A, B, -P);
+#else
+	const double Split = 134217729.0;			//2^27 + 1
+	double T, AHi, ALo, BHi, BLo;
+
+	T = Split * A;
+	AHi = T - (T - A);
+	ALo = A - AHi;
+	T = Split * B;
+	BHi = T - (T - B);
+	BLo = B - BHi;
+
+	return ((AHi * BHi - P) + AHi * BLo + ALo * BHi) + ALo * BLo;
+#endif
+}
+
+//Float_MulErr() for floats
+static float Floatf_MulErr(float A, float B, float P)
+{
+#if defined(__FP_FAST_FMAF)
+	return __builtin_fmaf(A, B, -P);
+#else
+	const float Split = 4097.0f;				//2^12 + 1
+	float T, AHi, ALo, BHi, BLo;
+
+	T = Split * A;
+	AHi = T - (T - A);
+	ALo = A - AHi;
+	T = Split * B;
+	BHi = T - (T - B);
+	BLo = B - BHi;
+
+	return ((AHi * BHi - P) + AHi * BLo + ALo * BHi) + ALo * BLo;
+#endif
+}
+
+//Splits a double into FloatParts_Struct, rounded to Afterpoint decimal places
+static void Float_Split(double Value, uint8_t Afterpoint, FloatParts_Struct *Parts)
+{
+	double Rest, Scaled, Rem;
+	int64_t Err;
+	uint8_t RoundUp;
+
+	Parts->Negative = __builtin_signbit(Value) ? 1 : 0;
+	Parts->Afterpoint = Afterpoint;
+	Parts->FracDigits = (Afterpoint > FTOA_MAX_FRAC_DIGITS) ? FTOA_MAX_FRAC_DIGITS : Afterpoint;
+	Parts->WholeZeros = 0;
+	Parts->Whole = 0;
+	Parts->Frac = 0;
+	Parts->Special = NULL;
+
+	if( Value != Value )
+	{
+		Parts->Special = "nan";
+		return;
+	}
+	if( Parts->Negative )
+	{
+		Value = -Value;
+	}
+	if( Value > 1.7976931348623157e308 )
+	{
+		Parts->Special = "inf";
+		return;
+	}
+
+	/* Too big for 64 bits: keep the 19 significant digits (all a double has and more), the rest are zeros */
+	if( Value >= 1e19 )
+	{
+		for( int8_t i = 8; i >= 0; i-- )
+		{
+			if( Value / Pow10Bin_F64[i] >= 1e18 )
+			{
+				Value /= Pow10Bin_F64[i];
+				Parts->WholeZeros += 1u << i;
+			}
+		}
+		Parts->Whole = (uint64_t)Value;
+		Parts->FracDigits = 0;
+		return;
+	}
+
+	/* Whole part, the 32-bit conversion is a single instruction on most FPUs */
+	Parts->Whole = (Value < 4294967296.0) ? (uint64_t)(uint32_t)Value : (uint64_t)Value;
+
+	/* Scale the fraction once and round to nearest, ties to even */
+	Rest = Value - (double)Parts->Whole;
+	Scaled = Rest * Pow10_F64[Parts->FracDigits];
+	Parts->Frac = (uint64_t)Scaled;
+	Rem = Scaled - (double)Parts->Frac;
+	if( Scaled >= 4503599627370496.0 )
+	{
+		/* Past 2^52 (16 and 17 places) the product itself lost the remainder, take it from the exact error instead */
+		Rem = Float_MulErr(Rest, Pow10_F64[Parts->FracDigits], Scaled);
+		Err = (int64_t)Rem;
+		if( (double)Err > Rem )
+		{
+			Err--;
+		}
+		Parts->Frac += (uint64_t)Err;
+		Rem -= (double)Err;
+		RoundUp = (Rem > 0.5) || (Rem == 0.5 && (Parts->Frac & 1));
+	}
+	else if( Rem == 0.5 )
+	{
+		/* The rounded product hit the halfway point, the exact product decides (0.005 is a bit above, 0.015 a bit below) */
+		Rem = Float_MulErr(Rest, Pow10_F64[Parts->FracDigits], Scaled);
+		RoundUp = (Rem > 0) || (Rem == 0 && ((Parts->FracDigits ? Parts->Frac : Parts->Whole) & 1));
+	}
+	else
+	{
+		RoundUp = (Rem > 0.5);
+	}
+	if( RoundUp )
+	{
+		Parts->Frac++;
+	}
+	if( (double)Parts->Frac >= Pow10_F64[Parts->FracDigits] )
+	{
+		Parts->Frac = 0;
+		Parts->Whole++;
+	}
+}
+
+//Splits a float into FloatParts_Struct using float and 32-bit integer math only
+static void Floatf_Split(float Value, uint8_t Afterpoint, FloatParts_Struct *Parts)
+{
+	float Rest, Scaled, Rem;
+	uint32_t Whole, Frac;
+	uint8_t RoundUp;
+
+	Parts->Negative = __builtin_signbitf(Value) ? 1 : 0;
+	Parts->Afterpoint = Afterpoint;
+	Parts->FracDigits = (Afterpoint > FTOAF_MAX_FRAC_DIGITS) ? FTOAF_MAX_FRAC_DIGITS : Afterpoint;
+	Parts->WholeZeros = 0;
+	Parts->Whole = 0;
+	Parts->Frac = 0;
+	Parts->Special = NULL;
+
+	if( Value != Value )
+	{
+		Parts->Special = "nan";
+		return;
+	}
+	if( Parts->Negative )
+	{
+		Value = -Value;
+	}
+	if( Value > 3.40282347e38f )
+	{
+		Parts->Special = "inf";
+		return;
+	}
+
+	/* Too big for 32 bits: keep 9 significant digits, the rest are zeros */
+	if( Value >= 4294967296.0f )
+	{
+		for( int8_t i = 5; i >= 0; i-- )
+		{
+			if( Value / Pow10Bin_F32[i] >= 1e8f )
+			{
+				Value /= Pow10Bin_F32[i];
+				Parts->WholeZeros += 1u << i;
+			}
+		}
+		Parts->Whole = (uint32_t)Value;
+		Parts->FracDigits = 0;
+		return;
+	}
+
+	/* Scale the fraction once and round to nearest, ties to even */
+	Whole = (uint32_t)Value;
+	Rest = Value - (float)Whole;
+	Scaled = Rest * Pow10_F32[Parts->FracDigits];
+	Frac = (uint32_t)Scaled;
+	Rem = Scaled - (float)Frac;
+	if( Rem == 0.5f )
+	{
+		Rem = Floatf_MulErr(Rest, Pow10_F32[Parts->FracDigits], Scaled);
+		RoundUp = (Rem > 0.0f) || (Rem == 0.0f && ((Parts->FracDigits ? Frac : Whole) & 1));
+	}
+	else
+	{
+		RoundUp = (Rem > 0.5f);
+	}
+	if( RoundUp )
+	{
+		Frac++;
+	}
+	if( Frac >= Pow10_U32[Parts->FracDigits] )
+	{
+		Frac = 0;
+		Whole++;
+	}
+
+	Parts->Whole = Whole;
+	Parts->Frac = Frac;
+}
+
+//Number of base 10 digits of a 64-bit Value
+static uint32_t CountDigits10_U64(uint64_t Value)
+{
+	uint32_t Digits = 0;
+
+	while( Value >> 32 )
+	{
+		Value = Div1e9_U64(Value);				//Value > 1e9, so every chunk taken off is 9 full digits
+		Digits += 9;
+	}
+
+	return Digits + CountDigits10((uint32_t)Value);
+}
+
+//Writes exactly Digits base 10 digits of Value (zero padded) right to left, ending just before End
+static void Utoa10_WriteFixed(uint64_t Value, char *End, uint32_t Digits)
+{
+	uint64_t Quot;
+	uint32_t Value32;
+
+	while( Digits > 9 )
+	{
+		Quot = Div1e9_U64(Value);
+		Utoa10_Write9((uint32_t)Value - (uint32_t)Quot * 1000000000u, End);
+		End -= 9;
+		Digits -= 9;
+		Value = Quot;
+	}
+
+	for( Value32 = (uint32_t)Value; Digits > 0; Digits--, Value32 /= 10 )
+	{
+		*--End = (char)('0' + Value32 % 10);
+	}
+}
+
+//Length of the string Float_Put() outputs
+static uint32_t Float_Len(const FloatParts_Struct *Parts)
+{
+	if( Parts->Special )
+	{
+		return Parts->Negative + 3;
+	}
+
+	return Parts->Negative + CountDigits10_U64(Parts->Whole) + Parts->WholeZeros + 
+		   (Parts->Afterpoint ? (1 + Parts->Afterpoint) : 0);
+}
+
+//Outputs the split float
+static void Float_Put(FmtOut_Struct *Out, const FloatParts_Struct *Parts)
+{
+	char DigitStr[24];
+
+	if( Parts->Negative )
+	{
+		Fmt_PutChar(Out, '-');
+	}
+	if( Parts->Special )
+	{
+		Fmt_PutStr(Out, Parts->Special);
+		return;
+	}
+
+	Utoa64_Core(Parts->Whole, DigitStr, sizeof(DigitStr), 10);
+	Fmt_PutStr(Out, DigitStr);
+	for( uint16_t i = 0; i < Parts->WholeZeros; i++ )
+	{
+		Fmt_PutChar(Out, '0');
+	}
+
+	if( Parts->Afterpoint )
+	{
+		Fmt_PutChar(Out, '.');
+		DigitStr[Parts->FracDigits] = '\0';
+		Utoa10_WriteFixed(Parts->Frac, &DigitStr[Parts->FracDigits], Parts->FracDigits);
+		Fmt_PutStr(Out, DigitStr);
+		for( uint8_t i = Parts->FracDigits; i < Parts->Afterpoint; i++ )
+		{
+			Fmt_PutChar(Out, '0');
+		}
+	}
+}
+
+//Writes the split float to ResultBuff (terminated), all or nothing. Returns the length or -1 if it doesn't fit
+static int32_t Float_ToBuff(const FloatParts_Struct *Parts, char *ResultBuff, uint32_t ResultBuff_Size)
+{
+	uint32_t Len = Float_Len(Parts);
+
+	if( ResultBuff_Size == 0 )
+	{
+		return -1;
+	}
+	if( Len >= ResultBuff_Size )
+	{
+		*ResultBuff = '\0';
+		return -1;
+	}
+
+	FmtOut_Struct Out = { ResultBuff, Len, 0, 0, 0 };
+	Float_Put(&Out, Parts);
+	ResultBuff[Len] = '\0';
+
+	return Len;
+}
+
+//Prints a float/double for %f (default precision is 2), the float engine is used when RML_PRINTF_FLOAT_SINGLE is defined
+static void Fmt_Float(FmtOut_Struct *Out, const FmtSpec_Struct *Spec, double Value)
+{
+	FloatParts_Struct Parts;
+	uint8_t Afterpoint = (Spec->Precision < 0) ? 2 : (Spec->Precision > 255) ? 255 : (uint8_t)Spec->Precision;
+	const char *Prefix;
+	int32_t Pad;
+
+#if defined(RML_PRINTF_FLOAT_SINGLE)
+	Floatf_Split((float)Value, Afterpoint, &Parts);
+#else
+	Float_Split(Value, Afterpoint, &Parts);
+#endif
+
+	/* The sign goes before any zero padding */
+	Prefix = Fmt_SignPrefix(Spec, Parts.Negative);
+	Parts.Negative = 0;
+
+	Pad = Fmt_FieldBegin(Out, Spec, Prefix, Float_Len(&Parts), 0, (Spec->Flags & FMT_FLAG_ZERO) && !Parts.Special);
+	Float_Put(Out, &Parts);
+	Fmt_FieldEnd(Out, Pad);
+}
+
+
+
+
+int32_t RML_COMM_utoa(uint32_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+{
+	// check that there is somewhere to write to
+	if (ResultBuff_Size == 0) 
 	{
-		case e_ESP_ESP32:
-			#if defined(ESP32)
-			/* We use native USB port, no need to set pins */
-			Serial.begin(UARTComm->BaudRate);
-			Serial.setTxTimeoutMs(0);				//This is used to avoid waiting if the USB is not connected 
-			#endif
-			break;
+		return -1;
+	}
 
-		case e_STM32_STM32xx:
+	// check that the base if valid
+	if (Base < 2 || Base > 36) 
+	{
+		// if the base is invalid, return an empty string
+		*ResultBuff = '\0';
+		return -1;
+	}
 
-			/* STM32H725: */
-			#if defined(STM32H725xx)
-			// Nothing to do assuming the user already init UART1 and the pins are hard-wired to be
-			//		> RX Pin: B15
-			//		> TX Pin: A9
-			LogMutex = xSemaphoreCreateMutex();
-			#endif
+	return Utoa_Core(Value, ResultBuff, ResultBuff_Size, Base);
+}
 
-			/* STM32H735: */
-			#if defined(STM32H735xx)
-			// Nothing to do assuming the user already init UART3 and the pins are hard-wired to be
-			//		> RX Pin: PD9
-			//		> TX Pin: PD8
-			LogMutex = xSemaphoreCreateMutex();
-			#endif
-			break;
-		
-		default:
-			//Native selected - nothing to do
+
+
+
+int32_t RML_COMM_itoa(int32_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+{
+	// check that there is somewhere to write to
+	if (ResultBuff_Size == 0) 
+	{
+		return -1;
+	}
+
+	// check that the base if valid
+	if (Base < 2 || Base > 36) 
+	{
+		// if the base is invalid, return an empty string
+		*ResultBuff = '\0';
+		return -1;
+	}
+
+	// work on the magnitude, computed in unsigned so INT32_MIN doesn't overflow
+	uint32_t Magnitude = (Value < 0) ? (0u - (uint32_t)Value) : (uint32_t)Value;
+	int32_t Len;
+
+	// only base 10 gets a negative sign, other bases print the magnitude
+	if (Value < 0 && Base == 10)
+	{
+		Len = (ResultBuff_Size < 2) ? -1 : Utoa_Core(Magnitude, ResultBuff + 1, ResultBuff_Size - 1, Base);
+		if (Len < 0)
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+		*ResultBuff = '-';
+		return Len + 1;
+	}
+
+	return Utoa_Core(Magnitude, ResultBuff, ResultBuff_Size, Base);
+}
+
+
+
+
+int32_t RML_COMM_utoa64(uint64_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+{
+	// check that there is somewhere to write to
+	if (ResultBuff_Size == 0) 
+	{
+		return -1;
+	}
+
+	// check that the base if valid
+	if (Base < 2 || Base > 36) 
+	{
+		// if the base is invalid, return an empty string
+		*ResultBuff = '\0';
+		return -1;
+	}
+
+	return Utoa64_Core(Value, ResultBuff, ResultBuff_Size, Base);
+}
+
+
+
+
+int32_t RML_COMM_itoa64(int64_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+{
+	// check that there is somewhere to write to
+	if (ResultBuff_Size == 0) 
+	{
+		return -1;
+	}
+
+	// check that the base if valid
+	if (Base < 2 || Base > 36) 
+	{
+		// if the base is invalid, return an empty string
+		*ResultBuff = '\0';
+		return -1;
+	}
+
+	// work on the magnitude, computed in unsigned so INT64_MIN doesn't overflow
+	uint64_t Magnitude = (Value < 0) ? (0u - (uint64_t)Value) : (uint64_t)Value;
+	int32_t Len;
+
+	// only base 10 gets a negative sign, other bases print the magnitude
+	if (Value < 0 && Base == 10)
+	{
+		Len = (ResultBuff_Size < 2) ? -1 : Utoa64_Core(Magnitude, ResultBuff + 1, ResultBuff_Size - 1, Base);
+		if (Len < 0)
+		{
+			*ResultBuff = '\0';
+			return -1;
+		}
+		*ResultBuff = '-';
+		return Len + 1;
+	}
+
+	return Utoa64_Core(Magnitude, ResultBuff, ResultBuff_Size, Base);
+}
+
+
+
+
+void RML_COMM_ReverseString(char* Str, uint32_t Length)
+{
+	char *Head = Str;
+	char *Tail = Str + Length;
+	char Temp;
+
+#if UINTPTR_MAX > 0xFFFFFFFFu
+	/* 64-bit hosts: 8 bytes from each end per step */
+	while( Tail - Head >= 16 )
+	{
+		uint64_t HeadWord, TailWord;
+
+		Tail -= 8;
+		memcpy(&HeadWord, Head, 8);
+		memcpy(&TailWord, Tail, 8);
+		HeadWord = __builtin_bswap64(HeadWord);
+		TailWord = __builtin_bswap64(TailWord);
+		memcpy(Head, &TailWord, 8);
+		memcpy(Tail, &HeadWord, 8);
+		Head += 8;
+	}
+#endif
+
+	/* 4 bytes from each end per step, each word is byte swapped (a single REV on Cortex-M) and stored on the other side */
+	while( Tail - Head >= 8 )
+	{
+		uint32_t HeadWord, TailWord;
+
+		Tail -= 4;
+		memcpy(&HeadWord, Head, 4);
+		memcpy(&TailWord, Tail, 4);
+		HeadWord = __builtin_bswap32(HeadWord);
+		TailWord = __builtin_bswap32(TailWord);
+		memcpy(Head, &TailWord, 4);
+		memcpy(Tail, &HeadWord, 4);
+		Head += 4;
+	}
+
+	/* The middle, less than 8 bytes */
+	while( Tail - Head > 1 )
+	{
+		Tail--;
+		Temp = *Head;
+		*Head = *Tail;
+		*Tail = Temp;
+		Head++;
+	}
+}
+
+
+
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+//Hex of 4 bytes (first one in the low byte) as 8 chars, first char in the low byte: each byte is spread to 16 bits,
+//its nibbles split into the 2 bytes, then every nibble becomes '0'..'9' or 'A'..'F' at once
+static uint64_t HexDump_Encode4(uint32_t Word)
+{
+	uint64_t Nibbles = Word;
+
+	Nibbles = (Nibbles | (Nibbles << 16)) & 0x0000FFFF0000FFFFull;
+	Nibbles = (Nibbles | (Nibbles << 8)) & 0x00FF00FF00FF00FFull;
+	Nibbles = ((Nibbles >> 4) & 0x000F000F000F000Full) | ((Nibbles & 0x000F000F000F000Full) << 8);
+
+	return Nibbles + 0x3030303030303030ull + (((Nibbles + 0x0606060606060606ull) >> 4) & 0x0101010101010101ull) * 7;
+}
+#endif
+
+int32_t RML_COMM_HexDump(const void* Data, uint32_t DataLen, char* ResultBuff, uint32_t ResultBuff_Size, char Separator)
+{
+	const uint8_t *Bytes = (const uint8_t*)Data;
+	uint32_t Len;
+	uint32_t i = 0;
+	char *Ptr = ResultBuff;
+
+	// check that there is somewhere to write to
+	if( ResultBuff_Size == 0 )
+	{
+		return -1;
+	}
+
+	Len = DataLen * 2 + ((Separator != '\0' && DataLen > 0) ? DataLen - 1 : 0);
+	if( DataLen > 0x3FFFFFFFu || Len >= ResultBuff_Size )
+	{
+		*ResultBuff = '\0';
+		return -1;
+	}
+
+	if( Separator == '\0' )
+	{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+		/* 4 bytes -> 8 chars per step */
+		for( ; DataLen - i >= 4; i += 4, Ptr += 8 )
+		{
+			uint32_t Word;
+			uint64_t Chars;
+
+			memcpy(&Word, &Bytes[i], 4);
+			Chars = HexDump_Encode4(Word);
+			memcpy(Ptr, &Chars, 8);
+		}
+#endif
+		for( ; i < DataLen; i++, Ptr += 2 )
+		{
+			memcpy(Ptr, &Hex_Pairs[Bytes[i] * 2], 2);
+		}
+	}
+	else
+	{
+		for( ; i < DataLen; i++ )
+		{
+			if( i != 0 )
+			{
+				*Ptr++ = Separator;
+			}
+			memcpy(Ptr, &Hex_Pairs[Bytes[i] * 2], 2);
+			Ptr += 2;
+		}
+	}
+
+	*Ptr = '\0';
+	return (int32_t)Len;
+}
+
+
+
+
+int32_t RML_COMM_ftoa(double Value, char* ResultBuff, uint32_t BuffSize, uint8_t Afterpoint)
+{
+	FloatParts_Struct Parts;
+
+	Float_Split(Value, Afterpoint, &Parts);
+	return Float_ToBuff(&Parts, ResultBuff, BuffSize);
+}
+
+
+
+
+int32_t RML_COMM_ftoaf(float Value, char* ResultBuff, uint32_t BuffSize, uint8_t Afterpoint)
+{
+	FloatParts_Struct Parts;
+
+	Floatf_Split(Value, Afterpoint, &Parts);
+	return Float_ToBuff(&Parts, ResultBuff, BuffSize);
+}
+
+
+
+/*********************************************
+ * String to number
+ *********************************************/
+//Value of a digit char in bases up to 36 (either case), 0xFF if it isn't one
+static uint8_t Atou_DigitVal(char Ch)
+{
+	uint8_t Code = (uint8_t)Ch;
+
+	if( (uint8_t)(Code - '0') <= 9 )
+	{
+		return Code - '0';
+	}
+	Code |= 0x20;					//Lower case, only letters can land in 'a'..'z'
+	if( (uint8_t)(Code - 'a') <= 'z' - 'a' )
+	{
+		return Code - 'a' + 10;
+	}
+	return 0xFF;
+}
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#define ATOU_SWAR_ENABLE
+
+//1 if the 8 chars (first one in the low byte) are all decimal digits: each high nibble must be 3 before and after adding 6
+static uint8_t Swar_IsDigits8(uint64_t Word)
+{
+	return ((Word & 0xF0F0F0F0F0F0F0F0ull) | (((Word + 0x0606060606060606ull) & 0xF0F0F0F0F0F0F0F0ull) >> 4)) == 0x3333333333333333ull;
+}
+
+//Value of 8 decimal digits, merged in pairs: 8 x 1 digit -> 4 x 2 digits -> 2 x 4 digits -> 8 digits
+static uint32_t Swar_Parse8(uint64_t Word)
+{
+	Word -= 0x3030303030303030ull;
+	Word = (Word * 10 + (Word >> 8)) & 0x00FF00FF00FF00FFull;
+	Word = (Word * 100 + (Word >> 16)) & 0x0000FFFF0000FFFFull;
+	return (uint32_t)(Word * 10000 + (Word >> 32));
+}
+#endif
+
+//Parses up to Len digits of Base, stopping at the first char that isn't one. A result above Limit is an overflow. Returns
+//the number of digits, 0 if there were none or -1 on overflow (*Value is only written on success)
+static int32_t Atou64_Core(const char *Str, uint32_t Len, uint8_t Base, uint64_t Limit, uint64_t *Value)
+{
+	uint64_t Acc = 0;
+	uint32_t Pos = 0;
+	uint8_t Digit;
+
+#ifdef ATOU_SWAR_ENABLE
+	/* Base 10: 8 digits per step while the input has them */
+	if( Base == 10 )
+	{
+		uint64_t Word;
+
+		while( Len - Pos >= 8 )
+		{
+			memcpy(&Word, &Str[Pos], 8);
+			if( !Swar_IsDigits8(Word) )
+			{
+				break;
+			}
+			if( __builtin_mul_overflow(Acc, 100000000u, &Acc) || __builtin_add_overflow(Acc, Swar_Parse8(Word), &Acc) )
+			{
+				return -1;
+			}
+			Pos += 8;
+		}
+	}
+#endif
+
+	/* One digit at a time for the rest (and other bases), the overflow checks need no division */
+	for( ; Pos < Len; Pos++ )
+	{
+		Digit = Atou_DigitVal(Str[Pos]);
+		if( Digit >= Base )
+		{
 			break;
+		}
+		if( __builtin_mul_overflow(Acc, Base, &Acc) || __builtin_add_overflow(Acc, Digit, &Acc) )
+		{
+			return -1;
+		}
 	}
 
-	/* Logger was init successfully */
-	Logger_InitDone = 1;
+	if( Acc > Limit )
+	{
+		return -1;
+	}
+	*Value = Acc;
+	return (int32_t)Pos;
+}
 
-	return 0;
+//Sign, base prefix and digits, shared by the integer parsers. Only '+' is accepted unless Signed. Returns the number
+//of chars used or -1
+static int32_t Atoi_Parse(const char *Str, uint32_t Len, uint8_t Base, uint8_t Signed, uint64_t Limit, uint64_t *Magnitude, 
+							uint8_t *Negative)
+{
+	uint32_t Pos = 0;
+	int32_t Digits;
+
+	*Negative = 0;
+	if( Str == NULL || Base < 2 || Base > 36 )
+	{
+		return -1;
+	}
+
+	if( Len > 0 && (Str[0] == '+' || (Signed && Str[0] == '-')) )
+	{
+		*Negative = (Str[0] == '-');
+		Pos++;
+	}
+
+	/* Base 16: optional "0x", only skipped if a digit follows so "0x" alone parses as 0 */
+	if( Base == 16 && Len - Pos > 2 && Str[Pos] == '0' && (Str[Pos + 1] | 0x20) == 'x' && Atou_DigitVal(Str[Pos + 2]) < 16 )
+	{
+		Pos += 2;
+	}
+
+	Digits = Atou64_Core(&Str[Pos], Len - Pos, Base, Limit + *Negative, Magnitude);		//The negative range is one bigger
+	if( Digits <= 0 )
+	{
+		return -1;
+	}
+	return (int32_t)Pos + Digits;
+}
+
+//Length of Word if Str starts with it (any case, Word is lower case), else 0
+static uint32_t Atof_Match(const char *Str, uint32_t Len, const char *Word)
+{
+	uint32_t i;
+
+	for( i = 0; Word[i] != '\0'; i++ )
+	{
+		if( i >= Len || (Str[i] | 0x20) != Word[i] )
+		{
+			return 0;
+		}
+	}
+	return i;
 }
 
 
 
 
-void RML_COMM_LogMsg(char *Src, uint8_t LogLvl, char* Msg, ... )
+int32_t RML_COMM_atou(const char* Str, uint32_t Len, uint8_t Base, uint32_t *Value)
 {
-	/* Error check: Makes sure the logger was initialized */
-	if(!Logger_InitDone)
+	uint64_t Magnitude;
+	uint8_t Negative;
+	int32_t Used = Atoi_Parse(Str, Len, Base, 0, 0xFFFFFFFFu, &Magnitude, &Negative);
+
+	if( Used > 0 )
 	{
-		return;
+		*Value = (uint32_t)Magnitude;
 	}
+	return Used;
+}
 
-	char *ColorStr = "";				//Used to color the log level string
 
 
-	/* Check if Log level is defined to be logged: */
-	uint8_t LogLvlUnknown = 0;			//Used to check if the Log level is defined or not
-	if(LogLvl == e_DEBUG)
-	{
-		if(LogLevelsEnable[0] == 0)
-		{
-			return;
-		}
 
-		/* Debug is cyan */
-		ColorStr = ANSI_CYAN;
-	}
-	else if(LogLvl == e_INFO)
-	{
-		if(LogLevelsEnable[1] == 0)
-		{
-			return;
-		}
+int32_t RML_COMM_atoi(const char* Str, uint32_t Len, uint8_t Base, int32_t *Value)
+{
+	uint64_t Magnitude;
+	uint8_t Negative;
+	int32_t Used = Atoi_Parse(Str, Len, Base, 1, 0x7FFFFFFFu, &Magnitude, &Negative);
 
-		/* Info is green */
-		ColorStr = ANSI_GREEN;
-	}
-	else if(LogLvl == e_WARNING)
+	if( Used > 0 )
 	{
-		if(LogLevelsEnable[2] == 0)
-		{
-			return;
-		}
-
-		/* Warning is yellow */
-		ColorStr = ANSI_YELLOW;
+		*Value = Negative ? (int32_t)(0u - (uint32_t)Magnitude) : (int32_t)Magnitude;
 	}
-	else if(LogLvl == e_ERROR)
-	{
-		if(LogLevelsEnable[3] == 0)
-		{
-			return;
-		}
+	return Used;
+}
 
-		/* Error is red */
-		ColorStr = ANSI_RED;
-	}
-	else if(LogLvl == e_FATAL)
-	{
-		if(LogLevelsEnable[4] == 0)
-		{
-			return;
-		}
 
-		/* Fatal is bold red */
-		ColorStr = ANSI_BOLDRED;
-	}
-	else
-	{
-		/* Log level is unknown */
-		LogLvlUnknown = 1;
-	}
 
-	#if defined(ESP32)
-	taskENTER_CRITICAL(&LogSpinlock);
-	#endif
 
-	/* The log message is sent by segments depending on
-	 * what needs to be sent or formatting */
-	PUTCHAR_N_FUNC ColorStr);					//Color string
-	PUTCHAR_N_FUNC "> [");
+int32_t RML_COMM_atou64(const char* Str, uint32_t Len, uint8_t Base, uint64_t *Value)
+{
+	uint8_t Negative;
 
-	/* Output log level: */
-	if( LogLvlUnknown )
-	{
-		PUTCHAR_N_FUNC "Unknown LogLvl?");
-	}
-	else
-	{
-		PUTCHAR_N_FUNC LogLevel_Str[LogLvl]);	//LogLevel
-	}
-	PUTCHAR_N_FUNC "] ");
-	
+	return Atoi_Parse(Str, Len, Base, 0, 0xFFFFFFFFFFFFFFFFull, Value, &Negative);
+}
 
-	/* Logs source of log (inception) */
-	PUTCHAR_N_FUNC Src);
-	PUTCHAR_N_FUNC ": ");
 
-	/* Logs message */
-	va_list VaList;							//Declare Variable-length argument list to store any additional args
-	va_start(VaList, Msg);					//Create a list for arguments given after 'Msg'
-	RML_COMM_vprintf(Msg, VaList);
-	va_end(VaList);							//Clean up the list
 
-	/* Newline */
-	PUTCHAR_N_FUNC ANSI_RESET);
-	PUTCHAR_N_FUNC "\r\n");
 
-	#if defined(ESP32)
-	taskEXIT_CRITICAL(&LogSpinlock);
-	#endif
+int32_t RML_COMM_atoi64(const char* Str, uint32_t Len, uint8_t Base, int64_t *Value)
+{
+	uint64_t Magnitude;
+	uint8_t Negative;
+	int32_t Used = Atoi_Parse(Str, Len, Base, 1, 0x7FFFFFFFFFFFFFFFull, &Magnitude, &Negative);
+
+	if( Used > 0 )
+	{
+		*Value = Negative ? (int64_t)(0u - Magnitude) : (int64_t)Magnitude;
+	}
+	return Used;
 }
 
 
 
-int8_t RML_COMM_LogLevelSet(uint8_t LogLvl, uint8_t Enable)
+
+int32_t RML_COMM_atof(const char* Str, uint32_t Len, double *Value)
 {
-	/* Error check: Makes sure the logger was initialized */
-	if(!Logger_InitDone)
+	uint64_t Mant = 0;
+	int32_t Exp10 = 0;
+	uint32_t Pos = 0;
+	uint8_t Negative = 0;
+	uint8_t HasDigits = 0;
+	uint8_t Digit;
+	double Result;
+
+	if( Str == NULL )
 	{
 		return -1;
 	}
 
-	/* Sanitize input just in case: */
-	if(Enable > 1)
+	if( Len > 0 && (Str[0] == '+' || Str[0] == '-') )
 	{
-		Enable = 1;
+		Negative = (Str[0] == '-');
+		Pos++;
 	}
-	
-	/* Check if Log level is defined to be logged: */
-	if(LogLvl == e_DEBUG)
+
+	/* What RML_COMM_ftoa() prints for the special values */
+	if( Atof_Match(&Str[Pos], Len - Pos, "inf") )
 	{
-		LogLevelsEnable[0] = Enable;
+		Pos += Atof_Match(&Str[Pos], Len - Pos, "infinity") ? 8 : 3;
+		*Value = Negative ? -INFINITY : INFINITY;
+		return (int32_t)Pos;
 	}
-	else if(LogLvl == e_INFO)
+	if( Atof_Match(&Str[Pos], Len - Pos, "nan") )
 	{
-		LogLevelsEnable[1] = Enable;
+		*Value = NAN;
+		return (int32_t)Pos + 3;
 	}
-	else if(LogLvl == e_WARNING)
+
+	/* Mantissa: the first 19 significant digits are kept, the ones after only move the exponent */
+	for( ; Pos < Len && (Digit = (uint8_t)(Str[Pos] - '0')) <= 9; Pos++ )
 	{
-		LogLevelsEnable[2] = Enable;
+		HasDigits = 1;
+		if( Mant < 1000000000000000000ull )
+		{
+			Mant = Mant * 10 + Digit;
+		}
+		else
+		{
+			Exp10++;
+		}
 	}
-	else if(LogLvl == e_ERROR)
+	if( Pos < Len && Str[Pos] == '.' )
 	{
-		LogLevelsEnable[3] = Enable;
+		for( Pos++; Pos < Len && (Digit = (uint8_t)(Str[Pos] - '0')) <= 9; Pos++ )
+		{
+			HasDigits = 1;
+			if( Mant < 1000000000000000000ull )
+			{
+				Mant = Mant * 10 + Digit;
+				Exp10--;
+			}
+		}
 	}
-	else if(LogLvl == e_FATAL)
+	if( !HasDigits )
 	{
-		LogLevelsEnable[4] = Enable;
+		return -1;
 	}
-	else
+
+	/* Exponent, only taken if it has digits ("2e" parses as 2 and leaves the 'e') */
+	if( Pos < Len && (Str[Pos] | 0x20) == 'e' )
 	{
-		/* Log level is unknown */
-		return -1;
+		uint32_t ExpPos = Pos + 1;
+		uint8_t ExpNegative = 0;
+		int32_t Exp = 0;
+
+		if( ExpPos < Len && (Str[ExpPos] == '+' || Str[ExpPos] == '-') )
+		{
+			ExpNegative = (Str[ExpPos] == '-');
+			ExpPos++;
+		}
+		if( ExpPos < Len && (uint8_t)(Str[ExpPos] - '0') <= 9 )
+		{
+			for( ; ExpPos < Len && (Digit = (uint8_t)(Str[ExpPos] - '0')) <= 9; ExpPos++ )
+			{
+				if( Exp < 100000 )			//Way past the double range, stops the int from overflowing
+				{
+					Exp = Exp * 10 + Digit;
+				}
+			}
+			Exp10 += ExpNegative ? -Exp : Exp;
+			Pos = ExpPos;
+		}
 	}
 
-	return 0;
+	/* Mant * 10^Exp10: both are exact for Mant < 2^53 and |Exp10| <= 22, so the result is correctly rounded there */
+	Result = (double)Mant;
+	if( Mant != 0 && Exp10 != 0 )
+	{
+		uint32_t AbsExp = (Exp10 < 0) ? (uint32_t)-Exp10 : (uint32_t)Exp10;
+		double Scale = 1.0;
+
+		if( Exp10 < 0 && AbsExp > 256 )
+		{
+			Result /= 1e256;			//In two steps so tiny (subnormal) results don't become 0 through an infinite Scale
+			AbsExp -= 256;
+		}
+
+		if( AbsExp > 511 )
+		{
+			Result = (Exp10 < 0) ? 0.0 : INFINITY;
+		}
+		else
+		{
+			for( uint8_t i = 0; AbsExp != 0; i++, AbsExp >>= 1 )
+			{
+				if( AbsExp & 1 )
+				{
+					Scale *= Pow10Bin_F64[i];
+				}
+			}
+			Result = (Exp10 < 0) ? (Result / Scale) : (Result * Scale);
+		}
+	}
+
+	*Value = Negative ? -Result : Result;
+	return (int32_t)Pos;
 }
 
 
 
+/*********************************************
+ * String builder
+ *********************************************/
+//Formatter output over the free part of a builder, Sb_OutEnd() takes the result back. An unusable builder (no 
+//buffer) gets a zero size output that only counts what it drops
+static void Sb_OutBegin(StrBuilder_Struct *Sb, FmtOut_Struct *Out)
+{
+	Out->Buff = Sb->Buff;
+	Out->Size = (Sb->Size == 0) ? 0 : Sb->Size - 1;		//Keep room for the null terminator
+	Out->Len = Sb->Len;
+	Out->ToTransport = 0;
+	Out->Truncated = 0;
+}
 
-void RML_COMM_printf( char * InputStr, ... )
+//Stores the formatter output back into the builder. Returns 0 if everything fit, -1 if something was dropped
+static int8_t Sb_OutEnd(StrBuilder_Struct *Sb, const FmtOut_Struct *Out)
 {
-	/* Error check: Makes sure the logger was initialized */
-	if(!Logger_InitDone)
+	Sb->Len = Out->Len;
+	Sb->Truncated += Out->Truncated;
+	if( Sb->Size != 0 )
 	{
-		return;
+		Sb->Buff[Sb->Len] = '\0';
 	}
 
-	va_list VaList;							//Declare Variable-length argument list to store any additional args
-	va_start(VaList, InputStr);				//Create a list for arguments given after 'InputStr'
+	return (Out->Truncated == 0) ? 0 : -1;
+}
 
-	RML_COMM_vprintf(InputStr, VaList);	//Call the vprintf function to handle the rest
+//Appends Len chars, what doesn't fit is dropped. Returns 0 if everything fit, -1 if not
+static int8_t Sb_PutN(StrBuilder_Struct *Sb, const char *Str, uint32_t Len)
+{
+	FmtOut_Struct Out;
 
-	va_end(VaList);							//Clean up the list
+	Sb_OutBegin(Sb, &Out);
+	Fmt_PutStrN(&Out, Str, Len);
+	return Sb_OutEnd(Sb, &Out);
 }
 
+void RML_COMM_SbInit(StrBuilder_Struct *Sb, char *Buff, uint32_t BuffSize)
+{
+	Sb->Buff = Buff;
+	Sb->Size = (Buff == NULL) ? 0 : BuffSize;
+	Sb->Len = 0;
+	Sb->Truncated = 0;
+	if( Sb->Size != 0 )
+	{
+		Buff[0] = '\0';
+	}
+}
 
 
 
-void RML_COMM_vprintf( char * InputStr, va_list VaList )
+void RML_COMM_SbReset(StrBuilder_Struct *Sb)
 {
-	/* Error check: Makes sure the logger was initialized */
-	if(!Logger_InitDone)
-	{
-		return;
-	}
-	
-	char *StringArg;			//Will be used to store any string args
-	char CharArg; 				//Will be used to store any char args
-	uint32_t UnsignedArg;		//Will be used to store any unsigned args
-	int32_t SignedArg;			//Will be used to store any signed args
-	char IntStr[20];			//Will be used to store any converted ints/floats/doubles
-	double DoubleArg; 			//Will be used to store any double args
-
-
-	/* Loop over the given string, check for '%' for formatting */
-	while(*InputStr)
-	{
-		/* If we got a format specifier: */
-		if(*InputStr == '%')
-		{
-			InputStr++;																			//Move to the next array element
-
-			switch(*InputStr)																	//Based on the specifier, decide what to do
-			{
-				//String
-				case 's':
-					StringArg = va_arg(VaList, char *);											//Get the arg, type string
-					PUTCHAR_N_FUNC StringArg);													//Print string
-					InputStr++;																	//Increment to remove the specifier from printing
-					break;
-
-				//Character
-				case 'c':
-					CharArg = va_arg(VaList, int);												//Get the arg, type char (va_arg() needs int for char)
-					PUTCHAR_FUNC CharArg);														//Print char
-					InputStr++;																	//Increment to remove the specifier from printing
-					break;
-
-				//Unsigned int
-				case 'u':
-					UnsignedArg = va_arg(VaList, uint32_t);										//Get the arg, type unsigned
-					RML_COMM_utoa(UnsignedArg, IntStr, sizeof(IntStr), 10);					//Convert unsigned int to ascii, base 10
-					PUTCHAR_N_FUNC IntStr);														//Print string
-					InputStr++;																	//Increment to remove the specifier from printing
-					break;
-
-				//Signed int
-				case 'i':
-				case 'd':
-					SignedArg = va_arg(VaList, int32_t);										//Get the arg, type signed
-					RML_COMM_itoa(SignedArg, IntStr, sizeof(IntStr), 10);						//Convert signed int to ascii, base 10
-					PUTCHAR_N_FUNC IntStr); 													//Print string
-					InputStr++;																	//Increment to remove the specifier from printing
-					break;
-
-				//User wants to print a '%'
-				case '%':
-					PUTCHAR_FUNC '%');															//Print char
-					InputStr++;																	//Increment to remove the specifier from printing
-					break;
-
-				//Hex value
-				case 'X':
-				case 'x':
-					UnsignedArg = va_arg(VaList, uint32_t);										//Get the arg, type unsigned
-					RML_COMM_utoa(UnsignedArg, IntStr, sizeof(IntStr), 16);					//Convert unsigned int to ascii, base 16
-					PUTCHAR_N_FUNC IntStr);														//Print string
-					InputStr++;
-					break;
-
-				//User wants to set the number of decimal places for the float/double 
-				case '.':
-					InputStr++;																	//Get the next value whoch should be between 1-6
-					//Check what value InputStr contains:
-					switch(*InputStr)
-					{
-						//1 decimal place
-						case '1':
-							DoubleArg = va_arg(VaList, double);									//Get the arg, type double
-							RML_COMM_ftoa(DoubleArg, IntStr, sizeof(IntStr), 1);				//Convert float/double to ascii, 1 decimal place
-							PUTCHAR_N_FUNC IntStr);												//Print string
-							InputStr = InputStr + 2;											//Increment to remove the 'f' specifier from printing
-							break;
-
-						//2 decimal places
-						case '2':
-							DoubleArg = va_arg(VaList, double);									//Get the arg, type double
-							RML_COMM_ftoa(DoubleArg, IntStr, sizeof(IntStr), 2);				//Convert float/double to ascii, 2 decimal places
-							PUTCHAR_N_FUNC IntStr);												//Print string
-							InputStr = InputStr + 2;											//Increment to remove the 'f' specifier from printing
-							break;
-
-						//3 decimal places
-						case '3':
-							DoubleArg = va_arg(VaList, double);									//Get the arg, type double
-							RML_COMM_ftoa(DoubleArg, IntStr, sizeof(IntStr), 3);				//Convert float/double to ascii, 3 decimal places
-							PUTCHAR_N_FUNC IntStr);												//Print string
-							InputStr = InputStr + 2;											//Increment to remove the 'f' specifier from printing
-							break;
-
-						//4 decimal places
-						case '4':
-							DoubleArg = va_arg(VaList, double);									//Get the arg, type double
-							RML_COMM_ftoa(DoubleArg, IntStr, sizeof(IntStr), 4);				//Convert float/double to ascii, 3 decimal places
-							PUTCHAR_N_FUNC IntStr);												//Print string
-							InputStr = InputStr + 2;											//Increment to remove the 'f' specifier from printing
-							break;
-
-						//5 decimal places
-						case '5':
-							DoubleArg = va_arg(VaList, double);									//Get the arg, type double
-							RML_COMM_ftoa(DoubleArg, IntStr, sizeof(IntStr), 5);				//Convert float/double to ascii, 3 decimal places
-							PUTCHAR_N_FUNC IntStr);												//Print string
-							InputStr = InputStr + 2;											//Increment to remove the 'f' specifier from printing
-							break;
-
-						//6 decimal places
-						case '6':
-							DoubleArg = va_arg(VaList, double);									//Get the arg, type double
-							RML_COMM_ftoa(DoubleArg, IntStr, sizeof(IntStr), 6);				//Convert float/double to ascii, 3 decimal places
-							PUTCHAR_N_FUNC IntStr);												//Print string
-							InputStr = InputStr + 2;											//Increment to remove the 'f' specifier from printing
-							break;
-
-						//Unknown specifier - just print it
-						default:
-							PUTCHAR_FUNC *InputStr);											//Print char
-							InputStr++;
-							break;
-					}
-					break;
+	RML_COMM_SbInit(Sb, Sb->Buff, Sb->Size);
+}
 
-				//Double/float value
-				case 'f':
-					DoubleArg = va_arg(VaList, double);											//Get the arg, type double
-					RML_COMM_ftoa(DoubleArg, IntStr, sizeof(IntStr), 2);						//Convert float/double to ascii, 2 decimal places by default
-					PUTCHAR_N_FUNC IntStr);														//Print string
-					InputStr++;
-					break;
 
-				//End of string reached
-				case '\0':
-					break;
 
-				//Unknown specifier - just print it in hopes of the user realizing that
-				default:
-					PUTCHAR_FUNC '%');															//Print char
-					PUTCHAR_FUNC *InputStr);													//Print char
-					InputStr++;
-			}
-		}
+int8_t RML_COMM_SbAddStr(StrBuilder_Struct *Sb, const char *Str)
+{
+	FmtOut_Struct Out;
 
-		/* Not a format specifier, print the char: */
-		else
-		{
-			PUTCHAR_FUNC *InputStr);															//Print char
-			InputStr++;																			//Move to next char in the string
-		}
-	}
+	Sb_OutBegin(Sb, &Out);
+	Fmt_PutStr(&Out, (Str != NULL) ? Str : "(null)");
+	return Sb_OutEnd(Sb, &Out);
 }
 
 
 
-
-int32_t RML_COMM_utoa(uint32_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+int8_t RML_COMM_SbAddStrN(StrBuilder_Struct *Sb, const char *Str, uint32_t Len)
 {
-	// check that the base if valid
-	if (Base < 2 || Base > 36) 
-	{
-		// if the base is invalid, return an empty string
-		*ResultBuff = '\0';
-		return -1;
-	}
-	
-	// initialize pointers to the start and end of the result string
-	char* ptr = ResultBuff, *ptr1 = ResultBuff;
-	
-	// store the input value for later use
-	uint32_t tmp_value;
-	
-	// do-while loop to repeatedly divide the value by the base and store the remainder as a character in the result string
-	do
-	{
-		tmp_value = Value;
-		Value /= Base;
-		
-		// lookup the character for the current remainder in the lookup table and store it in the result string
-		*ptr++ = "ZYXWVUTSRQPONMLKJIHGFEDCBA9876543210123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ" [35 + (tmp_value - Value * Base)];
-	} while ( Value );
-	
-	// check if the result buffer is large enough to hold the resulting string
-	if (ptr - ResultBuff >= ResultBuff_Size) 
-	{
-		// if the result buffer is too small, return an error
-		*ResultBuff = '\0';
-		return -1;
-	}
-	
-	// terminate the string
-	*ptr-- = '\0';
-	
-	// reverse the string
-	while(ptr1 < ptr)
-	{
-		char tmp_char = *ptr;
-		*ptr--= *ptr1;
-		*ptr1++ = tmp_char;
-	}
-	
-	// return the length of the string
-	return ptr - ResultBuff;
+	return Sb_PutN(Sb, Str, Len);
 }
 
 
 
+int8_t RML_COMM_SbAddChar(StrBuilder_Struct *Sb, char Ch)
+{
+	return Sb_PutN(Sb, &Ch, 1);
+}
+
+
 
-int32_t RML_COMM_itoa(int32_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base)
+int8_t RML_COMM_SbAddUint(StrBuilder_Struct *Sb, uint64_t Value)
 {
-	// check that the base if valid
-	if (Base < 2 || Base > 36) 
+	char IntStr[24];				//A 64-bit int is up to 20 digits
+	int32_t Len;
+
+	/* Room for any value: convert in place, else convert aside and keep what fits */
+	if( Sb->Size - Sb->Len > 20 )
 	{
-		// if the base is invalid, return an empty string
-		*ResultBuff = '\0';
-		return -1;
+		Sb->Len += Utoa64_Core(Value, &Sb->Buff[Sb->Len], Sb->Size - Sb->Len, 10);
+		return 0;
 	}
-	
-	// initialize pointers to the start and end of the result string
-	char* ptr = ResultBuff, *ptr1 = ResultBuff, tmp_char;
-	
-	// store the input value for later use
-	int32_t tmp_value, tmp_value2;
 
-	tmp_value2 = Value;
-	
-	// do-while loop to repeatedly divide the value by the base and store the remainder as a character in the result string
-	do 
-	{
-		tmp_value = Value;
-		Value /= Base;
-		
-		// lookup the character for the current remainder in the lookup table and store it in the result string
-		*ptr++ = "ZYXWVUTSRQPONMLKJIHGFEDCBA9876543210123456789ABCDEFGHIJKLMNOPQRSTUVWXYZ" [35 + (tmp_value - Value * Base)];
-	} while ( Value );
+	Len = Utoa64_Core(Value, IntStr, sizeof(IntStr), 10);
+	return Sb_PutN(Sb, IntStr, Len);
+}
+
 
-	// handle negative values
-	if (tmp_value2 < 0 && Base == 10)
+
+int8_t RML_COMM_SbAddInt(StrBuilder_Struct *Sb, int64_t Value)
+{
+	char IntStr[24];				//Sign and up to 19 digits
+	int32_t Len;
+
+	/* Room for any value: convert in place, else convert aside and keep what fits */
+	if( Sb->Size - Sb->Len > 21 )
 	{
-		// store the negative sign in the result string
-		*ptr++ = '-';
+		Sb->Len += RML_COMM_itoa64(Value, &Sb->Buff[Sb->Len], Sb->Size - Sb->Len, 10);
+		return 0;
 	}
-	
-	// check if the result buffer is large enough to hold the resulting string
-	if (ptr - ResultBuff >= ResultBuff_Size) 
+
+	Len = RML_COMM_itoa64(Value, IntStr, sizeof(IntStr), 10);
+	return Sb_PutN(Sb, IntStr, Len);
+}
+
+
+
+int8_t RML_COMM_SbAddHex(StrBuilder_Struct *Sb, uint64_t Value, uint8_t MinDigits)
+{
+	char HexStr[32] = "0000000000000000";	//Leading zeros, the digits are written after them
+	int32_t Len;
+
+	if( MinDigits > 16 )
 	{
-		// if the result buffer is too small, return an error
-		*ResultBuff = '\0';
-		return -1;
+		MinDigits = 16;
 	}
-	
-	// terminate the string
-	*ptr-- = '\0';
-	
-	// reverse the string
-	while (ptr1 < ptr) 
+
+	Len = Utoa64_Core(Value, &HexStr[16], sizeof(HexStr) - 16, 16);
+	if( Len < MinDigits )
 	{
-		tmp_char = *ptr;
-		*ptr--= *ptr1;
-		*ptr1++ = tmp_char;
+		return Sb_PutN(Sb, &HexStr[16 + Len - MinDigits], MinDigits);
 	}
-	
-	// return the length of the string
-	return ptr - ResultBuff;
+	return Sb_PutN(Sb, &HexStr[16], Len);
 }
 
 
 
-
-void RML_COMM_ReverseString(char* Str, uint32_t Length)
+int8_t RML_COMM_SbAddFloat(StrBuilder_Struct *Sb, double Value, uint8_t Afterpoint)
 {
-	uint32_t i, j;
-	char temp;
-	for (i = 0, j = Length - 1; i < j; i++, j--)
-	{
-		temp = Str[i];
-		Str[i] = Str[j];
-		Str[j] = temp;
-	}
-}
+	FmtSpec_Struct Spec = { 0, FMT_CONV_FLOAT, 'f', 0, 0, (int16_t)Afterpoint };
+	FmtOut_Struct Out;
 
+	/* Same engine as %f, so RML_PRINTF_FLOAT_SINGLE applies here too */
+	Sb_OutBegin(Sb, &Out);
+	Fmt_Float(&Out, &Spec, Value);
+	return Sb_OutEnd(Sb, &Out);
+}
 
 
 
-int32_t RML_COMM_ftoa(double Value, char* ResultBuff, uint32_t BuffSize, uint8_t Afterpoint)
+int8_t RML_COMM_SbAddFmt(StrBuilder_Struct *Sb, const char *Fmt, ... )
 {
-	int32_t WholePart = (int32_t)Value;
-	double FractionalPart = Value - WholePart;
-	uint32_t i = 0;
-	uint8_t NegativeFlag = 0;
-	
-	// Handle negative numbers
-	if( WholePart < 0 )
-	{
-		NegativeFlag = 1;
-		WholePart = -WholePart;
-		FractionalPart = -FractionalPart;
-	}
+	int8_t Result;
+	va_list VaList;							//Declare Variable-length argument list to store any additional args
 
-	// Convert whole part to string
-	do
-	{
-		if (i < BuffSize)
-		{
-			ResultBuff[i++] = WholePart % 10 + '0';
-		}
-		else
-		{
-			ResultBuff[0] = '\0';
-			return -1;
-		}
-		WholePart /= 10;
-	} while (WholePart > 0);
+	va_start(VaList, Fmt);					//Create a list for arguments given after 'Fmt'
+	Result = RML_COMM_SbAddVFmt(Sb, Fmt, VaList);
+	va_end(VaList);							//Clean up the list
 
-	if(NegativeFlag && i < BuffSize)
-	{
-		ResultBuff[i++] = '-';
-	}
+	return Result;
+}
 
-	// Reverse the string
-	RML_COMM_ReverseString(ResultBuff, i);
-	
-	
-	// if Afterpoint is non-zero, add a decimal point and the specified number of decimal places
-	if( Afterpoint > 0 )
-	{
-		if (i < BuffSize)
-		{
-			ResultBuff[i++] = '.';
-		}
-		else
-		{
-			// Buffer is full
-			ResultBuff[i] = '\0';
-			return -1;
-		}
-		
-		for( int32_t z = 0; z < Afterpoint; z++ )
-		{
-			FractionalPart *= 10;
-			int32_t digit = (int32_t)FractionalPart;
-			if (i < BuffSize)
-			{
-				ResultBuff[i++] = digit + '0';
-			}
-			else
-			{
-				ResultBuff[0] = '\0';
-				return -1;
-			}
-			FractionalPart -= digit;
-		}
-	}
-	
-	// Add null terminator
-	if (i + 1 > BuffSize)
-	{
-		ResultBuff[0] = '\0'; // Return empty string if buffer size is too small
-	}
-	else
-	{
-		ResultBuff[i] = '\0';
-	}
 
-	return i;
+
+int8_t RML_COMM_SbAddVFmt(StrBuilder_Struct *Sb, const char *Fmt, va_list VaList)
+{
+	FmtOut_Struct Out;
+
+	Sb_OutBegin(Sb, &Out);
+	Fmt_vformat(&Out, Fmt, VaList);
+	return Sb_OutEnd(Sb, &Out);
 }
 
 
@@ -739,6 +5620,12 @@ void _RML_COMM_Assert(const char* FileName, uint32_t LineNumber)
 	 * Assertion failed - Pause debugger and look at values
 	 */
 	RML_COMM_LogMsg("RML_ASSERT", e_FATAL, "ASSERTION FAILED:\r\n\t--> File: %s\r\n\t--> Line: %u", FileName, LineNumber);
+	#if defined(RML_LOG_CRASHLOG_ENABLE)
+	CrashLog_SetReason(e_CRASH_ASSERT);
+	#endif
+
+	/* Get the message out before halting, in async mode the drain task may never run again */
+	RML_COMM_LogFlush(RML_LOG_ASSERT_FLUSH_TIMEOUT_MS);
 	while(1);
 }
 
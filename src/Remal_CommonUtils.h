@@ -45,6 +45,9 @@ build_flags =
 #if defined(STM32H725xx) || defined(STM32H735xx)
 #include "cmsis_os.h"
 #include "semphr.h"
+#if defined(RML_LOG_STM32_DMA_ENABLE)
+#include "stm32h7xx_hal.h"
+#endif
 #endif
 
 /*********************************************
@@ -72,6 +75,176 @@ build_flags =
 #define RML_ASSERT(expr)		((void)0)
 #endif
 
+/**
+ * @brief These defines wrap RML_COMM_LogMsg() for each log level. Calls below the level set by the symbol 
+ * '-D' RML_LOG_MIN_LEVEL=X are compiled out completely: their arguments are never evaluated and their format
+ * strings never make it to flash. X uses the values of LogLevel_Enum (0 = DEBUG ... 4 = FATAL, 5 = all off),
+ * by default all levels are compiled in. RML_COMM_LogLevelSet() can still disable levels that were kept.
+ */
+#ifndef RML_LOG_MIN_LEVEL
+#define RML_LOG_MIN_LEVEL		0
+#endif
+#if RML_LOG_MIN_LEVEL > 0
+#pragma message("RML_LOG_xxx() calls below RML_LOG_MIN_LEVEL are compiled out")
+#endif
+
+#ifdef RML_LOG_PRECOMPILED_FORMATS
+#define _RML_LOG_EMIT(Src, LogLvl, Msg, ...)	RML_LOG_FAST(Src, LogLvl, Msg, ##__VA_ARGS__)
+#else
+#define _RML_LOG_EMIT(Src, LogLvl, Msg, ...)	RML_COMM_LogMsg(Src, LogLvl, Msg, ##__VA_ARGS__)
+#endif
+
+#if RML_LOG_MIN_LEVEL <= 0
+#define RML_LOG_DEBUG(Src, Msg, ...)		_RML_LOG_EMIT(Src, e_DEBUG, Msg, ##__VA_ARGS__)
+#else
+#define RML_LOG_DEBUG(Src, Msg, ...)		((void)0)
+#endif
+#if RML_LOG_MIN_LEVEL <= 1
+#define RML_LOG_INFO(Src, Msg, ...)			_RML_LOG_EMIT(Src, e_INFO, Msg, ##__VA_ARGS__)
+#else
+#define RML_LOG_INFO(Src, Msg, ...)			((void)0)
+#endif
+#if RML_LOG_MIN_LEVEL <= 2
+#define RML_LOG_WARNING(Src, Msg, ...)		_RML_LOG_EMIT(Src, e_WARNING, Msg, ##__VA_ARGS__)
+#else
+#define RML_LOG_WARNING(Src, Msg, ...)		((void)0)
+#endif
+#if RML_LOG_MIN_LEVEL <= 3
+#define RML_LOG_ERROR(Src, Msg, ...)		_RML_LOG_EMIT(Src, e_ERROR, Msg, ##__VA_ARGS__)
+#else
+#define RML_LOG_ERROR(Src, Msg, ...)		((void)0)
+#endif
+#if RML_LOG_MIN_LEVEL <= 4
+#define RML_LOG_FATAL(Src, Msg, ...)		_RML_LOG_EMIT(Src, e_FATAL, Msg, ##__VA_ARGS__)
+#else
+#define RML_LOG_FATAL(Src, Msg, ...)		((void)0)
+#endif
+
+/**
+ * @brief Logs a message for a registered module (see RML_COMM_LogModuleRegister()). The filter table is checked 
+ * before anything else, so the arguments are not even evaluated when the module or level is disabled.
+ */
+#define RML_LOG_MOD(Handle, LogLvl, Msg, ...)											\
+		do																				\
+		{																				\
+			if( RML_COMM_LogEnabled(Handle, LogLvl) )									\
+			{																			\
+				RML_COMM_LogModMsg(Handle, LogLvl, Msg, ##__VA_ARGS__);					\
+			}																			\
+		} while(0)
+
+/**
+ * @brief Per call site rate limits, checked before the arguments are even evaluated. RML_LOG_EVERY_N() logs the 1st,
+ * (N+1)th, (2N+1)th... call, RML_LOG_EVERY_MS() logs at most once every Period_ms (the calls in between are 
+ * dropped). Use them for messages inside fast loops, ex: RML_LOG_EVERY_MS(1000, "Sensor", e_ERROR, "read failed");
+ */
+#define RML_LOG_EVERY_N(N, Src, LogLvl, Msg, ...)										\
+		do																				\
+		{																				\
+			static uint32_t _RML_LogCount;												\
+			if( __atomic_fetch_add(&_RML_LogCount, 1, __ATOMIC_RELAXED) % (N) == 0 )	\
+			{																			\
+				RML_COMM_LogMsg(Src, LogLvl, Msg, ##__VA_ARGS__);						\
+			}																			\
+		} while(0)
+
+#define RML_LOG_EVERY_MS(Period_ms, Src, LogLvl, Msg, ...)								\
+		do																				\
+		{																				\
+			static uint32_t _RML_LogLast_ms;											\
+			if( RML_COMM_LogRateCheck(&_RML_LogLast_ms, Period_ms) )					\
+			{																			\
+				RML_COMM_LogMsg(Src, LogLvl, Msg, ##__VA_ARGS__);						\
+			}																			\
+		} while(0)
+
+/**
+ * @brief Symbol '-D' RML_LOG_COLLAPSE_REPEATS collapses runs of the same message: when a log call has the same format
+ * string, source and log level as the message just before it, it is dropped before any formatting and counted. The
+ * count is logged as "last message repeated N times" once a different message comes. While the run goes on, the
+ * count and one message (with its current values) are logged every RML_LOG_COLLAPSE_MAX_MS. Only the format is 
+ * compared, not the argument values.
+ */
+
+/**
+ * @brief The printf-style functions of this library are declared with the GCC format attribute, so mismatched args
+ * (ex: a double passed to %d) are reported at build time by -Wformat (part of -Wall). Symbol '-D' 
+ * RML_PRINTF_NO_FORMAT_CHECK turns it off. GCC checks against the standard printf() rules: on targets where 
+ * uint32_t is an unsigned long (ARM) print it with %lu or the PRIu32 macro from <inttypes.h>.
+ */
+#if defined(__GNUC__) && !defined(RML_PRINTF_NO_FORMAT_CHECK)
+#define RML_PRINTF_FORMAT_ATTR(FmtIdx, ArgIdx)		__attribute__((format(printf, FmtIdx, ArgIdx)))
+#else
+#define RML_PRINTF_FORMAT_ATTR(FmtIdx, ArgIdx)
+#endif
+
+/**
+ * @brief Logs a message whose format is parsed only once: the first call compiles Msg into literal spans and typed 
+ * arg slots (FmtProgram_Struct) kept in a static next to the call, every later call just walks them. Msg must be a 
+ * string literal. Formats with '*' widths or more than RML_PRINTF_MAX_ARGS specifiers are parsed on every call as 
+ * usual. Symbol '-D' RML_LOG_PRECOMPILED_FORMATS makes the RML_LOG_xxx() macros above use it, at the cost of 
+ * sizeof(FmtProgram_Struct) of RAM per call site.
+ */
+#define RML_LOG_FAST(Src, LogLvl, Msg, ...)												\
+		do																				\
+		{																				\
+			static FmtProgram_Struct _RML_FmtProgram;									\
+			RML_COMM_LogMsgCompiled(&_RML_FmtProgram, Src, LogLvl, Msg, ##__VA_ARGS__);	\
+		} while(0)
+
+/**
+ * @brief Symbol '-D' RML_LOG_TOKENIZED_ENABLE switches RML_COMM_LogMsg() to tokenized (binary) output: instead of 
+ * formatting text on the MCU, only the address of the format string, the log level, a timestamp and the raw 
+ * argument bytes are sent. Use extras/tools/rml_log_decode.py with the firmware ELF file to get the text back.
+ * The format string ('Msg') must be a string literal so it can be found in the ELF file.
+ */
+#ifdef RML_LOG_TOKENIZED_ENABLE
+#pragma message("RML_COMM_LogMsg() output is tokenized, use extras/tools/rml_log_decode.py to read it")
+#endif
+
+/**
+ * @brief Symbol '-D' RML_LOG_TIMESTAMP_ENABLE starts every log line with the time it was logged, in seconds with 
+ * microsecond resolution (ex: "> 12.345678 [INFO] Main: ..."). The time is taken inside the log call (not when the
+ * line reaches the transport, which matters in async mode) from the cheapest high resolution clock of the target:
+ * esp_timer_get_time() on ESP32, the DWT cycle counter on STM32 (started by RML_COMM_LoggerInit()) and 
+ * clock_gettime(CLOCK_MONOTONIC) on native. Symbol '-D' RML_LOG_SEQNUM_ENABLE adds a sequence number ("#42") that 
+ * increments with every message that passed the log level filters, so a gap shows where messages were dropped.
+ * Tokenized frames always carry the timestamp, and carry the sequence number when RML_LOG_SEQNUM_ENABLE is set.
+ */
+
+/**
+ * @brief Symbol '-D' RML_LOG_KV_BINARY makes RML_COMM_LogKV() send its fields as a CBOR map (RFC 8949) in a binary 
+ * frame instead of a text line, so the host reads typed values without parsing text and without the firmware ELF
+ * file. extras/tools/rml_log_decode.py prints them as text, or as JSON lines with --kv-json.
+ */
+
+/**
+ * @brief Profiling markers, compiled in with the symbol '-D' RML_PROFILE_ENABLE (else they compile to nothing). 
+ * RML_PROFILE_SCOPE() (C++) records a begin event where it is declared and the matching end event when the scope is
+ * left, RML_PROFILE_BEGIN()/RML_PROFILE_END() do the same by hand (C). Name must be a string literal, see
+ * RML_COMM_ProfileDump() to get the events out.
+ */
+#ifdef RML_PROFILE_ENABLE
+#define _RML_PROFILE_CAT2(a, b)					a##b
+#define _RML_PROFILE_CAT(a, b)					_RML_PROFILE_CAT2(a, b)
+#define RML_PROFILE_BEGIN(Name)					RML_COMM_ProfileEvent(Name, e_PROFILE_BEGIN)
+#define RML_PROFILE_END(Name)					RML_COMM_ProfileEvent(Name, e_PROFILE_END)
+#define RML_PROFILE_SCOPE(Name)					RML_ProfileScope_Struct _RML_PROFILE_CAT(_RML_ProfileScope, __LINE__)(Name)
+#else
+#define RML_PROFILE_BEGIN(Name)					((void)0)
+#define RML_PROFILE_END(Name)					((void)0)
+#define RML_PROFILE_SCOPE(Name)					((void)0)
+#endif
+
+/**
+ * @brief %f is formatted with the double precision engine by default. Symbol '-D' RML_PRINTF_FLOAT_SINGLE switches
+ * it to the single precision engine (see RML_COMM_ftoaf()) so cores with a float-only FPU never run software double
+ * math, values keep ~7 significant digits. This is the default on ESP32, '-D' RML_PRINTF_FLOAT_DOUBLE opts out.
+ */
+#if defined(ESP32) && !defined(RML_PRINTF_FLOAT_DOUBLE) && !defined(RML_PRINTF_FLOAT_SINGLE)
+#define RML_PRINTF_FLOAT_SINGLE
+#endif
+
 //Logging:
 #define ENABLE_COLOR_SUPPORT			0				//Enable or disable color support for the logger
 //ANSI text colors:
@@ -113,6 +286,115 @@ build_flags =
 #define ANSI_BOLDWHITE     	""
 #endif
 
+//Transport (see GenericUART_Struct.BaudRate):
+#ifndef RML_LOG_MAX_BAUDRATE
+#if defined(ESP32)
+#define RML_LOG_MAX_BAUDRATE				5000000			//Hardware UART limit, the native USB port ignores the baud rate
+#elif defined(STM32H725xx) || defined(STM32H735xx)
+#define RML_LOG_MAX_BAUDRATE				12500000		//USART limit (8x oversampling), HAL_UART_Init() still fails for rates the UART clock can't reach
+#else
+#define RML_LOG_MAX_BAUDRATE				0xFFFFFFFF		//Native: unused
+#endif
+#endif
+
+//Sync mode locking (see GenericUART_Struct.LockTimeout_ms):
+#ifndef RML_LOG_LOCK_DEFAULT_TIMEOUT_MS
+#define RML_LOG_LOCK_DEFAULT_TIMEOUT_MS		100				//Max time a task waits for another task's log line before dropping its own
+#endif
+
+//Pre-parsed formats (see RML_LOG_FAST()):
+#ifndef RML_PRINTF_MAX_ARGS
+#define RML_PRINTF_MAX_ARGS					8				//Max number of specifiers in a format compiled by RML_LOG_FAST()
+#endif
+
+//Repeat collapsing (add '-D' RML_LOG_COLLAPSE_REPEATS to use it):
+#ifndef RML_LOG_COLLAPSE_MAX_MS
+#define RML_LOG_COLLAPSE_MAX_MS				1000			//Max time repeats are held back before their count (and the next repeat) is logged
+#endif
+
+//Log modules (see RML_COMM_LogModuleRegister()):
+#ifndef RML_LOG_MAX_MODULES
+#define RML_LOG_MAX_MODULES					32				//Max number of registered log modules (up to 127)
+#endif
+
+//Output sinks (see RML_COMM_LogSinkAdd()):
+#ifndef RML_LOG_MAX_SINKS
+#define RML_LOG_MAX_SINKS					4				//Max number of output sinks, including the built-in transport
+#endif
+#define RML_LOG_SINK_TRANSPORT				0				//Handle of the built-in transport sink (UART, USB-CDC or stdout)
+
+//Crash log (add '-D' RML_LOG_CRASHLOG_ENABLE to use it, see RML_COMM_CrashLogRead()):
+#ifndef RML_LOG_CRASHLOG_SIZE
+#define RML_LOG_CRASHLOG_SIZE				2048			//Bytes of the log stream kept for the post-mortem, must be a power of 2
+#endif
+#ifndef RML_LOG_CRASHLOG_MIN_LEVEL
+#define RML_LOG_CRASHLOG_MIN_LEVEL			0				//Lowest log level copied into the crash log (LogLevel_Enum)
+#endif
+#ifndef RML_LOG_CRASHLOG_DUMP_ON_INIT
+#define RML_LOG_CRASHLOG_DUMP_ON_INIT		1				//1 to send what the previous boot logged to the sinks in RML_COMM_LoggerInit()
+#endif
+#ifndef RML_LOG_CRASHLOG_ATTR
+#if defined(ESP32)
+#define RML_LOG_CRASHLOG_ATTR				RTC_NOINIT_ATTR	//RTC slow memory, kept across resets and panics
+#elif defined(STM32H725xx) || defined(STM32H735xx)
+#define RML_LOG_CRASHLOG_ATTR				__attribute__((section(".noinit")))		//Your linker script must have this section (NOLOAD)
+#else
+#define RML_LOG_CRASHLOG_ATTR										//Native: nothing survives the process anyway
+#endif
+#endif
+
+//Profiling (add '-D' RML_PROFILE_ENABLE to use it, see RML_COMM_ProfileDump()):
+#ifndef RML_PROFILE_BUFF_EVENTS
+#define RML_PROFILE_BUFF_EVENTS				256				//Events kept per core (12 bytes each), the oldest are overwritten. Must be a power of 2
+#endif
+
+//Line buffering and async logging (see RML_COMM_LoggerInit()), all of these can be overridden with '-D' build symbols:
+#ifndef RML_LOG_LINE_MAX_SIZE
+#define RML_LOG_LINE_MAX_SIZE				256				//Max length of a single formatted log line (stack buffer), longer lines are truncated
+#endif
+#ifndef RML_LOG_ASYNC_DEFAULT_BUFF_SIZE
+#define RML_LOG_ASYNC_DEFAULT_BUFF_SIZE		4096			//Ring buffer size used when GenericUART_Struct.AsyncBuffSize is 0
+#endif
+#ifndef RML_LOG_ASYNC_DRAIN_PERIOD_MS
+#define RML_LOG_ASYNC_DRAIN_PERIOD_MS		10				//Max time the drain task/thread sleeps before checking the ring buffer again
+#endif
+#ifndef RML_LOG_ASYNC_WAKE_PERCENT
+#define RML_LOG_ASYNC_WAKE_PERCENT			25				//Ring buffer fill level (%) where a producer wakes the drain without waiting for its period
+#endif
+#ifndef RML_LOG_ASYNC_DRAIN_PRIORITY
+#define RML_LOG_ASYNC_DRAIN_PRIORITY		1				//FreeRTOS priority of the drain task (keep it low, it only moves bytes to the transport)
+#endif
+#ifndef RML_LOG_ASYNC_DRAIN_CORE
+#define RML_LOG_ASYNC_DRAIN_CORE			tskNO_AFFINITY	//ESP32 only: core the drain task is pinned to (0, 1 or tskNO_AFFINITY)
+#endif
+#ifndef RML_LOG_ASYNC_DRAIN_STACK_SIZE
+#define RML_LOG_ASYNC_DRAIN_STACK_SIZE		2048			//FreeRTOS stack size of the drain task (bytes on ESP32, words on STM32)
+#endif
+
+//Batches and flushing (see RML_COMM_LogBatchBegin() and RML_COMM_LogFlush()):
+#ifndef RML_LOG_BATCH_BUFF_SIZE
+#define RML_LOG_BATCH_BUFF_SIZE				1024			//Bytes a batch holds before it is sent early (allocated by the first batch), at least RML_LOG_LINE_MAX_SIZE
+#endif
+#ifndef RML_LOG_BATCH_MAX_LINES
+#define RML_LOG_BATCH_MAX_LINES				32				//Lines a batch holds before it is sent early
+#endif
+#ifndef RML_LOG_ASSERT_FLUSH_TIMEOUT_MS
+#define RML_LOG_ASSERT_FLUSH_TIMEOUT_MS		100				//Max time RML_ASSERT() waits for the log to reach the wire before halting
+#endif
+
+//Native (PC) output (see RML_COMM_LogFileSet()):
+#ifndef RML_LOG_NATIVE_BUFF_SIZE
+#define RML_LOG_NATIVE_BUFF_SIZE			16384			//Output collected before each writev(), a batch bigger than this goes out in several
+#endif
+
+//STM32 DMA transmit (add '-D' RML_LOG_STM32_DMA_ENABLE to use it, see RML_COMM_UART_TxCpltCallback()):
+#ifndef RML_LOG_DMA_BUFF_SIZE
+#define RML_LOG_DMA_BUFF_SIZE				512				//Size of each of the 2 DMA transmit buffers, keep it a multiple of 32 (cache line)
+#endif
+#ifndef RML_LOG_DMA_BUFF_ATTR
+#define RML_LOG_DMA_BUFF_ATTR				__attribute__((section(".RAM_D2"), aligned(32)))		//Places the DMA buffers in D2 SRAM, your linker script must have this section
+#endif
+
 
 /*********************************************
  * Structs
@@ -130,17 +412,137 @@ build_flags =
  */
 typedef struct
 {
-   	/** GPIO Pin of the RX */
+   	/** GPIO Pin of the RX. ESP32 hardware UART only (see Port), -1 keeps the UART's default pin. The STM32 pins are set by CubeMX */
 	int8_t RX_Pin;
 
-	/** GPIO Pin of the TX */
+	/** GPIO Pin of the TX. ESP32 hardware UART only (see Port), -1 keeps the UART's default pin. The STM32 pins are set by CubeMX */
 	int8_t TX_Pin;
 
-	/** UART Baud Rate */
+	/** UART Baud Rate, up to RML_LOG_MAX_BAUDRATE. On STM32 the UART is re-initialized when it differs from the CubeMX setting */
 	uint32_t BaudRate;
+
+	/** Logger mode, use LogMode_Enum. Left at 0 it defaults to e_LOG_MODE_SYNC */
+	uint8_t LogMode;
+
+	/** Async mode only: size of the ring buffer in bytes (rounded up to a power of 2), 0 uses RML_LOG_ASYNC_DEFAULT_BUFF_SIZE.
+	 *  On dual-core ESP32 it is split between the 2 per-core rings */
+	uint32_t AsyncBuffSize;
+
+	/** Async mode only: what to do with a new message when the ring buffer is full, use LogOverflow_Enum */
+	uint8_t AsyncOverflowPolicy;
+
+	/** Sync mode only: max time (ms) a task waits for the logger before its message is dropped, 0 uses RML_LOG_LOCK_DEFAULT_TIMEOUT_MS */
+	uint32_t LockTimeout_ms;
+
+	/** ESP32 only: where the log goes, use LogPort_Enum. Left at 0 it is the native USB port (Serial) */
+	uint8_t Port;
+
+	/** ESP32 hardware UART only: bytes the UART driver buffers so writes return before the FIFO took them, 0 keeps the 
+	 *  driver default (writes wait for room in the FIFO) */
+	uint16_t TxBuffSize;
+
+	/** STM32 only: UART_HandleTypeDef of the UART to log to (ex: &huart2), set up by CubeMX. NULL uses huart1 on the H725 
+	 *  and huart3 on the H735 */
+	void *UART_Handle;
+
+	/** STM32 only: when the TX FIFO asks for more data, use LogTxFifo_Enum. Left at 0 the FIFO is kept as CubeMX set it */
+	uint8_t TxFifoThreshold;
 } GenericUART_Struct;
 
 
+/**
+ * @brief Output sink structure, see RML_COMM_LogSinkAdd().
+ *
+ * A sink receives every finished log line (or tokenized frame) with a single Write() call, so it can
+ * keep its own buffer (a DMA buffer, a UDP packet, a flash page...) and send it out in Flush(). The
+ * callbacks are never called from an interrupt, and never by two tasks at once: in sync mode they run in 
+ * the logging task, under the logger lock. In async mode they run under the drain lock, in the drain 
+ * task/thread or in whichever task sends a batch (RML_COMM_LogBatchEnd()) or calls RML_COMM_LogFlush(), 
+ * so they may be called from different tasks one after the other and use that task's stack.
+ */
+typedef struct
+{
+	/** Called with a whole line, Buff is not null terminated. Keep it short, it delays the other sinks */
+	void (*Write)(const char *Buff, uint32_t Len, void *Ctx);
+
+	/** Optional (NULL if not needed): called at the end of each batch of writes (after every sync mode line, or once the async ring buffer is empty) */
+	void (*Flush)(void *Ctx);
+
+	/** Passed as is to Write() and Flush(), so the same callbacks can serve multiple instances */
+	void *Ctx;
+
+	/** Lowest log level sent to this sink (e_DEBUG ... e_FATAL), e_FATAL + 1 disables it. RML_COMM_printf() output goes to every enabled sink */
+	uint8_t MinLogLvl;
+} LogSink_Struct;
+
+
+/**
+ * @brief Format specifier:
+ * One parsed %[flags][width][.precision][length]conversion. Used internally by the formatter and
+ * stored in FmtProgram_Struct, you shouldn't need to touch its fields.
+ */
+typedef struct
+{
+	uint8_t Flags;					//FMT_FLAG_xxx
+	uint8_t Conv;					//FMT_CONV_xxx, index into the conversion handlers table
+	char Char;						//The conversion char itself ('\0' if the string ended)
+	char Length;					//Length modifier: 0, 'h', 'H' (hh), 'l', 'L' (ll) or 'z'
+	uint16_t Width;					//Min field width, 0 if not given
+	int16_t Precision;				//-1 if not given
+} FmtSpec_Struct;
+
+
+/**
+ * @brief Compiled format:
+ * A format string split into literal spans and typed arg slots, see RML_LOG_FAST() which declares
+ * one per call site. Zero-initialized means not compiled yet.
+ */
+typedef struct
+{
+	uint16_t LitPos[RML_PRINTF_MAX_ARGS + 1];		//Offset in the format of the literal span before each slot (the last one is the tail)
+	uint16_t LitLen[RML_PRINTF_MAX_ARGS + 1];		//Length of each literal span
+	FmtSpec_Struct Spec[RML_PRINTF_MAX_ARGS];		//Arg slots
+	uint8_t Count;									//Number of arg slots
+	uint8_t State;									//Compile state, 0 until the first call
+} FmtProgram_Struct;
+
+
+/**
+ * @brief String builder:
+ * Appends into a caller provided buffer, see RML_COMM_SbInit(). The string is always null terminated and
+ * whatever doesn't fit is dropped and counted, nothing is ever allocated.
+ */
+typedef struct
+{
+	char *Buff;						//Caller provided buffer
+	uint32_t Size;					//Size of Buff, including the null terminator
+	uint32_t Len;					//String length so far
+	uint32_t Truncated;				//Chars dropped because the buffer was full
+} StrBuilder_Struct;
+
+
+/**
+ * @brief Logger statistics:
+ * Filled in by RML_COMM_LogGetStats(), counted since the logger was initialized or the last reset. The counters
+ * are 32 bits and wrap, read them with Reset set at a regular interval to get rates.
+ */
+#define RML_LOG_STATS_LEVELS			6				//e_DEBUG ... e_FATAL, then RML_COMM_printf() output and unknown levels
+typedef struct
+{
+	uint32_t Lines[RML_LOG_STATS_LEVELS];			//Lines logged per level, including the ones dropped later on
+	uint32_t Bytes[RML_LOG_STATS_LEVELS];			//Bytes of those lines, as formatted (or tokenized)
+	uint32_t ModuleLines[RML_LOG_MAX_MODULES];		//Lines logged per module handle (RML_COMM_LogModMsg())
+	uint32_t Filtered;								//Messages below the enabled log levels (global or module)
+	uint32_t Suppressed;							//Messages dropped by a module rate limit or collapsed as repeats
+	uint32_t Dropped;								//Messages lost, same causes as RML_COMM_LogDroppedGet()
+	uint32_t TxCalls;								//Writes and flushes of the built-in transport
+	uint32_t TxMax_us;								//Longest of those calls
+	uint32_t TxAvg_us;								//Their average
+	uint32_t TxTotal_us;							//Time spent in them altogether
+	uint8_t BuffPeak;								//Highest async ring buffer fill level seen, in percent (0 in sync mode)
+} LogStats_Struct;
+
+
 /*********************************************
  * Enums
  *********************************************/
@@ -158,6 +560,82 @@ typedef enum
 } LogLevel_Enum;
 
 
+/**
+ * @brief Crash Reason enum:
+ * Why the previous boot went down, see RML_COMM_CrashLogReason()
+ */
+typedef enum
+{
+	e_CRASH_NONE = 0,					//Nothing was recorded: power cycle, reset or a crash that didn't log (watchdog, hard fault...)
+	e_CRASH_FATAL = 1,					//An e_FATAL message was logged
+	e_CRASH_ASSERT = 2					//An RML_ASSERT() failed
+} CrashReason_Enum;
+
+
+/**
+ * @brief Profile Event enum:
+ * Type of a profiling event, see RML_COMM_ProfileEvent()
+ */
+typedef enum
+{
+	e_PROFILE_BEGIN = 0,				//A measured section starts
+	e_PROFILE_END = 1					//The last section started with the same name ends
+} ProfileEvent_Enum;
+
+
+/**
+ * @brief Log Mode enum:
+ * Used to select how log messages reach the transport
+ */
+typedef enum
+{
+	e_LOG_MODE_SYNC = 0,				//Messages are written to the transport by the caller, the call returns once the message was sent
+	e_LOG_MODE_ASYNC = 1				//Messages are formatted into a ring buffer and sent by a background drain task/thread
+} LogMode_Enum;
+
+
+/**
+ * @brief Log Overflow enum:
+ * Used to select what happens when the async ring buffer is full
+ */
+typedef enum
+{
+	e_OVERFLOW_DROP_NEW = 0,			//The new message is dropped (default, never blocks)
+	e_OVERFLOW_DROP_OLD = 1,			//The oldest messages in the ring buffer are dropped to make room
+	e_OVERFLOW_BLOCK = 2				//The caller waits until the drain made room (only use from tasks, never from an ISR)
+} LogOverflow_Enum;
+
+
+/**
+ * @brief Log Port enum:
+ * ESP32 only: used to select where the log goes (GenericUART_Struct.Port)
+ */
+typedef enum
+{
+	e_LOG_PORT_USB = 0,					//Native USB port (Serial), default
+	e_LOG_PORT_UART0 = 1,				//Hardware UART 0
+	e_LOG_PORT_UART1 = 2,				//Hardware UART 1
+	e_LOG_PORT_UART2 = 3				//Hardware UART 2 (not on every ESP32 variant)
+} LogPort_Enum;
+
+
+/**
+ * @brief Log TX FIFO enum:
+ * STM32 only: used to select how empty the UART TX FIFO gets before it asks for more data (GenericUART_Struct.TxFifoThreshold)
+ */
+typedef enum
+{
+	e_TXFIFO_KEEP = 0,					//Left as CubeMX set it, default
+	e_TXFIFO_OFF = 1,					//FIFO disabled, one byte at a time
+	e_TXFIFO_1_8 = 2,					//FIFO enabled, refilled once 1/8 of it is free
+	e_TXFIFO_1_4 = 3,
+	e_TXFIFO_1_2 = 4,
+	e_TXFIFO_3_4 = 5,
+	e_TXFIFO_7_8 = 6,
+	e_TXFIFO_EMPTY = 7					//FIFO enabled, refilled once it is empty
+} LogTxFifo_Enum;
+
+
 
 
 
@@ -174,7 +652,9 @@ typedef enum
  * 				- 1 stop bit
  *
  * @note	If you're using Shabakah v3.x or higher (ESP32), this function will default to using the native USB
- * 			port for logging. In the future we plan on having custom pin selection.
+ * 			port for logging. Set UARTComm->Port to log to a hardware UART instead, on the pins given by 
+ * 			UARTComm->RX_Pin / UARTComm->TX_Pin, at up to RML_LOG_MAX_BAUDRATE. Give it a UARTComm->TxBuffSize so
+ * 			writes at high baud rates don't wait for the 128 byte FIFO.
  * 
  * 			Also note when using PlatformIO, the following must be added to the platformio.ini file:
  * 				build_flags = 
@@ -183,9 +663,26 @@ typedef enum
  * 			This allows the ESP32 to use the USB port as a serial port, which this library uses for logging.
  *   
  * @note	If you're using this library on a STM32xx, it assumes you already have a UART instance initialized
- * 			through the CubeMX code generator. Make sure to define and fill in the UARTComm struct with the correct
- * 			settings. Additionally, check the function itself and see what UART instance it is using and pins so it
- * 			matches your IOC file.
+ * 			through the CubeMX code generator: huart1 on the H725 and huart3 on the H735, or the one given in 
+ * 			UARTComm->UART_Handle. If UARTComm->BaudRate differs from its CubeMX setting the UART is re-initialized
+ * 			at the new rate, with 8x oversampling if 16x can't reach it (several Mbaud). UARTComm->TxFifoThreshold 
+ * 			turns on the 16 byte TX FIFO, with the DMA (RML_LOG_STM32_DMA_ENABLE) it keeps the line busy at high rates.
+ * 
+ * @note	On ESP32 and STM32 sync mode writes are serialized with a FreeRTOS mutex so lines from different tasks 
+ * 			never interleave, and interrupts stay enabled while the UART/USB write is in progress. A task waits at 
+ * 			most UARTComm->LockTimeout_ms for the mutex, past that its message is dropped and counted (see 
+ * 			RML_COMM_LogDroppedGet()). For the lowest latency use async mode: formatting happens on the caller's stack
+ * 			outside any lock, queuing is lock-free and the USB-CDC write is done by the low priority drain task
+ * 			(pin it with RML_LOG_ASYNC_DRAIN_CORE to keep it away from the Wi-Fi core). On dual-core ESP32 each core
+ * 			queues into its own ring buffer so the two cores never contend, the drain merges them in the order the
+ * 			messages were logged.
+ * 
+ * @note	Setting UARTComm->LogMode to e_LOG_MODE_ASYNC makes RML_COMM_LogMsg() and RML_COMM_printf() format
+ * 			into a lock-free ring buffer and return immediately. A drain task (FreeRTOS on ESP32/STM32) or a
+ * 			thread (native, POSIX threads) then moves the data to the transport. The ring buffer is allocated 
+ * 			once here and its size/overflow policy are taken from UARTComm->AsyncBuffSize and 
+ * 			UARTComm->AsyncOverflowPolicy. On STM32 and ESP32 the FreeRTOS scheduler must be running for the
+ * 			drain task to send anything. Async mode can't be changed once started.
  * 
  * 
  * @param[in] UARTComm
@@ -207,6 +704,12 @@ int8_t RML_COMM_LoggerInit(GenericUART_Struct *UARTComm);
  * 				- No additional args: RML_COMM_LogMsg("Main", e_INFO, "This is a test log message");
  * 				- With args: RML_COMM_LogMsg("Main", e_INFO, "Loop number - %u. Text to log %s", UnsignedNum, TempStr); <-- Similar to printf()!
  *
+ * @note	The whole line is formatted into a RML_LOG_LINE_MAX_SIZE stack buffer and sent with a single transport 
+ * 			write, longer lines are truncated.
+ * 
+ * @note	If symbol '-D' RML_LOG_TOKENIZED_ENABLE is added, nothing is formatted on the MCU: a binary frame is sent
+ * 			instead and decoded on the host by extras/tools/rml_log_decode.py (Msg must be a string literal).
+ *
  *
  * @param[in] Src
  * 			Source of the log (ex: function name)
@@ -228,100 +731,728 @@ int8_t RML_COMM_LoggerInit(GenericUART_Struct *UARTComm);
  * @return
  *          None
  ************************************************************************************************************************/
-void RML_COMM_LogMsg(char *Src, uint8_t LogLvl, char* Msg, ... );
+void RML_COMM_LogMsg(char *Src, uint8_t LogLvl, char* Msg, ... ) RML_PRINTF_FORMAT_ATTR(3, 4);
 
 
 
 /************************************************************************************************************************
- * @brief	Enables or disables a certain log level. By default, all log levels are enabled.
+ * @brief	Same as RML_COMM_LogMsg() but safe to call from an interrupt, it never blocks. In async mode the line is
+ * 			queued into the ring buffer (dropped if it is full, whatever the overflow policy) and the drain task is 
+ * 			woken up. In sync mode there is no way to send without waiting for the UART, so the message is dropped
+ * 			and counted (see RML_COMM_LogDroppedGet()).
+ * 
+ * @note	The line is formatted on the interrupt stack (RML_LOG_LINE_MAX_SIZE bytes), make sure it is big enough.
+ *
  *
+ * @param[in] Src
+ * 			Source of the log (ex: function name)
  *
  * @param[in] LogLvl
- * 			Log level to enable or disable, use the enums defined in this file:
- * 				- e_DEBUG
- * 				- e_INFO
- * 				- e_WARNING
- * 				- e_ERROR
- * 				- e_FATAL
- * 
- * @param[in] Enable
- * 			Enable or disable the log level. 1 to enable, 0 to disable
+ * 			Log level of the message
+ *
+ * @param[in] Msg
+ * 			Message to output in the log
+ *
+ * @param[in] ...
+ * 			Any additional arguments
  *
  * @return
- * 			0 on success, -1 if invalid log level
+ *          None
  ************************************************************************************************************************/
-int8_t RML_COMM_LogLevelSet(uint8_t LogLvl, uint8_t Enable);
+void RML_COMM_LogMsgFromISR(char *Src, uint8_t LogLvl, char* Msg, ... ) RML_PRINTF_FORMAT_ATTR(3, 4);
 
 
 
-/*################################################################################################################################
-  #													<!-- printf functions -->
-  ################################################################################################################################*/
 /************************************************************************************************************************
- * @brief	Extremely lightweight implementation of printf() for embedded systems. Prints output to UART. In case this 
- * 			was run on a system that isn't supported, routes output to stdout via printf(). This function calls 
- * 			RML_COMM_vprintf() to do the actual printing
+ * @brief	Same as RML_COMM_LogMsg() but with a format compiled once into Prog (literal spans and typed arg slots), so
+ * 			later calls skip parsing Msg. Use the RML_LOG_FAST() macro instead of calling this directly, it declares
+ * 			the static FmtProgram_Struct for you.
  * 
- * 			Currently supports the following specifiers:
- * 				- %s => String
- * 				- %c => Character
- * 				- %u => Unsigned integer
- * 				- %d or %i => Signed integer
- * 				- %% => To print a '%'
- * 				- %X or %x => Hex value
- * 				- %f => Float/Double, default precision is 2 decimal places
- * 				- %.Xf => Float/Double, where X is the number of decimal places (up to 6 decimal places)
+ * 			Example usage:
+ * 				- RML_LOG_FAST("Main", e_INFO, "Loop number - %u. Temp %.1f", LoopNum, Temp);
  * 
- * 			Why this was created? Mainly for 2 reasons:
- * 				1- printf() has a lot of code overhead and not recommend on embedded systems (that is assuming it
- * 				   even is supported and works)
- * 				2- I usually have no idea how printf() is handled on different systems and I cant really manipulate
- * 		 		   where the output goes on embedded systems easily, so this makes it extremely easy for me to route
- * 				   my output wherever (in my case, UART for logging stuff)
+ * @note	Prog must always be used with the same Msg (a string literal). The first call compiles it, if other tasks 
+ * 			log through the same call site meanwhile they parse Msg as usual.
  *
  *
- * @param[in] InputStr
- * 			String with desired format specifiers
+ * @param[in,out] Prog
+ * 			Compiled format of this call site, zero-initialized before the first call
+ *
+ * @param[in] Src
+ * 			Source of the log (ex: function name)
+ *
+ * @param[in] LogLvl
+ * 			Log level of the message
+ *
+ * @param[in] Msg
+ * 			Message to output in the log
  *
  * @param[in] ...
  * 			Any additional arguments
  *
  * @return
- * 			None
+ *          None
  ************************************************************************************************************************/
-void RML_COMM_printf( char * InputStr, ... );
+void RML_COMM_LogMsgCompiled(FmtProgram_Struct *Prog, char *Src, uint8_t LogLvl, char* Msg, ... ) RML_PRINTF_FORMAT_ATTR(4, 5);
 
 
 
 /************************************************************************************************************************
- * @brief	Extremely lightweight implementation of vprintf() for embedded systems. Prints output to UART. In case this 
- * 			was run on a system that isn't supported, routes output to stdout via printf(). Use RML_COMM_printf() unless 
- * 			you know what you are doing.
- * 
- * 			Currently supports the following specifiers:
- * 				- %s => String
- * 				- %c => Character
- * 				- %u => Unsigned integer
- * 				- %d or %i => Signed integer
- * 				- %% => To print a '%'
- * 				- %X or %x => Hex value
- * 				- %f => Float/Double, default precision is 2 decimal places
- * 				- %.Xf => Float/Double, where X is the number of decimal places (up to 6 decimal places)
- *
- * @note	Base code was gotten from: https://www.youtube.com/watch?v=Y9kUWsyyChk. Thanks to him for the explanation 
- * 			and simplified logic!
+ * @brief	Logs typed key/value fields instead of free-form text. Fields is a list of key=value pairs separated by 
+ * 			spaces, each value being one printf specifier (or literal text), so the args are checked at build time
+ * 			like any printf-style call.
  * 
- *
- * @param[in] InputStr
- * 			String with desired format specifiers
+ * 			Example usage:
+ * 				- RML_COMM_LogKV("Motor", e_INFO, "temp=%.1f rpm=%u state=%s", Temp, Rpm, StateStr);
  * 
- * @param[in] VaList
- * 			List of arguments
+ * 			By default the pairs are rendered as text, same as RML_COMM_LogMsg() ("> [INFO] Motor: temp=21.5 rpm=3200 
+ * 			state=RUN"). With the symbol '-D' RML_LOG_KV_BINARY a binary frame holding a CBOR map is sent instead:
+ * 			numbers keep their type and are never converted to text on the MCU.
+ * 
+ * @note	Binary frame layout (see extras/tools/rml_log_decode.py):
+ * 				[0xA7] [PayloadLen] [CBOR map] [Checksum]
+ * 			The map holds 0: log level, 1: timestamp in us, 2: Src and 3: sequence number (with RML_LOG_SEQNUM_ENABLE)
+ * 			followed by one text key per field. %d/%i are sent as integers, %u/%x/%p as unsigned integers, %f as a 
+ * 			float (or a double when a float would lose precision), %s/%c as text. Widths and precisions only apply 
+ * 			to the text rendering. Fields that don't fit in the 255 bytes payload are left out.
+ *
+ *
+ * @param[in] Src
+ * 			Source of the log (ex: function name)
+ *
+ * @param[in] LogLvl
+ * 			Log level of the message
+ *
+ * @param[in] Fields
+ * 			key=value pairs, ex: "temp=%.1f rpm=%u"
+ *
+ * @param[in] ...
+ * 			One argument per specifier in Fields
+ *
+ * @return
+ *          None
+ ************************************************************************************************************************/
+void RML_COMM_LogKV(char *Src, uint8_t LogLvl, char* Fields, ... ) RML_PRINTF_FORMAT_ATTR(3, 4);
+
+
+
+/************************************************************************************************************************
+ * @brief	Logs a binary buffer as a hex dump: a "<Len> bytes:" line, then one line per 16 bytes with the offset, the 
+ * 			bytes in hex and the printable ones as ASCII, like hexdump -C:
+ * 				> [DEBUG] CAN: 20 bytes:
+ * 				> [DEBUG] CAN: 0000  48 65 6C 6C 6F 2C 20 43  41 4E 00 01 02 03 04 05  |Hello, CAN......|
+ * 				> [DEBUG] CAN: 0010  06 07 08 09                                       |....|
+ * 
+ * 			Each row is a normal log line (level filter, sinks, timestamps...), built with a lookup table instead of 
+ * 			a printf call per byte. The rows are sent as one batch (see RML_COMM_LogBatchBegin()) so other tasks can't
+ * 			log in the middle of a dump.
+ *
+ *
+ * @param[in] Src
+ * 			Source of the log (ex: function name)
+ *
+ * @param[in] LogLvl
+ * 			Log level of the dump
+ *
+ * @param[in] Data
+ * 			Bytes to dump
+ *
+ * @param[in] Len
+ * 			Number of bytes in Data. Offsets get 8 digits for dumps over 64 KB
+ *
+ * @return
+ *          None
+ ************************************************************************************************************************/
+void RML_COMM_LogHex(char *Src, uint8_t LogLvl, const void *Data, uint32_t Len);
+
+
+
+/************************************************************************************************************************
+ * @brief	Enables or disables a certain log level. By default, all log levels are enabled.
+ *
+ *
+ * @param[in] LogLvl
+ * 			Log level to enable or disable, use the enums defined in this file:
+ * 				- e_DEBUG
+ * 				- e_INFO
+ * 				- e_WARNING
+ * 				- e_ERROR
+ * 				- e_FATAL
+ * 
+ * @param[in] Enable
+ * 			Enable or disable the log level. 1 to enable, 0 to disable
+ *
+ * @return
+ * 			0 on success, -1 if invalid log level
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogLevelSet(uint8_t LogLvl, uint8_t Enable);
+
+
+
+/************************************************************************************************************************
+ * @brief	Registers a log module (a subsystem that logs with its own name) and returns a small integer handle for 
+ * 			it. Each module has its own set of enabled log levels on top of the global ones from 
+ * 			RML_COMM_LogLevelSet(), checked with a single atomic load before any formatting is done. Registering 
+ * 			the same name twice returns the same handle. Call this at init, not from multiple tasks at once.
+ * 
+ * 			Example usage:
+ * 				- static int8_t MotorLog = RML_COMM_LogModuleRegister("Motor");
+ * 				- RML_COMM_LogModuleLevelSet(MotorLog, e_WARNING);
+ * 				- RML_LOG_MOD(MotorLog, e_DEBUG, "rpm %u", Rpm);		<-- Dropped before Rpm is even read
+ *
+ *
+ * @param[in] Name
+ * 			Name of the module, used as the log source. Must stay valid forever (use a string literal)
+ *
+ * @return
+ * 			The module handle on success, -1 if Name is NULL or the table is full (RML_LOG_MAX_MODULES)
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogModuleRegister(const char *Name);
+
+
+
+/************************************************************************************************************************
+ * @brief	Sets the lowest log level a module logs, everything below it is filtered out. By default a new module
+ * 			logs all levels.
+ *
+ *
+ * @param[in] Handle
+ * 			Handle returned by RML_COMM_LogModuleRegister()
+ *
+ * @param[in] MinLogLvl
+ * 			Lowest log level to log (e_DEBUG ... e_FATAL), e_FATAL + 1 disables the module completely
+ *
+ * @return
+ * 			0 on success, -1 if the handle or log level is invalid
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogModuleLevelSet(int8_t Handle, uint8_t MinLogLvl);
+
+
+
+/************************************************************************************************************************
+ * @brief	Limits how many messages a module logs with a token bucket: the module can log Burst messages in a row,
+ * 			then Rate_per_s messages per second on average. Messages over the limit are dropped before formatting 
+ * 			and counted, the count is logged ("N messages suppressed by the rate limit") right before the next 
+ * 			message that goes through. Lock free, safe to use from any task or interrupt.
+ * 
+ * 			Example usage:
+ * 				- RML_COMM_LogModuleRateSet(SensorLog, 5, 20);		<-- Bursts of 20, then 5 messages/s
+ *
+ *
+ * @param[in] Handle
+ * 			Handle returned by RML_COMM_LogModuleRegister()
+ *
+ * @param[in] Rate_per_s
+ * 			Messages per second allowed on average, 0 removes the limit (default)
+ *
+ * @param[in] Burst
+ * 			Max number of messages logged in a row, 0 is taken as 1
+ *
+ * @return
+ * 			0 on success, -1 if the handle is invalid
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogModuleRateSet(int8_t Handle, uint16_t Rate_per_s, uint16_t Burst);
+
+
+
+/************************************************************************************************************************
+ * @brief	Rate check used by RML_LOG_EVERY_MS(): returns 1 at most once every Period_ms for the same Last_ms. Lock 
+ * 			free, when several tasks race for the same period only one of them gets 1.
+ *
+ *
+ * @param[in,out] Last_ms
+ * 			Time of the last call that returned 1, must start at 0 (ex: a static variable)
+ *
+ * @param[in] Period_ms
+ * 			Min time between 2 calls that return 1
+ *
+ * @return
+ * 			1 if the caller may log, 0 if not
+ ************************************************************************************************************************/
+uint8_t RML_COMM_LogRateCheck(uint32_t *Last_ms, uint32_t Period_ms);
+
+
+
+/************************************************************************************************************************
+ * @brief	Checks if a message with that module and log level would be logged. Lock free and O(1), use it (or 
+ * 			RML_LOG_MOD()) to skip expensive argument preparation.
+ *
+ *
+ * @param[in] Handle
+ * 			Handle returned by RML_COMM_LogModuleRegister(), -1 to only check the global log levels
+ *
+ * @param[in] LogLvl
+ * 			Log level of the message
+ *
+ * @return
+ * 			1 if the message would be logged, 0 if not
+ ************************************************************************************************************************/
+uint8_t RML_COMM_LogEnabled(int8_t Handle, uint8_t LogLvl);
+
+
+
+/************************************************************************************************************************
+ * @brief	Same as RML_COMM_LogMsg() but for a registered module: the module name is used as the source and the
+ * 			module's log levels are applied. Prefer the RML_LOG_MOD() define.
+ *
+ *
+ * @param[in] Handle
+ * 			Handle returned by RML_COMM_LogModuleRegister()
+ *
+ * @param[in] LogLvl
+ * 			Log level of the message
+ *
+ * @param[in] Msg
+ * 			Message to output in the log
+ *
+ * @param[in] ...
+ * 			Any additional arguments
+ *
+ * @return
+ *          None
+ ************************************************************************************************************************/
+void RML_COMM_LogModMsg(int8_t Handle, uint8_t LogLvl, char* Msg, ... ) RML_PRINTF_FORMAT_ATTR(3, 4);
+
+
+
+/************************************************************************************************************************
+ * @brief	Returns the number of messages dropped since the logger was initialized, either because the async ring 
+ * 			buffer was full (e_OVERFLOW_DROP_NEW), a message was evicted (e_OVERFLOW_DROP_OLD), the sync mode lock 
+ * 			timed out (UARTComm->LockTimeout_ms) or a sync mode message was logged from an interrupt.
+ *
+ *
+ * @return
+ * 			Number of dropped messages
+ ************************************************************************************************************************/
+uint32_t RML_COMM_LogDroppedGet(void);
+
+
+
+
+/************************************************************************************************************************
+ * @brief	Waits until everything logged so far is out of the transport, ex: before a deep sleep or a reset. In async
+ * 			mode the ring buffer is drained by the calling task if the drain task/thread isn't already on it, then
+ * 			the built-in transport is waited on (Serial.flush() on ESP32, the UART's last byte on STM32, fflush() on 
+ * 			native). An open batch of the calling task is sent first.
+ * 
+ * 			Example usage:
+ * 				- RML_COMM_LogFlush(100);
+ * 				  esp_deep_sleep_start();
+ *
+ *
+ * @param[in] Timeout_ms
+ * 			Max time to wait, 0 to only send what can be sent right away
+ *
+ * @return
+ * 			0 if everything went out, -1 on timeout, if called from an interrupt or if the logger isn't initialized
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogFlush(uint32_t Timeout_ms);
+
+
+
+/************************************************************************************************************************
+ * @brief	Starts a batch: what the calling task logs (RML_COMM_LogMsg(), RML_COMM_printf()...) until 
+ * 			RML_COMM_LogBatchEnd() is held back and then sent in one go, so a multi-line dump (ex: a register table)
+ * 			comes out in one piece, without lines of other tasks in the middle, and in one write per sink instead of
+ * 			one per line. Other tasks and interrupts keep logging as usual meanwhile. 
+ * 
+ * 			Example usage:
+ * 				- RML_COMM_LogBatchBegin();
+ * 				  for( i = 0; i < 16; i++ ) RML_COMM_printf("R%u = 0x%08X\r\n", i, Regs[i]);
+ * 				  RML_COMM_LogBatchEnd();
+ * 
+ * @note	One batch is open at a time, a second task waits for it to end (at most UARTComm->LockTimeout_ms). A batch
+ * 			that outgrows RML_LOG_BATCH_BUFF_SIZE bytes or RML_LOG_BATCH_MAX_LINES lines is sent early in pieces. In 
+ * 			async mode the batch is written by the calling task, after what was already queued.
+ *
+ *
+ * @return
+ * 			0 if the batch was started, -1 if the logger isn't initialized, called from an interrupt, this task 
+ * 			already has a batch, another batch didn't end in time or the buffer couldn't be allocated
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogBatchBegin(void);
+
+
+
+/************************************************************************************************************************
+ * @brief	Ends the batch started by RML_COMM_LogBatchBegin() and sends it.
+ *
+ *
+ * @return
+ * 			0 on success, -1 if the calling task has no open batch
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogBatchEnd(void);
+
+
+
+/************************************************************************************************************************
+ * @brief	Returns how full the async ring buffer is, so producers can back off (skip a verbose dump, log less often)
+ * 			before messages get dropped. Always 0 in sync mode.
+ *
+ *
+ * @return
+ * 			Fill level in percent (0 - 100)
+ ************************************************************************************************************************/
+uint8_t RML_COMM_LogBuffFill(void);
+
+
+
+/************************************************************************************************************************
+ * @brief	Adds an output sink: from now on the log stream (log lines and RML_COMM_printf() output) is sent to it as
+ * 			well as to the other sinks, each one filtered by its own MinLogLvl. The built-in transport (UART, USB-CDC
+ * 			or stdout) is always sink RML_LOG_SINK_TRANSPORT, remove it to only log to your own sinks. Can be called 
+ * 			before RML_COMM_LoggerInit().
+ * 
+ * 			Example usage:
+ * 				- LogSink_Struct UdpSink = { UdpSink_Write, UdpSink_Flush, &UdpCtx, e_WARNING };
+ * 				- int8_t UdpHandle = RML_COMM_LogSinkAdd(&UdpSink);
+ *
+ *
+ * @param[in] Sink
+ * 			Sink callbacks and settings, the struct is copied so it doesn't have to stay valid
+ *
+ * @return
+ * 			The sink handle on success, -1 if Sink or Sink->Write is NULL, the log level is invalid or the table is
+ * 			full (RML_LOG_MAX_SINKS)
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogSinkAdd(const LogSink_Struct *Sink);
+
+
+
+/************************************************************************************************************************
+ * @brief	Removes an output sink, its slot can then be reused by RML_COMM_LogSinkAdd().
+ * 
+ * @note	A write that already started may still call the sink once, so keep its Ctx valid for a little while
+ * 			(one drain period in async mode).
+ *
+ *
+ * @param[in] Handle
+ * 			Handle returned by RML_COMM_LogSinkAdd(), or RML_LOG_SINK_TRANSPORT
+ *
+ * @return
+ * 			0 on success, -1 if the handle is invalid or was already removed
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogSinkRemove(int8_t Handle);
+
+
+
+/************************************************************************************************************************
+ * @brief	Sets the lowest log level sent to a sink, everything below it is filtered out for that sink only.
+ *
+ *
+ * @param[in] Handle
+ * 			Handle returned by RML_COMM_LogSinkAdd(), or RML_LOG_SINK_TRANSPORT
+ *
+ * @param[in] MinLogLvl
+ * 			Lowest log level to send (e_DEBUG ... e_FATAL), e_FATAL + 1 disables the sink
+ *
+ * @return
+ * 			0 on success, -1 if the handle or log level is invalid
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogSinkLevelSet(int8_t Handle, uint8_t MinLogLvl);
+
+
+
+#if defined(RML_LOG_STATS_ENABLE)
+/************************************************************************************************************************
+ * @brief	Reads the logger statistics: lines and bytes logged per level and per module, messages filtered out, 
+ * 			suppressed or dropped, the time spent in the built-in transport (UART, USB-CDC or stdout) and the peak 
+ * 			fill level of the async ring buffer. Use them to size the ring buffer and baud rate, or to spot a device
+ * 			that starts flooding its log. Every counter is a relaxed atomic add on the logging path.
+ * 
+ * @note	Symbol '-D' RML_LOG_STATS_ENABLE must be added to use the statistics. Calls compiled out with 
+ * 			RML_LOG_MIN_LEVEL or skipped by RML_LOG_MOD() (RML_COMM_LogEnabled()) never reach the logger, so they
+ * 			aren't counted as filtered.
+ * 
+ * 			Example usage:
+ * 				- RML_COMM_LogGetStats(&Stats, 1);		<-- Once a second: Stats.Bytes[] are then bytes/s
+ *
+ *
+ * @param[out] Stats
+ * 			Where the statistics are copied
+ * 
+ * @param[in] Reset
+ * 			1 to restart the counters once they are read, 0 to keep them going
+ * 
+ * @return
+ * 			0 on success, -1 if Stats is NULL
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogGetStats(LogStats_Struct *Stats, uint8_t Reset);
+#endif
+
+
+
+#if defined(RML_LOG_CRASHLOG_ENABLE)
+/************************************************************************************************************************
+ * @brief	Reads the crash log: the last RML_LOG_CRASHLOG_SIZE bytes of log lines (RML_LOG_CRASHLOG_MIN_LEVEL and 
+ * 			above), oldest to newest. They are kept in RAM that isn't cleared at boot (RML_LOG_CRASHLOG_ATTR) so they
+ * 			survive a reset, which makes them readable after a watchdog reset or panic when nothing was attached to 
+ * 			the serial port. Every line is copied there before it is sent or queued, recording costs a memcpy and 
+ * 			works from interrupts. By default RML_COMM_LoggerInit() sends what the previous boot logged to the sinks,
+ * 			use this function to store or upload it yourself (ex: to a flash partition, once per boot).
+ * 
+ * @note	Symbol '-D' RML_LOG_CRASHLOG_ENABLE must be added to use the crash log. On STM32 the linker script must
+ * 			have a NOLOAD .noinit section (or set RML_LOG_CRASHLOG_ATTR to your own section). Tokenized frames are
+ * 			stored as is, decode them with extras/tools/rml_log_decode.py.
+ * 
+ * 			Example usage:
+ * 				- Len = RML_COMM_CrashLogRead(Buff, sizeof(Buff));
+ *
+ *
+ * @param[out] Buff
+ * 			Buffer where the crash log is copied, it is not null terminated
+ * 
+ * @param[in] BuffSize
+ * 			The size of Buff, only the newest BuffSize bytes are copied if the log doesn't fit
+ * 
+ * @return
+ * 			Number of bytes copied, -1 if Buff is NULL
+ ************************************************************************************************************************/
+int32_t RML_COMM_CrashLogRead(char *Buff, uint32_t BuffSize);
+
+
+
+/************************************************************************************************************************
+ * @brief	Returns why the previous boot went down, as far as the logger knows: a failed RML_ASSERT() or an e_FATAL 
+ * 			message. Resets that didn't log anything (watchdog, hard fault, power) return e_CRASH_NONE, check the 
+ * 			crash log itself and your MCU's reset cause for those.
+ * 
+ * 
+ * @return
+ * 			CrashReason_Enum of the previous boot
+ ************************************************************************************************************************/
+uint8_t RML_COMM_CrashLogReason(void);
+
+
+
+/************************************************************************************************************************
+ * @brief	Empties the crash log, ex: once it was stored or uploaded
+ * 
+ * 
+ * @return
+ * 			None
+ ************************************************************************************************************************/
+void RML_COMM_CrashLogClear(void);
+#endif
+
+
+
+#if defined(RML_PROFILE_ENABLE)
+/*################################################################################################################################
+  #													<!-- Profiling functions -->
+  ################################################################################################################################*/
+/************************************************************************************************************************
+ * @brief	Records a profiling event: the cycle counter of the calling core and the name, into that core's buffer 
+ * 			(RML_PROFILE_BUFF_EVENTS events, the newest are kept). Nothing is formatted or sent, so it costs a few 
+ * 			dozen cycles and can be called from interrupts. Prefer the RML_PROFILE_SCOPE(), RML_PROFILE_BEGIN() and
+ * 			RML_PROFILE_END() defines.
+ * 
+ * 			Example usage:
+ * 				- void Control_Loop(void) { RML_PROFILE_SCOPE("Control_Loop"); ... }		<-- C++
+ * 				- RML_PROFILE_BEGIN("Filter"); Filter_Run(); RML_PROFILE_END("Filter");			<-- C
+ *
+ *
+ * @param[in] Name
+ * 			Name of the measured section, must be a string literal (it is looked up in the ELF file by the decoder)
+ * 
+ * @param[in] Type
+ * 			ProfileEvent_Enum
+ * 
+ * @return
+ * 			None
+ ************************************************************************************************************************/
+void RML_COMM_ProfileEvent(const char *Name, uint8_t Type);
+
+
+
+/************************************************************************************************************************
+ * @brief	Sends all the recorded profiling events through the logger (sinks, or the ring buffer in async mode) and
+ * 			empties the buffers. Recording is paused during the dump. The events go out as binary frames mixed with 
+ * 			the normal log output, turn a capture into a Chrome trace (chrome://tracing or ui.perfetto.dev) with:
+ * 				python3 extras/tools/rml_log_decode.py firmware.elf capture.bin --trace trace.json
+ * 
+ * @note	Timestamps are the raw cycle counter of each core (ns on native), stored as 32 bits: two events of a 
+ * 			core must not be more than one wrap apart (2^32 cycles, ~17 s at 240 MHz) to be placed correctly. On 
+ * 			ESP32 the counters of the 2 cores are not synchronized, each core shows up as its own track. In async
+ * 			mode the ring buffer must be big enough for the dump (or use e_OVERFLOW_BLOCK).
+ *
+ *
+ * @return
+ * 			Number of events sent, -1 if the logger wasn't initialized
+ ************************************************************************************************************************/
+int32_t RML_COMM_ProfileDump(void);
+
+
+
+#ifdef __cplusplus
+/**
+ * @brief Scoped profiling marker used by RML_PROFILE_SCOPE(): records the begin event when it is created and the end
+ * event when it goes out of scope.
+ */
+struct RML_ProfileScope_Struct
+{
+	const char *Name;
+
+	RML_ProfileScope_Struct(const char *ScopeName) : Name(ScopeName)
+	{
+		RML_COMM_ProfileEvent(Name, e_PROFILE_BEGIN);
+	}
+
+	~RML_ProfileScope_Struct()
+	{
+		RML_COMM_ProfileEvent(Name, e_PROFILE_END);
+	}
+};
+#endif
+#endif
+
+
+
+/*################################################################################################################################
+  #													<!-- printf functions -->
+  ################################################################################################################################*/
+/************************************************************************************************************************
+ * @brief	Extremely lightweight implementation of printf() for embedded systems. Prints output to UART. In case this 
+ * 			was run on a system that isn't supported, routes output to stdout via printf(). This function calls 
+ * 			RML_COMM_vprintf() to do the actual printing
+ * 
+ * 			Currently supports the following specifiers:
+ * 				- %s => String
+ * 				- %c => Character
+ * 				- %u => Unsigned integer
+ * 				- %d or %i => Signed integer
+ * 				- %% => To print a '%'
+ * 				- %X or %x => Hex value (upper case digits)
+ * 				- %p => Pointer, as 0x followed by all of its hex digits
+ * 				- %lu, %ld, %lx => Same as above for a long, %llu, %lld, %llx for a long long (64-bit) and %zu for a size_t
+ * 				  (%hu, %hhu... are accepted too)
+ * 				- %f => Float/Double, default precision is 2 decimal places
+ * 				- %.Xf => Float/Double, where X is the number of decimal places
+ * 
+ * 			The full %[flags][width][.precision] syntax is supported, for example:
+ * 				- %5d => Right aligned in 5 chars, %-12s => Left aligned in 12 chars
+ * 				- %08x => Zero padded to 8 chars, %+d => Always print the sign, %#x => 0x prefix
+ * 				- %.3s => At most 3 chars of the string, %.4u => At least 4 digits
+ * 				- %*d => Width given as an int arg before the value
+ * 
+ * 			Why this was created? Mainly for 2 reasons:
+ * 				1- printf() has a lot of code overhead and not recommend on embedded systems (that is assuming it
+ * 				   even is supported and works)
+ * 				2- I usually have no idea how printf() is handled on different systems and I cant really manipulate
+ * 		 		   where the output goes on embedded systems easily, so this makes it extremely easy for me to route
+ * 				   my output wherever (in my case, UART for logging stuff)
+ *
+ *
+ * @param[in] InputStr
+ * 			String with desired format specifiers
+ *
+ * @param[in] ...
+ * 			Any additional arguments
+ *
+ * @return
+ * 			None
+ ************************************************************************************************************************/
+void RML_COMM_printf( char * InputStr, ... ) RML_PRINTF_FORMAT_ATTR(1, 2);
+
+
+
+/************************************************************************************************************************
+ * @brief	Extremely lightweight implementation of vprintf() for embedded systems. Prints output to UART. In case this 
+ * 			was run on a system that isn't supported, routes output to stdout via printf(). Use RML_COMM_printf() unless 
+ * 			you know what you are doing.
+ * 
+ * 			Currently supports the following specifiers:
+ * 				- %s => String
+ * 				- %c => Character
+ * 				- %u => Unsigned integer
+ * 				- %d or %i => Signed integer
+ * 				- %% => To print a '%'
+ * 				- %X or %x => Hex value (upper case digits)
+ * 				- %p => Pointer, as 0x followed by all of its hex digits
+ * 				- %lu, %ld, %lx => Same as above for a long, %llu, %lld, %llx for a long long (64-bit) and %zu for a size_t
+ * 				  (%hu, %hhu... are accepted too)
+ * 				- %f => Float/Double, default precision is 2 decimal places
+ * 				- %.Xf => Float/Double, where X is the number of decimal places
+ * 
+ * 			The full %[flags][width][.precision] syntax is supported, for example:
+ * 				- %5d => Right aligned in 5 chars, %-12s => Left aligned in 12 chars
+ * 				- %08x => Zero padded to 8 chars, %+d => Always print the sign, %#x => 0x prefix
+ * 				- %.3s => At most 3 chars of the string, %.4u => At least 4 digits
+ * 				- %*d => Width given as an int arg before the value
+ *
+ * @note	Base code was gotten from: https://www.youtube.com/watch?v=Y9kUWsyyChk. Thanks to him for the explanation 
+ * 			and simplified logic!
+ * 
+ *
+ * @param[in] InputStr
+ * 			String with desired format specifiers
+ * 
+ * @param[in] VaList
+ * 			List of arguments
  * 
  * @return
  * 			None
  ************************************************************************************************************************/
-void RML_COMM_vprintf( char * InputStr, va_list VaList );
+void RML_COMM_vprintf( char * InputStr, va_list VaList ) RML_PRINTF_FORMAT_ATTR(1, 0);
+
+
+
+/************************************************************************************************************************
+ * @brief	Same as RML_COMM_printf() but writes the formatted string into a buffer instead of the UART, like the standard
+ * 			snprintf(). Supports the same specifiers as RML_COMM_printf(), does not need the logger to be initialized, 
+ * 			never allocates and keeps no state so it can be called from any number of tasks at the same time (and from
+ * 			interrupts). Use it to build payloads, display strings or file records without linking the newlib printf().
+ * 
+ * 			Example usage:
+ * 				- RML_COMM_snprintf(Payload, sizeof(Payload), "{\"temp\":%.2f,\"rpm\":%u}", Temp, Rpm);
+ * 				- Len = RML_COMM_snprintf(NULL, 0, "%s-%u", Name, Id); <-- Only measures the output
+ *
+ *
+ * @param[out] Buff
+ * 			The buffer where the resulting string will be stored, it is always null terminated. Can be NULL if BuffSize is 0
+ * 
+ * @param[in] BuffSize
+ * 			The size of Buff, you can call sizeof(Buff) to get this value. Output that doesn't fit is truncated
+ * 
+ * @param[in] InputStr
+ * 			String with desired format specifiers
+ * 
+ * @param[in] ...
+ * 			Any additional arguments
+ * 
+ * @return
+ * 			Length of the complete output (not counting the null terminator), even if it was truncated: the output fit
+ * 			only if the returned value is smaller than BuffSize. -1 if Buff is NULL while BuffSize isn't 0
+ ************************************************************************************************************************/
+int32_t RML_COMM_snprintf(char *Buff, uint32_t BuffSize, const char *InputStr, ... ) RML_PRINTF_FORMAT_ATTR(3, 4);
+
+
+
+/************************************************************************************************************************
+ * @brief	Same as RML_COMM_snprintf() but takes a va_list. This is also the formatting core the logger uses to build a
+ * 			whole line before sending it in one go. 
+ * 
+ * 			Example usage:
+ * 				- va_start(VaList, Fmt); RML_COMM_vsnprintf(LineBuff, sizeof(LineBuff), Fmt, VaList); va_end(VaList);
+ *
+ *
+ * @param[out] Buff
+ * 			The buffer where the resulting string will be stored, it is always null terminated. Can be NULL if BuffSize is 0
+ * 
+ * @param[in] BuffSize
+ * 			The size of Buff, you can call sizeof(Buff) to get this value. Output that doesn't fit is truncated
+ * 
+ * @param[in] InputStr
+ * 			String with desired format specifiers
+ * 
+ * @param[in] VaList
+ * 			List of arguments
+ * 
+ * @return
+ * 			Length of the complete output (not counting the null terminator), even if it was truncated: the output fit
+ * 			only if the returned value is smaller than BuffSize. -1 if Buff is NULL while BuffSize isn't 0
+ ************************************************************************************************************************/
+int32_t RML_COMM_vsnprintf(char *Buff, uint32_t BuffSize, const char *InputStr, va_list VaList) RML_PRINTF_FORMAT_ATTR(3, 0);
 
 
 
@@ -385,14 +1516,64 @@ int32_t RML_COMM_itoa(int32_t Value, char* ResultBuff, uint32_t ResultBuff_Size,
 
 
 /************************************************************************************************************************
- * @brief 	This function reverses a given string
+ * @brief 	64-bit version of RML_COMM_utoa(). Returns the length of the resulting string
+ * 
+ * 			Base 10 splits the value into base 1e9 chunks with a multiply by reciprocal, so 32-bit cores never call
+ * 			the (slow) 64-bit division helper. Values that fit in 32 bits take the RML_COMM_utoa() path directly:
+ * 				- Timestamp in us => RML_COMM_utoa64(Timestamp_us, ResultBuff, sizeof(ResultBuff), 10);
+ * 
+ * 
+ * @param[in] Value
+ * 			The unsigned integer to be converted
+ *
+ * @param[out] ResultBuff
+ * 			The buffer where the resulting string will be stored, 21 bytes fit any value in base 10
+ * 
+ * @param[in] ResultBuff_Size
+ * 			The size of the ResultBuff buffer, you can call sizeof(ResultBuff) to get this value
+ * 
+ * @param[in] Base
+ * 			The base to use for the conversion. The base must be between 2 and 36
+ * 
+ * @return
+ * 			The length of the resulting string. If the base is invalid or the result buffer is too small, -1 is returned
+ ************************************************************************************************************************/
+int32_t RML_COMM_utoa64(uint64_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base);
+
+
+
+/************************************************************************************************************************
+ * @brief 	64-bit version of RML_COMM_itoa(). Returns the length of the resulting string
+ * 
+ * 
+ * @param[in] Value
+ * 			The signed integer to be converted
+ *
+ * @param[out] ResultBuff
+ * 			The buffer where the resulting string will be stored, 21 bytes fit any value in base 10
+ * 
+ * @param[in] ResultBuff_Size
+ * 			The size of the ResultBuff buffer, you can call sizeof(ResultBuff) to get this value
+ * 
+ * @param[in] Base
+ * 			The base to use for the conversion. The base must be between 2 and 36
+ * 
+ * @return
+ * 			The length of the resulting string. If the base is invalid or the result buffer is too small, -1 is returned
+ ************************************************************************************************************************/
+int32_t RML_COMM_itoa64(int64_t Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Base);
+
+
+
+/************************************************************************************************************************
+ * @brief 	This function reverses a given string, a word from each end at a time
  * 
  * 
  * @param[out] Str
  * 			The string to be reversed
  *
  * @param[in] Length
- * 			Length of the string to be reversed
+ * 			Length of the string to be reversed, 0 does nothing
  * 
  * @return
  * 			None
@@ -401,10 +1582,42 @@ void RML_COMM_ReverseString(char* Str, uint32_t Length);
 
 
 
+/************************************************************************************************************************
+ * @brief 	Converts a byte buffer to uppercase hex, 2 chars per byte ("DEADBEEF"). Without a separator 4 bytes are 
+ * 			encoded per step
+ * 
+ * 
+ * @param[in] Data
+ * 			Bytes to convert
+ *
+ * @param[in] DataLen
+ * 			Number of bytes in Data
+ * 
+ * @param[out] ResultBuff
+ * 			The buffer where the resulting string will be stored. DataLen * 2 + 1 bytes are needed without a separator, 
+ * 			DataLen * 3 with one
+ * 
+ * @param[in] ResultBuff_Size
+ * 			The size of the ResultBuff buffer, you can call sizeof(ResultBuff) to get this value
+ * 
+ * @param[in] Separator
+ * 			Char put between bytes ("DE AD BE EF" with ' '), '\0' for none
+ * 
+ * @return
+ * 			The length of the resulting string. If the result buffer is too small, -1 is returned
+ ************************************************************************************************************************/
+int32_t RML_COMM_HexDump(const void* Data, uint32_t DataLen, char* ResultBuff, uint32_t ResultBuff_Size, char Separator);
+
+
+
 /************************************************************************************************************************
  * @brief 	This function converts a double-precision floating-point number to a string representation with a specified 
  * 			number of decimal places
  * 
+ * 			The value is scaled once by a power of ten and correctly rounded to nearest (ties to even) against its exact
+ * 			binary value for up to 17 decimal places, integer parts are printed with the integer kernels. The whole double range is supported (values above 1e19 print their significant
+ * 			digits followed by zeros), NaN and infinity print "nan" and "inf"
+ * 
  * 
  * @param[in] Value
  * 			Double-precision floating-point number to be converted to a string
@@ -416,7 +1629,9 @@ void RML_COMM_ReverseString(char* Str, uint32_t Length);
  * 			The size of the ResultBuff buffer, you can call sizeof(ResultBuff) to get this value
  * 
  * @param[in] Afterpoint
- * 			Specifies the number of decimal places to include in the output string. If set to 0 will default to 2 decimal places
+ * 			Specifies the number of decimal places to include in the output string, 0 rounds to an integer without a 
+ * 			decimal point. Digits past the 17th decimal place are printed as 0, unlike printf() which keeps expanding 
+ * 			the binary value ("%.20f" of 0.1 gives 0.10000000000000001000 here, 0.10000000000000000555 there)
  * 
  * @return
  * 			The length of the resulting string. If the result buffer is too small, -1 is returned
@@ -425,6 +1640,294 @@ int32_t RML_COMM_ftoa(double Value, char* ResultBuff, uint32_t ResultBuff_Size,
 
 
 
+/************************************************************************************************************************
+ * @brief 	Single precision version of RML_COMM_ftoa(). Only float and 32-bit integer math is used, so on cores with a 
+ * 			float-only FPU (ESP32) nothing goes through software double emulation. %f uses it when the symbol '-D'
+ * 			RML_PRINTF_FLOAT_SINGLE is defined
+ * 
+ * 
+ * @param[in] Value
+ * 			Single-precision floating-point number to be converted to a string
+ *
+ * @param[out] ResultBuff
+ * 			The buffer where the resulting string will be stored
+ * 
+ * @param[in] ResultBuff_Size
+ * 			The size of the ResultBuff buffer, you can call sizeof(ResultBuff) to get this value
+ * 
+ * @param[in] Afterpoint
+ * 			Specifies the number of decimal places to include in the output string, 0 rounds to an integer without a 
+ * 			decimal point. Digits past the 9th decimal place are printed as 0
+ * 
+ * @return
+ * 			The length of the resulting string. If the result buffer is too small, -1 is returned
+ ************************************************************************************************************************/
+int32_t RML_COMM_ftoaf(float Value, char* ResultBuff, uint32_t ResultBuff_Size, uint8_t Afterpoint);
+
+
+
+/************************************************************************************************************************
+ * @brief 	Parses an unsigned integer from the first Len chars of Str, which doesn't need to be null terminated. 
+ * 			Parsing stops at the first char that isn't a digit of Base, so fields can be read one after the other 
+ * 			straight out of a receive buffer. An optional '+' is accepted, and in base 16 an optional "0x" prefix. 
+ * 			No whitespace is skipped and the locale is never looked at
+ * 
+ * @note	Base 10 converts 8 digits per step (SWAR) while the input has them
+ * 
+ * 
+ * @param[in] Str
+ * 			Chars to parse
+ *
+ * @param[in] Len
+ * 			Number of chars in Str that can be read
+ * 
+ * @param[in] Base
+ * 			The base to parse in, between 2 and 36. Letters are accepted in either case
+ * 
+ * @param[out] Value
+ * 			The parsed value, only written on success
+ * 
+ * @return
+ * 			Number of chars used (sign and prefix included). -1 if there are no digits, the value doesn't fit or the
+ * 			base is invalid
+ ************************************************************************************************************************/
+int32_t RML_COMM_atou(const char* Str, uint32_t Len, uint8_t Base, uint32_t *Value);
+
+
+
+/************************************************************************************************************************
+ * @brief 	Signed version of RML_COMM_atou(): an optional '+' or '-' followed by the digits. Returns the number of chars 
+ * 			used, or -1 if there are no digits, the value doesn't fit or the base is invalid
+ ************************************************************************************************************************/
+int32_t RML_COMM_atoi(const char* Str, uint32_t Len, uint8_t Base, int32_t *Value);
+
+
+
+/************************************************************************************************************************
+ * @brief 	64-bit versions of RML_COMM_atou() and RML_COMM_atoi()
+ ************************************************************************************************************************/
+int32_t RML_COMM_atou64(const char* Str, uint32_t Len, uint8_t Base, uint64_t *Value);
+int32_t RML_COMM_atoi64(const char* Str, uint32_t Len, uint8_t Base, int64_t *Value);
+
+
+
+/************************************************************************************************************************
+ * @brief 	Parses a decimal floating-point number from the first Len chars of Str, which doesn't need to be null 
+ * 			terminated: an optional sign, digits with an optional '.' and an optional exponent ("-12.5", "3e-4", "7."). 
+ * 			"inf", "infinity" and "nan" are accepted in any case. Parsing stops at the first char that isn't part of 
+ * 			the number
+ * 
+ * @note	The result is correctly rounded for up to 15 significant digits with exponents up to +/-22, which covers
+ * 			what RML_COMM_ftoa() prints. Past that it can be off by a few units in the last place
+ * 
+ * 
+ * @param[in] Str
+ * 			Chars to parse
+ *
+ * @param[in] Len
+ * 			Number of chars in Str that can be read
+ * 
+ * @param[out] Value
+ * 			The parsed value, only written on success. Out of range values become +/-inf or 0
+ * 
+ * @return
+ * 			Number of chars used, -1 if there are no digits
+ ************************************************************************************************************************/
+int32_t RML_COMM_atof(const char* Str, uint32_t Len, double *Value);
+
+
+
+/************************************************************************************************************************
+ * @brief 	Sets up a string builder over a caller provided buffer and makes it an empty string. The builder appends
+ * 			with the same converters and formatter as the rest of the library, writing straight into the buffer, so
+ * 			building a message piece by piece needs no heap and no temporary buffers
+ * 
+ * 
+ * @param[out] Sb
+ * 			String builder to set up
+ *
+ * @param[in] Buff
+ * 			Buffer the string is built in, it must stay valid while the builder is used
+ * 
+ * @param[in] BuffSize
+ * 			The size of Buff, you can call sizeof(Buff) to get this value. Up to BuffSize - 1 chars are kept
+ * 
+ * @return
+ * 			None
+ ************************************************************************************************************************/
+void RML_COMM_SbInit(StrBuilder_Struct *Sb, char *Buff, uint32_t BuffSize);
+
+
+
+/************************************************************************************************************************
+ * @brief 	Empties the string and clears the truncated count, the buffer is reused
+ * 
+ * 
+ * @param[in, out] Sb
+ * 			String builder set up with RML_COMM_SbInit()
+ * 
+ * @return
+ * 			None
+ ************************************************************************************************************************/
+void RML_COMM_SbReset(StrBuilder_Struct *Sb);
+
+
+
+/************************************************************************************************************************
+ * @brief 	Append functions. Each one adds to the end of the string and keeps it null terminated. When the buffer 
+ * 			fills up the part that doesn't fit is dropped and added to Sb->Truncated, later appends keep counting
+ * 			so the total shortfall is known
+ * 
+ * 			- RML_COMM_SbAddStr():		a null terminated string, NULL appends "(null)"
+ * 			- RML_COMM_SbAddStrN():		the first Len chars of Str
+ * 			- RML_COMM_SbAddChar():		a single char
+ * 			- RML_COMM_SbAddUint():		an unsigned integer in base 10
+ * 			- RML_COMM_SbAddInt():		a signed integer in base 10
+ * 			- RML_COMM_SbAddHex():		an unsigned integer in uppercase hex, zero padded to MinDigits (max 16)
+ * 			- RML_COMM_SbAddFloat():	a float with Afterpoint decimals, same output as "%.<Afterpoint>f"
+ * 			- RML_COMM_SbAddFmt():		a printf-style format, same specifiers as RML_COMM_printf()
+ * 
+ * 
+ * @param[in, out] Sb
+ * 			String builder set up with RML_COMM_SbInit()
+ * 
+ * @return
+ * 			0 if everything fit, -1 if something was dropped
+ ************************************************************************************************************************/
+int8_t RML_COMM_SbAddStr(StrBuilder_Struct *Sb, const char *Str);
+int8_t RML_COMM_SbAddStrN(StrBuilder_Struct *Sb, const char *Str, uint32_t Len);
+int8_t RML_COMM_SbAddChar(StrBuilder_Struct *Sb, char Ch);
+int8_t RML_COMM_SbAddUint(StrBuilder_Struct *Sb, uint64_t Value);
+int8_t RML_COMM_SbAddInt(StrBuilder_Struct *Sb, int64_t Value);
+int8_t RML_COMM_SbAddHex(StrBuilder_Struct *Sb, uint64_t Value, uint8_t MinDigits);
+int8_t RML_COMM_SbAddFloat(StrBuilder_Struct *Sb, double Value, uint8_t Afterpoint);
+int8_t RML_COMM_SbAddFmt(StrBuilder_Struct *Sb, const char *Fmt, ... ) RML_PRINTF_FORMAT_ATTR(2, 3);
+int8_t RML_COMM_SbAddVFmt(StrBuilder_Struct *Sb, const char *Fmt, va_list VaList);
+
+
+
+#ifdef __cplusplus
+/**
+ * @brief String builder with its own buffer of Capacity bytes (string length up to Capacity - 1). The appends can be 
+ * chained or streamed, ex:
+ * 		RML_StrBuilder<64> Msg;
+ * 		Msg << "rpm " << Rpm << " temp " << Temp;
+ * 		Msg.Str(" id 0x").Hex(Id, 8);
+ * 		RML_COMM_LogMsg("Motor", e_INFO, "%s", Msg.CStr());
+ * Floats streamed with << get 2 decimals, use Float() to choose.
+ */
+template <uint32_t Capacity>
+struct RML_StrBuilder
+{
+	StrBuilder_Struct Sb;
+	char Buff[Capacity];
+
+	RML_StrBuilder()							{ RML_COMM_SbInit(&Sb, Buff, Capacity); }
+	RML_StrBuilder(const RML_StrBuilder&) = delete;				//Sb points into Buff, a copy would write into the original
+	RML_StrBuilder& operator=(const RML_StrBuilder&) = delete;
+
+	const char* CStr(void) const				{ return Buff; }
+	uint32_t Length(void) const					{ return Sb.Len; }
+	uint32_t Truncated(void) const				{ return Sb.Truncated; }
+	void Reset(void)							{ RML_COMM_SbReset(&Sb); }
+
+	RML_StrBuilder& Str(const char *Src)						{ RML_COMM_SbAddStr(&Sb, Src); return *this; }
+	RML_StrBuilder& Str(const char *Src, uint32_t Len)			{ RML_COMM_SbAddStrN(&Sb, Src, Len); return *this; }
+	RML_StrBuilder& Char(char Ch)								{ RML_COMM_SbAddChar(&Sb, Ch); return *this; }
+	RML_StrBuilder& Int(int64_t Value)							{ RML_COMM_SbAddInt(&Sb, Value); return *this; }
+	RML_StrBuilder& Uint(uint64_t Value)						{ RML_COMM_SbAddUint(&Sb, Value); return *this; }
+	RML_StrBuilder& Hex(uint64_t Value, uint8_t MinDigits = 0)	{ RML_COMM_SbAddHex(&Sb, Value, MinDigits); return *this; }
+	RML_StrBuilder& Float(double Value, uint8_t Afterpoint = 2)	{ RML_COMM_SbAddFloat(&Sb, Value, Afterpoint); return *this; }
+
+	RML_StrBuilder& Fmt(const char *Format, ... ) RML_PRINTF_FORMAT_ATTR(2, 3)
+	{
+		va_list VaList;
+		va_start(VaList, Format);
+		RML_COMM_SbAddVFmt(&Sb, Format, VaList);
+		va_end(VaList);
+		return *this;
+	}
+
+	RML_StrBuilder& operator<<(const char *Src)				{ return Str(Src); }
+	RML_StrBuilder& operator<<(char Ch)						{ return Char(Ch); }
+	RML_StrBuilder& operator<<(int Value)					{ return Int(Value); }
+	RML_StrBuilder& operator<<(long Value)					{ return Int(Value); }
+	RML_StrBuilder& operator<<(long long Value)				{ return Int(Value); }
+	RML_StrBuilder& operator<<(unsigned int Value)			{ return Uint(Value); }
+	RML_StrBuilder& operator<<(unsigned long Value)			{ return Uint(Value); }
+	RML_StrBuilder& operator<<(unsigned long long Value)	{ return Uint(Value); }
+	RML_StrBuilder& operator<<(double Value)				{ return Float(Value); }
+};
+#endif
+
+
+
+#if (defined(STM32H725xx) || defined(STM32H735xx)) && defined(RML_LOG_STM32_DMA_ENABLE)
+/************************************************************************************************************************
+ * @brief	Must be called from HAL_UART_TxCpltCallback() when the DMA transmit engine is enabled (symbol '-D' 
+ * 			RML_LOG_STM32_DMA_ENABLE). It frees the DMA buffer that just finished and starts sending the other one.
+ * 			If your project doesn't define HAL_UART_TxCpltCallback() and HAL_UART_ErrorCallback() itself, add the 
+ * 			symbol '-D' RML_LOG_STM32_DMA_OWN_CALLBACK and the library will define both for you.
+ * 
+ * @note	The logger UART must have a TX DMA stream linked in CubeMX with its interrupt enabled. The transmit
+ * 			buffers are placed in the ".RAM_D2" section (override with RML_LOG_DMA_BUFF_ATTR), the D-cache is 
+ * 			cleaned before each transfer so no MPU configuration is needed.
+ * 
+ *
+ * @param[in] huart
+ * 			UART handle passed to HAL_UART_TxCpltCallback()
+ * 
+ * @return
+ * 			None
+ ************************************************************************************************************************/
+void RML_COMM_UART_TxCpltCallback(UART_HandleTypeDef *huart);
+
+
+
+/************************************************************************************************************************
+ * @brief	Should be called from HAL_UART_ErrorCallback() when the DMA transmit engine is enabled (symbol '-D' 
+ * 			RML_LOG_STM32_DMA_ENABLE). If the error ended the log transfer, its data is counted as dropped (see 
+ * 			RML_COMM_LogDroppedGet()) and the next buffer is sent right away. Without it a lost transfer is only 
+ * 			given up on after UARTComm->LockTimeout_ms, by the next writer that needs the buffer. Defined for you 
+ * 			with RML_LOG_STM32_DMA_OWN_CALLBACK, like HAL_UART_TxCpltCallback().
+ * 
+ *
+ * @param[in] huart
+ * 			UART handle passed to HAL_UART_ErrorCallback()
+ * 
+ * @return
+ * 			None
+ ************************************************************************************************************************/
+void RML_COMM_UART_ErrorCallback(UART_HandleTypeDef *huart);
+#endif
+
+
+
+#if !defined(ESP32) && !defined(STM32H725xx) && !defined(STM32H735xx)
+/************************************************************************************************************************
+ * @brief	Native (PC) only: sends the log output to a file instead of stdout, ex: for long simulator runs. The output 
+ * 			is written with one writev() per batch of lines either way. When MaxBytes is given the file is rotated
+ * 			once it reaches that size: Path becomes Path.1, Path.1 becomes Path.2 and so on, keeping Keep old files.
+ * 			Can be called before or after RML_COMM_LoggerInit(), in sync and async mode
+ * 
+ * 
+ * @param[in] Path
+ * 			Log file, created or truncated. NULL goes back to stdout
+ *
+ * @param[in] MaxBytes
+ * 			Size at which the file is rotated, 0 never rotates
+ * 
+ * @param[in] Keep
+ * 			Number of rotated files kept, 0 just starts the file over
+ * 
+ * @return
+ * 			0 on success, -1 if the file couldn't be opened (the current output is kept) or the logger is busy
+ ************************************************************************************************************************/
+int8_t RML_COMM_LogFileSet(const char *Path, uint32_t MaxBytes, uint8_t Keep);
+#endif
+
+
+
 /************************************************************************************************************************
  * @brief	This function is called when #define RML_ASSERT(expr) fails. It allows you to see in which file and line 
  * 			number the assert failed. <b> Do not call directly, use the #define! </b>